@@ -0,0 +1,140 @@
+/*
+ * Runs the quadratic program of MpcController in closed loop with a single
+ * joint simulated as a double integrator, and reports the solve times.
+ *
+ * It also checks that the problem stays feasible when a joint is faster than
+ * its velocity limit, which can't be met in the first steps then:
+ *   - for initial velocities up to four times the limit, braking as hard as
+ *     allowed until the joint is within the limit has to satisfy the bounds
+ *   - in closed loop from the given initial velocity (by default twice the
+ *     limit), the joint has to get back within the limit, stay there, and
+ *     reach its goal
+ *
+ * Usage: mpc_benchmark [initial_velocity] [n_cycles]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include <ros/time.h>
+
+#include <barrett_controllers/admm_qp_solver.h>
+#include <barrett_controllers/mpc_problem.h>
+
+static const int HORIZON = 20;
+
+typedef barrett_controllers::MpcProblem<HORIZON> Problem;
+typedef barrett_controllers::AdmmQpSolver<HORIZON, 2*HORIZON, 1> Solver;
+
+int main(int argc, char** argv)
+{
+  // The defaults of MpcController and the limits of the WAM's first joint
+  const double step = 0.02;
+  const double velocity_limit = 0.5;
+  const double acceleration_limit = 10.0;
+  const int max_iterations = 100;
+  const double tolerance = 1E-3;
+  const double dt = 0.001;
+
+  const double initial_velocity = (argc > 1) ? atof(argv[1]) : 2.0*velocity_limit;
+  const int n_cycles = (argc > 2) ? atoi(argv[2]) : 5000;
+  const double goal = 1.0;
+
+  Problem problem;
+  problem.setup(step, 1.0, 0.05, 1E-4);
+
+  Solver solver;
+  solver.setup(problem.getHessian(), problem.getConstraints(), 10.0);
+
+  Solver::Variables q, x = Solver::Variables::Zero();
+  Solver::ConstraintValues lower, upper, z = Solver::ConstraintValues::Zero(), y = Solver::ConstraintValues::Zero();
+  Problem::HorizonVector cost;
+  Problem::ConstraintVector joint_lower, joint_upper;
+
+  // Feasibility of braking from too fast
+  int infeasible = 0;
+  for(int i=-40; i<=40; i++) {
+    const double v0 = 0.1*i*velocity_limit;
+    problem.computeBounds(v0, velocity_limit, -acceleration_limit, acceleration_limit, joint_lower, joint_upper);
+
+    Problem::HorizonVector braking;
+    for(int k=0; k<HORIZON; k++) {
+      const double v = (v0 > 0.0)
+        ? std::max(v0 - acceleration_limit*step*(k + 1), std::min(v0, velocity_limit))
+        : std::min(v0 + acceleration_limit*step*(k + 1), std::max(v0, -velocity_limit));
+      const double v_previous = (k > 0) ? braking[k-1] + v0 : v0;
+      braking[k] = v - v0;
+      // The velocity changes of the plan, and its accelerations
+      const double a = (v - v_previous)/step;
+      if(a < joint_lower[k] - 1E-9 || a > joint_upper[k] + 1E-9
+          || braking[k] < joint_lower[HORIZON + k] - 1E-9
+          || braking[k] > joint_upper[HORIZON + k] + 1E-9)
+      {
+        infeasible++;
+        break;
+      }
+    }
+  }
+
+  double position = 0.0, velocity = initial_velocity;
+  int failures = 0, max_iterations_used = 0;
+  double total_time = 0.0, max_time = 0.0;
+  // The first cycle after braking back within the velocity limit
+  int within_limit_cycle = -1;
+  double max_velocity_after = 0.0;
+
+  for(int c=0; c<n_cycles; c++) {
+    problem.computeCost(position - goal, velocity, cost);
+    problem.computeBounds(velocity, velocity_limit, -acceleration_limit, acceleration_limit, joint_lower, joint_upper);
+    q.col(0) = cost;
+    lower.col(0) = joint_lower;
+    upper.col(0) = joint_upper;
+
+    int iterations = 0;
+    const ros::WallTime start = ros::WallTime::now();
+    const bool converged = solver.solve(q, lower, upper, x, z, y, max_iterations, tolerance, iterations);
+    const double solve_time = (ros::WallTime::now() - start).toSec();
+
+    total_time += solve_time;
+    max_time = std::max(max_time, solve_time);
+    max_iterations_used = std::max(max_iterations_used, iterations);
+    if(!converged) {
+      failures++;
+    }
+
+    // Apply the first acceleration for one cycle
+    const double acceleration = std::max(-acceleration_limit, std::min(x(0,0), acceleration_limit));
+    velocity += acceleration*dt;
+    position += velocity*dt;
+
+    if(within_limit_cycle < 0) {
+      if(std::abs(velocity) <= velocity_limit + 1E-3) {
+        within_limit_cycle = c;
+      }
+    } else {
+      max_velocity_after = std::max(max_velocity_after, std::abs(velocity));
+    }
+  }
+
+  const double final_error = std::abs(position - goal);
+
+  printf("initial velocities which can't be braked within the bounds: %d of 81\n", infeasible);
+  printf("initial velocity: %g rad/s limit: %g rad/s cycles: %d\n", initial_velocity, velocity_limit, n_cycles);
+  printf("solve time: %8.2f us mean %8.2f us max, %d iterations max\n",
+      1E6*total_time/n_cycles, 1E6*max_time, max_iterations_used);
+  printf("solves which didn't converge: %d\n", failures);
+  printf("within the velocity limit after %d cycles, %g rad/s max after that\n",
+      within_limit_cycle, max_velocity_after);
+  printf("final position error: %g rad\n", final_error);
+
+  // Solves which hit the iteration cap are followed up by the controller's
+  // fallback, so they're only reported
+  const bool ok = infeasible == 0
+    && within_limit_cycle >= 0
+    && max_velocity_after <= velocity_limit + 1E-3
+    && final_error < 1E-3;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * Compares the cost of updating N separate control_toolbox::Pid objects
+ * against a single PidBank, and checks that they compute the same commands.
+ *
+ * Usage: pid_bank_benchmark [n_joints] [n_cycles]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <ros/time.h>
+#include <control_toolbox/pid.h>
+
+#include <barrett_controllers/pid_bank.h>
+
+static const int MAX_JOINTS = 16;
+static const int N_SAMPLES = 1024;
+
+double uniform(const double lo, const double hi) {
+  return lo + (hi - lo)*(static_cast<double>(rand())/RAND_MAX);
+}
+
+int main(int argc, char** argv)
+{
+  const int n_joints = (argc > 1) ? atoi(argv[1]) : 7;
+  const int n_cycles = (argc > 2) ? atoi(argv[2]) : 1000000;
+
+  if(n_joints < 1 || n_joints > MAX_JOINTS) {
+    fprintf(stderr, "The number of joints must be between 1 and %d.\n", MAX_JOINTS);
+    return -1;
+  }
+
+  const double dt = 0.001;
+  const ros::Duration period(dt);
+
+  // Use the same random gains and errors for both implementations
+  std::vector<control_toolbox::Pid> pids(n_joints);
+  barrett_controllers::PidBank<MAX_JOINTS> bank;
+  bank.resize(n_joints);
+
+  srand(0);
+  for(int j=0; j<n_joints; j++) {
+    const double p = uniform(10.0, 300.0);
+    const double i = uniform(1.0, 100.0);
+    const double d = uniform(0.1, 20.0);
+    const double i_max = uniform(0.2, 20.0);
+    pids[j] = control_toolbox::Pid(p, i, d, i_max, -i_max);
+    bank.setGains(j, p, i, d, i_max, -i_max);
+  }
+
+  std::vector<double> errors(N_SAMPLES*n_joints), error_dots(N_SAMPLES*n_joints);
+  for(size_t k=0; k<errors.size(); k++) {
+    errors[k] = uniform(-0.1, 0.1);
+    error_dots[k] = uniform(-1.0, 1.0);
+  }
+
+  std::vector<double> pid_commands(n_joints, 0.0), bank_commands(n_joints, 0.0);
+  double pid_checksum = 0.0, bank_checksum = 0.0;
+
+  // Separate Pid objects
+  ros::WallTime pid_start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    const double *e = &errors[(c % N_SAMPLES)*n_joints];
+    const double *e_dot = &error_dots[(c % N_SAMPLES)*n_joints];
+    for(int j=0; j<n_joints; j++) {
+      pid_commands[j] = pids[j].computeCommand(e[j], e_dot[j], period);
+    }
+    pid_checksum += pid_commands[c % n_joints];
+  }
+  const double pid_time = (ros::WallTime::now() - pid_start).toSec();
+
+  // PID bank
+  ros::WallTime bank_start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    const double *e = &errors[(c % N_SAMPLES)*n_joints];
+    const double *e_dot = &error_dots[(c % N_SAMPLES)*n_joints];
+    for(int j=0; j<n_joints; j++) {
+      bank.setErrors(j, e[j], e_dot[j]);
+    }
+    bank.update(dt, bank_commands);
+    bank_checksum += bank_commands[c % n_joints];
+  }
+  const double bank_time = (ros::WallTime::now() - bank_start).toSec();
+
+  // Both should have computed the same commands
+  double max_difference = 0.0;
+  for(int j=0; j<n_joints; j++) {
+    max_difference = std::max(max_difference, std::abs(pid_commands[j] - bank_commands[j]));
+  }
+
+  printf("joints: %d cycles: %d\n", n_joints, n_cycles);
+  printf("control_toolbox::Pid x %d: %8.2f ns/cycle\n", n_joints, 1E9*pid_time/n_cycles);
+  printf("PidBank:                %8.2f ns/cycle\n", 1E9*bank_time/n_cycles);
+  printf("speedup: %.2fx\n", pid_time/bank_time);
+  printf("max command difference: %g (checksums %g %g)\n", max_difference, pid_checksum, bank_checksum);
+
+  return (max_difference < 1E-9) ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#ifndef __BARRETT_CONTROLLERS_ADMM_QP_SOLVER_H
+#define __BARRETT_CONTROLLERS_ADMM_QP_SOLVER_H
+
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+namespace barrett_controllers {
+
+  /** \brief Fixed-size solver for a batch of quadratic programs which share
+   * their Hessian and constraint matrix
+   *
+   * Each column of the batch is the problem
+   *
+   *   minimize 1/2 x' P x + q' x  subject to  l <= A x <= u
+   *
+   * which is solved with the alternating direction method of multipliers
+   * (the iteration used by OSQP) with a fixed step size. Since P and A don't
+   * change, the linear system of each iteration is inverted once by \ref
+   * setup, and \ref solve only does matrix products on fixed-size matrices:
+   * it never allocates and runs for at most \c max_iterations.
+   *
+   * The primal and dual variables are passed in and out of \ref solve, so the
+   * previous solution can be used as a warm start.
+   */
+  template <int N_VARIABLES, int N_CONSTRAINTS, int N_PROBLEMS>
+  class AdmmQpSolver
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef Eigen::Matrix<double, N_VARIABLES, N_VARIABLES> Hessian;
+    typedef Eigen::Matrix<double, N_CONSTRAINTS, N_VARIABLES> ConstraintMatrix;
+    typedef Eigen::Matrix<double, N_VARIABLES, N_PROBLEMS> Variables;
+    typedef Eigen::Matrix<double, N_CONSTRAINTS, N_PROBLEMS> ConstraintValues;
+
+    AdmmQpSolver() :
+      rho_(0.1),
+      sigma_(1E-6),
+      alpha_(1.6),
+      check_interval_(5)
+    {
+      hessian_.setZero();
+      constraints_.setZero();
+      kkt_inverse_.setZero();
+    }
+
+    /** \brief Set the problem matrices and invert the iteration's linear
+     * system
+     *
+     * \param hessian P, which has to be positive semi-definite
+     * \param constraints A
+     * \param rho The step size, larger values enforce the constraints faster
+     * \param sigma Regularization of the primal variables
+     * \param alpha Relaxation, in (0, 2)
+     */
+    void setup(
+        const Hessian &hessian,
+        const ConstraintMatrix &constraints,
+        const double rho = 0.1,
+        const double sigma = 1E-6,
+        const double alpha = 1.6)
+    {
+      hessian_ = hessian;
+      constraints_ = constraints;
+      rho_ = rho;
+      sigma_ = sigma;
+      alpha_ = alpha;
+
+      Hessian kkt = hessian_ + sigma_*Hessian::Identity() + rho_*constraints_.transpose()*constraints_;
+      kkt_inverse_ = kkt.ldlt().solve(Hessian::Identity());
+    }
+
+    //! Set how many iterations are run between convergence checks
+    void setCheckInterval(const int check_interval) { check_interval_ = check_interval; }
+
+    /** \brief Solve the problems from a warm start
+     *
+     * \param q The linear cost of each problem
+     * \param lower The lower bounds of each problem
+     * \param upper The upper bounds of each problem
+     * \param x The primal solution, and its initial value
+     * \param z A x, and its initial value
+     * \param y The dual solution, and its initial value
+     * \param max_iterations The most iterations that are run
+     * \param tolerance The largest primal and dual residuals of a solution,
+     * relative to the size of the terms they're made of
+     * \param iterations The number of iterations that were run
+     *
+     * Returns true if the residuals of all of the problems are within the
+     * tolerance.
+     */
+    bool solve(
+        const Variables &q,
+        const ConstraintValues &lower,
+        const ConstraintValues &upper,
+        Variables &x,
+        ConstraintValues &z,
+        ConstraintValues &y,
+        const int max_iterations,
+        const double tolerance,
+        int &iterations)
+    {
+      iterations = 0;
+      while(iterations < max_iterations) {
+        // Minimize the augmented Lagrangian over x
+        rhs_.noalias() = sigma_*x - q;
+        rhs_.noalias() += constraints_.transpose()*(rho_*z - y);
+        x_tilde_.noalias() = kkt_inverse_*rhs_;
+        z_tilde_.noalias() = constraints_*x_tilde_;
+
+        // Relax, and project onto the constraints
+        x = alpha_*x_tilde_ + (1.0 - alpha_)*x;
+        z_relaxed_ = alpha_*z_tilde_ + (1.0 - alpha_)*z;
+        z = (z_relaxed_ + y/rho_).cwiseMax(lower).cwiseMin(upper);
+        y += rho_*(z_relaxed_ - z);
+
+        iterations++;
+
+        if(iterations % check_interval_ == 0 && this->converged(q, x, z, y, tolerance)) {
+          return true;
+        }
+      }
+
+      return this->converged(q, x, z, y, tolerance);
+    }
+
+  private:
+
+    //! Checks the residuals against the tolerance, relative to the size of
+    //! the terms they're made of
+    bool converged(
+        const Variables &q,
+        const Variables &x,
+        const ConstraintValues &z,
+        const ConstraintValues &y,
+        const double tolerance)
+    {
+      product_constraints_.noalias() = constraints_*x;
+      const double primal_scale = std::max(product_constraints_.cwiseAbs().maxCoeff(), z.cwiseAbs().maxCoeff());
+      if((product_constraints_ - z).cwiseAbs().maxCoeff() > tolerance*(1.0 + primal_scale)) {
+        return false;
+      }
+
+      product_variables_.noalias() = hessian_*x;
+      dual_variables_.noalias() = constraints_.transpose()*y;
+      const double dual_scale = std::max(
+          std::max(product_variables_.cwiseAbs().maxCoeff(), dual_variables_.cwiseAbs().maxCoeff()),
+          q.cwiseAbs().maxCoeff());
+      return (product_variables_ + dual_variables_ + q).cwiseAbs().maxCoeff() <= tolerance*(1.0 + dual_scale);
+    }
+
+    Hessian hessian_;
+    ConstraintMatrix constraints_;
+    Hessian kkt_inverse_;
+    double rho_, sigma_, alpha_;
+    int check_interval_;
+
+    // Workspace
+    Variables rhs_, x_tilde_, product_variables_, dual_variables_;
+    ConstraintValues z_tilde_, z_relaxed_, product_constraints_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_ADMM_QP_SOLVER_H
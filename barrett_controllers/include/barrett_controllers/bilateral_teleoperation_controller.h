@@ -0,0 +1,67 @@
+#ifndef __BARRETT_CONTROLLERS_BILATERAL_TELEOPERATION_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_BILATERAL_TELEOPERATION_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <pluginlib/class_list_macros.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <boost/scoped_ptr.hpp>
+#include <barrett_control_msgs/TeleoperationState.h>
+
+namespace barrett_controllers {
+
+  /** \brief Couples the joints of two arms on the same \c BarrettHW with a
+   * spring and damper, so each one follows the other
+   *
+   * The controller claims \c master_joint_names and \c slave_joint_names,
+   * usually from two different products, and each slave joint is pulled
+   * towards its master joint with the gains \c p_gains and \c d_gains. The
+   * opposite effort, scaled by \c force_feedback, is applied to the master
+   * joint so the operator feels what the slave touches. The difference
+   * between the arms' positions at start is held.
+   *
+   * Both arms are read at the start of the same control cycle and their
+   * efforts are written at its end, so the coupling has no cycles of delay.
+   * The time from the start of the cycle to the computation of the efforts
+   * is published with the coupling state at \c publish_rate.
+   *
+   * Gravity is not compensated, run a \ref GravityCompensationController
+   * for each arm alongside it.
+   */
+  class BilateralTeleoperationController : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    BilateralTeleoperationController();
+
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+  private:
+    std::vector<std::string> master_joint_names_, slave_joint_names_;
+    std::vector<hardware_interface::JointHandle> master_handles_, slave_handles_;
+
+    std::vector<double> p_gains_, d_gains_;
+    double force_feedback_;
+
+    // Slave position minus master position at start
+    std::vector<double> offsets_;
+
+    // Coupling delay
+    double coupling_delay_, max_coupling_delay_;
+
+    // State publishing
+    double publish_rate_;
+    ros::Time last_publish_time_;
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::TeleoperationState> > state_pub_;
+
+    // Workspace
+    std::vector<double> position_errors_, master_efforts_, slave_efforts_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_BILATERAL_TELEOPERATION_CONTROLLER_H
@@ -6,13 +6,15 @@
 #include <pluginlib/class_list_macros.h>
 #include <sensor_msgs/JointState.h>
 #include <realtime_tools/realtime_publisher.h>
+#include <realtime_tools/realtime_buffer.h>
 #include <boost/shared_ptr.hpp>
 #include <barrett_model/semi_absolute_joint_interface.h>
 #include <barrett_control_msgs/SemiAbsoluteCalibrationState.h>
 #include <barrett_control_msgs/JointCommand.h>
 #include <barrett_control_msgs/Calibrate.h>
-#include <control_toolbox/pid.h>
-#include <kdl/velocityprofile_trap.hpp>
+#include <barrett_controllers/static_detector.h>
+#include <barrett_controllers/pid_bank.h>
+#include <barrett_controllers/sync_trap_trajectory.h>
 
 namespace barrett_controllers {
 
@@ -22,6 +24,8 @@ namespace barrett_controllers {
 
     typedef enum {
       IDLE = 0,
+      WAIT_FOR_DEPENDENCIES,
+      RESOLVE_FROM_HINT,
       START_LIMIT_SEARCH,
       LIMIT_SEARCH,
       START_APPROACH_CALIB_REGION,
@@ -37,6 +41,11 @@ namespace barrett_controllers {
       CALIBRATED = 2
     } calibration_state_t;
 
+    //! The maximum number of joints that can be calibrated by one controller
+    static const int MAX_JOINTS = 16;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     CalibrationController();
     ~CalibrationController();
 
@@ -55,27 +64,45 @@ namespace barrett_controllers {
     void position_command_cb(const barrett_control_msgs::JointCommandConstPtr & msg);
   private:
 
-    bool is_static(const int jid, const double position) {
-      // We've reached the limit if the last 10 samples are within the static threshold
-      double min_pos = *std::min_element(position_history_[jid].begin(), position_history_[jid].end());
-      double max_pos = *std::max_element(position_history_[jid].begin(), position_history_[jid].end());
-
-      position_history_[jid].push_back(position);
-      while(position_history_[jid].size() > 100) {
-        position_history_[jid].pop_front();
-      }
-
-      if(position_history_[jid].size() == 100) {
-        if(max_pos - min_pos > static_thresholds_[jid]) {
-          bomb_armed_[jid] = true;
-          return false;
-        } else if(bomb_armed_[jid] && max_pos - min_pos < static_thresholds_[jid]) {
-          return true;
-        } 
-      }
-
-      return false;
-    }
+    //! A command received on one of the command topics
+    struct Command {
+      Command() : seq(0) { }
+      std::vector<double> values;
+      //! The time the command was sent (or received, if it wasn't stamped)
+      ros::Time stamp;
+      //! Incremented with each new command
+      unsigned long seq;
+    };
+
+    //! Store a command so that it can be read by the realtime thread
+    bool write_command(
+        const barrett_control_msgs::JointCommandConstPtr & msg,
+        realtime_tools::RealtimeBuffer<Command> &buffer);
+
+    //! True if a command is recent enough to be applied at the given time
+    bool is_fresh(const Command &command, const ros::Time &time) const;
+
+    //! Get the index of a calibrated joint by name, or -1 if it's unknown
+    int joint_index(const std::string &joint_name) const;
+
+    //! True if all the joints that this joint depends on have been calibrated
+    bool dependencies_satisfied(const int jid) const;
+
+    //! Compute the next calibration step of a single joint
+    calibration_step_t next_step(const int jid, const bool is_static) const;
+
+    /** \brief Compute the position of a joint from its resolver angle and its
+     * position hint
+     *
+     * The resolver angle determines the joint position up to a whole number of
+     * resolver revolutions, and the hint selects the revolution. Returns false
+     * if the hint is too far from every candidate position or the result is
+     * outside of the joint limits.
+     */
+    bool resolve_from_hint(const int jid, double &position) const;
+
+    //! Calibrate all joints waiting in the RESOLVE_FROM_HINT step together
+    void resolve_hinted_joints(const ros::Time &time);
 
     std::vector<barrett_model::SemiAbsoluteJointHandle> joint_handles_;
     boost::shared_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::SemiAbsoluteCalibrationState> > 
@@ -84,6 +111,7 @@ namespace barrett_controllers {
     double publish_rate_;
 
     std::vector<std::string> joint_names_;
+    std::vector<int> static_windows_;
     std::vector<double> 
       static_thresholds_,
       upper_limits_,
@@ -91,6 +119,10 @@ namespace barrett_controllers {
       limit_search_directions_,
       home_positions_,
       resolver_offsets_,
+      hint_positions_,
+      hint_tolerances_,
+      calibration_hints_,
+      resolved_positions_,
       p_gains_,
       i_gains_,
       d_gains_,
@@ -98,25 +130,46 @@ namespace barrett_controllers {
       trap_max_vels_,
       trap_max_accs_,
       trap_durations_,
-      bomb_armed_,
       position_errors_,
       velocity_errors_;
     std::vector<calibration_state_t> calibration_states_;
-    std::vector<control_toolbox::Pid> pids_;
-    calibration_step_t calibration_step_;
-    std::vector<bool> static_joints_;
+    PidBank<MAX_JOINTS> pids_;
+    std::vector<calibration_step_t> calibration_steps_;
 
-    std::vector<std::list<double> > position_history_;
+    // The joints which need to be calibrated before each joint can start
+    std::vector<std::vector<int> > dependencies_;
+
+    // Calibration timing
+    bool calibration_active_;
+    ros::Time calibration_start_time_;
+    double total_calibration_time_;
+    std::vector<ros::Time> joint_calibration_start_times_;
+    std::vector<double> joint_calibration_times_;
+
+    std::vector<StaticDetector> static_detectors_;
     std::vector<double> approximate_offsets_;
     std::vector<double> exact_offsets_;
 
-    std::vector<KDL::VelocityProfile_Trap> trajectories_;
+    SyncTrapTrajectory trajectory_;
     std::vector<ros::Time> trajectory_start_times_;
 
     std::vector<int> active_joints_;
 
+    // The raw positions at which joints waiting for their dependencies are held
+    std::vector<double> hold_positions_;
+    std::vector<bool> holding_;
+
     std::vector<double> effort_command_;
-    std::vector<double> position_command_;
+
+    // Commands are handed from the subscriber threads to the realtime thread
+    // through these buffers
+    realtime_tools::RealtimeBuffer<Command> effort_command_buffer_;
+    realtime_tools::RealtimeBuffer<Command> position_command_buffer_;
+    unsigned long last_position_command_seq_;
+    //! The position commands which were ignored because they were stale
+    unsigned long stale_position_commands_;
+    double command_timeout_;
+
     ros::Subscriber effort_command_sub_;
     ros::Subscriber position_command_sub_;
     ros::ServiceServer calibrate_srv_;
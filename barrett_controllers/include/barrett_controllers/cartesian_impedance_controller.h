@@ -0,0 +1,133 @@
+#ifndef __BARRETT_CONTROLLERS_CARTESIAN_IMPEDANCE_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_CARTESIAN_IMPEDANCE_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <realtime_tools/realtime_buffer.h>
+#include <Eigen/Dense>
+#include <barrett_control_msgs/CartesianImpedanceCommand.h>
+#include <barrett_model/arm_kinematics_interface.h>
+#include <barrett_model/effort_feedforward_interface.h>
+
+namespace barrett_controllers {
+
+  /** \brief Cartesian impedance control of the tip of an arm
+   *
+   * The tip is pulled towards a target pose by a spring and damper along and
+   * about each axis of the root frame. The remaining degrees of freedom are
+   * pulled towards a joint posture through the dynamically-consistent null
+   * space of the tip Jacobian.
+   *
+   * The kinematics and the mass matrix come from one of the generated arm
+   * models (e.g. \c barrett_model::Wam7DofModel), so all of the work is done
+   * on fixed-size matrices and nothing is allocated in \ref update. Gravity is
+   * not compensated, run a \ref GravityCompensationController alongside it.
+   *
+   * The joint state is read in calibrated joint coordinates through the \ref
+   * barrett_model::EffortFeedforwardInterface, and the tip pose and Jacobian
+   * come from the arm's shared \ref barrett_model::ArmKinematicsInterface
+   * cache, found by its joint names. Neither claims the joints.
+   *
+   * The controller refuses to run unless all of the joints are calibrated
+   * when it is started: until it is restarted after calibration, it commands
+   * no efforts and ignores commands. Otherwise the pose (and posture) at
+   * start are held until the first command.
+   */
+  template <class Model>
+  class CartesianImpedanceController : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int N_DOF = Model::N_DOF;
+
+    typedef typename Model::JointVector JointVector;
+    typedef typename Model::Jacobian Jacobian;
+    typedef typename Model::MassMatrix MassMatrix;
+    typedef Eigen::Matrix<double, 6, 1> Vector6;
+    typedef Eigen::Matrix<double, 6, 6> Matrix6;
+    typedef Eigen::Matrix<double, N_DOF, 6> JacobianTranspose;
+
+    CartesianImpedanceController();
+
+    //! Get the calibrated joint state and the arm kinematics after the usual initialization
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+    void command_cb(const barrett_control_msgs::CartesianImpedanceCommandConstPtr &msg);
+
+  private:
+
+    //! True if the positions of all joints are known
+    bool is_calibrated() const;
+
+    //! Make the current pose (and posture, if none is given) the target
+    void hold_current_pose();
+
+    // Unaligned types, which can be stored in the command buffer
+    typedef Eigen::Matrix<double, 6, 1, Eigen::DontAlign> UnalignedVector6;
+    typedef Eigen::Matrix<double, N_DOF, 1, Eigen::DontAlign> UnalignedJointVector;
+
+    //! A command received on the command topic
+    struct Command {
+      Command() : has_gains(false), has_posture(false), seq(0) { }
+      Eigen::Vector3d position;
+      Eigen::Matrix3d rotation;
+      bool has_gains;
+      UnalignedVector6 stiffness, damping;
+      bool has_posture;
+      UnalignedJointVector posture;
+      //! Incremented with each new command
+      unsigned long seq;
+    };
+
+    std::vector<std::string> joint_names_;
+    std::vector<hardware_interface::JointHandle> joint_handles_;
+    std::vector<barrett_model::EffortFeedforwardHandle> state_handles_;
+    barrett_model::ArmKinematicsHandle kinematics_handle_;
+    //! False if the controller was started before the joints were calibrated
+    volatile bool active_;
+
+    // Commands are handed from the subscriber thread to the realtime thread
+    // through this buffer
+    realtime_tools::RealtimeBuffer<Command> command_buffer_;
+    unsigned long last_command_seq_;
+    ros::Subscriber command_sub_;
+
+    // Target
+    Eigen::Vector3d target_position_;
+    Eigen::Matrix3d target_rotation_;
+    Vector6 stiffness_, damping_;
+    JointVector posture_;
+    JointVector null_stiffness_, null_damping_;
+    bool hold_posture_;
+    double regularization_;
+
+    // Workspace
+    JointVector positions_, velocities_, efforts_, null_efforts_;
+    Eigen::Matrix3d tip_rotation_;
+    Eigen::Vector3d tip_position_;
+    Jacobian jacobian_;
+    MassMatrix mass_;
+    Eigen::LDLT<MassMatrix> mass_ldlt_;
+    JacobianTranspose inverse_mass_jacobian_t_;
+    Matrix6 inverse_task_mass_;
+    Eigen::LDLT<Matrix6> task_mass_ldlt_;
+    JacobianTranspose generalized_inverse_;
+    Vector6 error_, wrench_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_CARTESIAN_IMPEDANCE_CONTROLLER_H
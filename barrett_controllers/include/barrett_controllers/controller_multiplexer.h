@@ -0,0 +1,147 @@
+#ifndef __BARRETT_CONTROLLERS_CONTROLLER_MULTIPLEXER_H
+#define __BARRETT_CONTROLLERS_CONTROLLER_MULTIPLEXER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <pluginlib/class_loader.h>
+#include <realtime_tools/realtime_buffer.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <barrett_control_msgs/SelectController.h>
+#include <barrett_control_msgs/MultiplexerState.h>
+#include <barrett_model/semi_absolute_joint_interface.h>
+
+namespace barrett_controllers {
+
+  /** \brief Keeps several effort controllers loaded on the same joints, and
+   * switches between them within one control cycle
+   *
+   * Each name in \c controllers is a child controller, which is loaded from
+   * its \c type parameter in the child's namespace under the multiplexer's
+   * one, and initialized when the multiplexer is. Each child gets a robot
+   * of its own, which only holds \c joint_names:
+   *  - a \c hardware_interface::EffortJointInterface and, if the hardware
+   *    has one, a \ref barrett_model::SemiAbsoluteJointInterface, which read
+   *    the real joint states (and calibration), but write the child's
+   *    efforts to buffers of its own. So the \ref CalibrationController can
+   *    be a child, e.g. to hand over to another child once it's done.
+   *  - the hardware's read-only interfaces, the \c
+   *    hardware_interface::JointStateInterface, \ref
+   *    barrett_model::EffortFeedforwardInterface and \ref
+   *    barrett_model::ArmKinematicsInterface, as they are.
+   *
+   * The joints claimed by the children are added to the multiplexer's
+   * claims, which already cover \c joint_names.
+   *
+   * The efforts of the active child are applied to the joints. The first
+   * child is active when the multiplexer starts, and another one is selected
+   * with the \c select service. The switch happens at the start of the next
+   * cycle: the new child is started if it isn't running yet, and its efforts
+   * are blended in linearly over \c blend_cycles cycles, while the previous
+   * child keeps being updated. A selection which arrives during a blend is
+   * applied once the blend is finished.
+   *
+   * Without \c shadow, the new child's \c starting() is called from the
+   * multiplexer's \c update(), in the realtime thread, so it has to be
+   * realtime-safe (e.g. not allocate or lock). The controllers in this
+   * package are. With \c shadow, all children are started from the
+   * multiplexer's \c starting(), like any controller.
+   *
+   * If \c shadow is set, all of the children are started with the
+   * multiplexer and updated every cycle, so a child's state (e.g. integrators
+   * or filters) is already settled when it's switched to. Otherwise, only the
+   * active child (and the previous one during a blend) is running. Children
+   * which refuse to run if they are started before the arm is calibrated
+   * (e.g. the \ref CartesianImpedanceController) must not be shadowed if
+   * the multiplexer is started before the calibration.
+   *
+   * The active child and the blend are published at \c publish_rate.
+   */
+  class ControllerMultiplexer : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    ControllerMultiplexer();
+    virtual ~ControllerMultiplexer();
+
+    //! Load and initialize the children after the usual initialization
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+    bool select_srv_cb(
+        barrett_control_msgs::SelectController::Request &req,
+        barrett_control_msgs::SelectController::Response &resp);
+
+  private:
+
+    //! A selection received on the select service
+    struct Selection {
+      Selection() : index(0), seq(0) { }
+      int index;
+      //! Incremented with each new selection
+      unsigned long seq;
+    };
+
+    //! A loaded child controller, and the robot it commands
+    struct Child {
+      std::string name;
+      boost::shared_ptr<controller_interface::ControllerBase> controller;
+      boost::shared_ptr<hardware_interface::RobotHW> robot_hw;
+      boost::shared_ptr<hardware_interface::EffortJointInterface> interface;
+      boost::shared_ptr<barrett_model::SemiAbsoluteJointInterface> semi_absolute_interface;
+      std::vector<double> efforts;
+      bool running;
+    };
+
+    //! Load the children, and give each one a robot of its own
+    bool load_children(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &nh,
+        std::set<std::string> &claimed_resources);
+
+    void start_child(Child &child, const ros::Time& time);
+    void stop_child(Child &child, const ros::Time& time);
+
+    std::vector<std::string> joint_names_;
+    std::vector<hardware_interface::JointHandle> joint_handles_;
+
+    // The loader has to outlive the children it created
+    boost::scoped_ptr<pluginlib::ClassLoader<controller_interface::ControllerBase> > controller_loader_;
+    std::vector<Child> children_;
+
+    bool shadow_;
+    int blend_cycles_;
+
+    // Selections are handed from the service thread to the realtime thread
+    // through this buffer
+    realtime_tools::RealtimeBuffer<Selection> selection_buffer_;
+    unsigned long last_selection_seq_;
+    ros::ServiceServer select_srv_;
+
+    // Switching state, previous_ is -1 when no blend is in progress
+    int active_, previous_;
+    int blend_count_;
+    double blend_;
+    unsigned long switch_count_;
+
+    // State publishing
+    double publish_rate_;
+    ros::Time last_publish_time_;
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::MultiplexerState> > state_pub_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_CONTROLLER_MULTIPLEXER_H
@@ -0,0 +1,42 @@
+#ifndef __BARRETT_CONTROLLERS_FRICTION_COMPENSATION_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_FRICTION_COMPENSATION_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <pluginlib/class_list_macros.h>
+#include <barrett_model/effort_feedforward_interface.h>
+#include <barrett_model/friction_table.h>
+
+namespace barrett_controllers {
+
+  /** \brief Adds the efforts which cancel the friction of each joint at its
+   * current velocity to the efforts commanded by other controllers
+   *
+   * The friction curves are loaded from \c friction_file, which is written by
+   * \c identify_friction.py, and are scaled by \c scale. Only the joints in
+   * \c joint_names are compensated, or all of the joints in the file if it
+   * isn't given. Nothing is added to a joint while its arm is in collision.
+   *
+   * The same compensation can be applied by \c BarrettHW itself with the \c
+   * friction_file parameter of each product, in which case this controller
+   * shouldn't also be running.
+   */
+  class FrictionCompensationController : public controller_interface::Controller<barrett_model::EffortFeedforwardInterface>
+  {
+  public:
+    FrictionCompensationController();
+
+    virtual bool init(
+        barrett_model::EffortFeedforwardInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+  private:
+    std::vector<barrett_model::EffortFeedforwardHandle> joint_handles_;
+    std::vector<barrett_model::FrictionTable> friction_tables_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_FRICTION_COMPENSATION_CONTROLLER_H
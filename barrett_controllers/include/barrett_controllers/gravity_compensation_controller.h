@@ -0,0 +1,55 @@
+#ifndef __BARRETT_CONTROLLERS_GRAVITY_COMPENSATION_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_GRAVITY_COMPENSATION_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <pluginlib/class_list_macros.h>
+#include <Eigen/Dense>
+#include <barrett_model/effort_feedforward_interface.h>
+#include <barrett_model/gravity_solver.h>
+
+namespace barrett_controllers {
+
+  /** \brief Adds the efforts which hold a WAM against gravity to the efforts
+   * commanded by other controllers
+   *
+   * The chain from \c root_link to \c tip_link is built from the URDF in \c
+   * robot_description. No efforts are added until all of the joints in the
+   * chain are calibrated.
+   *
+   * If \c payload_file is given, the payload identified by \ref
+   * PayloadIdentificationController is loaded from it and rigidly attached
+   * to the tip link.
+   */
+  class GravityCompensationController : public controller_interface::Controller<barrett_model::EffortFeedforwardInterface>
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    //! The largest chain supported (the 7-DOF WAM)
+    static const int MAX_DOF = 7;
+
+    typedef barrett_model::GravitySolver<MAX_DOF>::JointVector JointVector;
+
+    GravityCompensationController();
+
+    virtual bool init(
+        barrett_model::EffortFeedforwardInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+  private:
+    std::vector<std::string> joint_names_;
+    std::vector<barrett_model::EffortFeedforwardHandle> joint_handles_;
+
+    barrett_model::GravitySolver<MAX_DOF> gravity_solver_;
+
+    // Workspace
+    JointVector positions_;
+    JointVector efforts_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_GRAVITY_COMPENSATION_CONTROLLER_H
@@ -0,0 +1,96 @@
+#ifndef __BARRETT_CONTROLLERS_JOINT_TRAJECTORY_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_JOINT_TRAJECTORY_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <barrett_controllers/pid_bank.h>
+#include <barrett_controllers/quintic_trajectory.h>
+#include <barrett_controllers/realtime_double_buffer.h>
+#include <barrett_model/effort_feedforward_interface.h>
+
+namespace barrett_controllers {
+
+  /** \brief Follows joint trajectories with a PID on each joint
+   *
+   * Trajectories arrive as trajectory_msgs/JointTrajectory on the command
+   * topic, and are interpolated with quintic splines through their waypoints.
+   * Waypoints without velocities or accelerations use zero. A new trajectory
+   * replaces the current one at the time it reaches the realtime thread: its
+   * waypoints in the past are dropped, and it is joined to the current
+   * desired state with a quintic segment. An empty trajectory holds the
+   * current desired positions.
+   *
+   * Storage for \c max_points waypoints is allocated by \ref init, and
+   * trajectories are handed to the realtime thread through a \ref
+   * RealtimeDoubleBuffer, so \ref update never allocates or locks.
+   *
+   * The joint state is read in calibrated joint coordinates through the \ref
+   * barrett_model::EffortFeedforwardInterface, which doesn't claim the
+   * joints. The controller refuses to run unless all of the joints are
+   * calibrated when it is started: until it is restarted after calibration,
+   * it commands no efforts and ignores trajectories.
+   *
+   * Gravity is not compensated, run a \ref GravityCompensationController
+   * alongside it.
+   */
+  class JointTrajectoryController : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    //! The maximum number of joints that can be controlled by one controller
+    static const int MAX_JOINTS = 16;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    JointTrajectoryController();
+
+    //! Get the calibrated joint state after the usual initialization
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+    void command_cb(const trajectory_msgs::JointTrajectoryConstPtr &msg);
+
+  private:
+    //! True if the positions of all joints are known
+    bool is_calibrated() const;
+
+    std::vector<std::string> joint_names_;
+    std::vector<hardware_interface::JointHandle> joint_handles_;
+    std::vector<barrett_model::EffortFeedforwardHandle> state_handles_;
+    //! False if the controller was started before the joints were calibrated
+    volatile bool active_;
+
+    PidBank<MAX_JOINTS> pids_;
+
+    // Trajectories are handed from the subscriber thread to the realtime
+    // thread through this buffer
+    RealtimeDoubleBuffer<QuinticTrajectory> trajectories_;
+    size_t segment_;
+    ros::Subscriber command_sub_;
+
+    // Subscriber workspace
+    std::vector<int> message_indices_;
+    std::vector<double> point_positions_, point_velocities_, point_accelerations_;
+
+    // Realtime workspace
+    std::vector<double>
+      desired_positions_,
+      desired_velocities_,
+      desired_accelerations_,
+      efforts_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_JOINT_TRAJECTORY_CONTROLLER_H
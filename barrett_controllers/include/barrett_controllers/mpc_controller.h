@@ -0,0 +1,164 @@
+#ifndef __BARRETT_CONTROLLERS_MPC_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_MPC_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <realtime_tools/realtime_buffer.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <boost/scoped_ptr.hpp>
+#include <Eigen/Dense>
+#include <barrett_control_msgs/JointCommand.h>
+#include <barrett_control_msgs/MpcState.h>
+#include <barrett_controllers/admm_qp_solver.h>
+#include <barrett_controllers/mpc_problem.h>
+#include <barrett_model/arm_kinematics_interface.h>
+#include <barrett_model/effort_feedforward_interface.h>
+
+namespace barrett_controllers {
+
+  /** \brief Moves the joints of an arm to goal positions with a
+   * short-horizon model-predictive controller
+   *
+   * Every cycle, the joint accelerations over the next \c HORIZON steps of
+   * \c step seconds are planned from the measured state, so that the
+   * predicted positions approach the goal while the velocities stay within
+   * the URDF's velocity limits and the accelerations within bounds which
+   * respect the URDF's effort limits. A joint which is already faster than
+   * its velocity limit is planned to brake back within it as hard as those
+   * bounds allow. The first planned accelerations are
+   * turned into efforts with the arm's inverse dynamics, which include
+   * gravity, so no \ref GravityCompensationController should run alongside
+   * it.
+   *
+   * The joints are planned as independent double integrators, which share
+   * the same \ref MpcProblem up to their linear costs and bounds, and are
+   * solved together by an \ref AdmmQpSolver warm-started from the previous
+   * cycle's solution. The solver runs for at most \c max_iterations; if it
+   * hasn't converged by then, the previous converged solution is followed
+   * instead, and once that runs out the joints are braked.
+   *
+   * Goal positions are received as barrett_control_msgs/JointCommand on the
+   * command topic, and the current positions are held until the first one
+   * arrives. The solver's iterations and solve time are published with the
+   * controller's state at \c publish_rate.
+   *
+   * The dynamics come from one of the generated arm models (e.g. \c
+   * barrett_model::Wam7DofModel), evaluated at the calibrated joint state of
+   * the \ref barrett_model::EffortFeedforwardInterface. The gravity torques
+   * come from the arm's shared \ref barrett_model::ArmKinematicsInterface
+   * cache, found by its joint names, so gravity is set on the hardware.
+   * Neither interface claims the joints.
+   *
+   * The controller refuses to run unless all of the joints are calibrated
+   * when it is started: until it is restarted after calibration, it commands
+   * no efforts and ignores commands.
+   */
+  template <class Model>
+  class MpcController : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int N_DOF = Model::N_DOF;
+    //! The number of planned steps
+    static const int HORIZON = 20;
+
+    typedef typename Model::JointVector JointVector;
+    typedef typename Model::MassMatrix MassMatrix;
+    typedef AdmmQpSolver<HORIZON, 2*HORIZON, N_DOF> Solver;
+    typedef MpcProblem<HORIZON> Problem;
+
+    MpcController();
+
+    //! Get the calibrated joint state and the arm kinematics after the usual initialization
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+    void command_cb(const barrett_control_msgs::JointCommandConstPtr &msg);
+
+  private:
+
+    // Unaligned, so it can be stored in the command buffer
+    typedef Eigen::Matrix<double, N_DOF, 1, Eigen::DontAlign> UnalignedJointVector;
+
+    //! A command received on the command topic
+    struct Command {
+      Command() : seq(0) { }
+      UnalignedJointVector goal;
+      //! Incremented with each new command
+      unsigned long seq;
+    };
+
+    //! True if the positions of all joints are known
+    bool is_calibrated() const;
+
+    std::vector<std::string> joint_names_;
+    std::vector<hardware_interface::JointHandle> joint_handles_;
+    std::vector<barrett_model::EffortFeedforwardHandle> state_handles_;
+    barrett_model::ArmKinematicsHandle kinematics_handle_;
+    //! False if the controller was started before the joints were calibrated
+    volatile bool active_;
+
+    // Commands are handed from the subscriber thread to the realtime thread
+    // through this buffer
+    realtime_tools::RealtimeBuffer<Command> command_buffer_;
+    unsigned long last_command_seq_;
+    ros::Subscriber command_sub_;
+
+    // Limits
+    JointVector velocity_limits_, effort_limits_, acceleration_limits_;
+
+    // Problem
+    double step_;
+    double position_weight_, velocity_weight_;
+    int max_iterations_;
+    double tolerance_;
+    Problem problem_;
+    Solver solver_;
+
+    // Solution, which is also the warm start of the next solve
+    typename Solver::Variables accelerations_;
+    typename Solver::ConstraintValues constraint_values_, duals_;
+
+    // The last solution which converged, and when it was computed
+    typename Solver::Variables previous_accelerations_;
+    bool has_previous_;
+    ros::Time previous_time_;
+
+    // Target
+    JointVector goal_;
+
+    // State publishing
+    double publish_rate_;
+    ros::Time last_publish_time_;
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::MpcState> > state_pub_;
+    int iterations_;
+    double solve_time_;
+    bool converged_;
+    unsigned long fallback_count_;
+
+    // Workspace
+    JointVector positions_, velocities_, accelerations_cmd_, zero_, bias_, efforts_;
+    Eigen::Vector3d zero_gravity_;
+    JointVector lower_accelerations_, upper_accelerations_;
+    MassMatrix mass_;
+    typename Solver::Variables linear_cost_;
+    typename Solver::ConstraintValues lower_, upper_;
+    typename Problem::HorizonVector joint_cost_;
+    typename Problem::ConstraintVector joint_lower_, joint_upper_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_MPC_CONTROLLER_H
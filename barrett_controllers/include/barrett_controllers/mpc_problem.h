@@ -0,0 +1,147 @@
+#ifndef __BARRETT_CONTROLLERS_MPC_PROBLEM_H
+#define __BARRETT_CONTROLLERS_MPC_PROBLEM_H
+
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+namespace barrett_controllers {
+
+  /** \brief The quadratic program which \ref MpcController solves for each
+   * joint
+   *
+   * A joint is planned as a double integrator with a constant acceleration in
+   * each of the \c HORIZON steps, so its predicted velocities and positions
+   * are linear in the accelerations:
+   *
+   *   v = v0 + B u
+   *   p = p0 + v0 t + C u
+   *
+   * The cost penalizes the predicted distances to the goal, the predicted
+   * velocities and the accelerations, and the constraints bound the
+   * accelerations and the velocity changes B u. All joints share the Hessian
+   * and the constraint matrix, and only their linear costs and bounds depend
+   * on their state.
+   */
+  template <int HORIZON>
+  class MpcProblem
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef Eigen::Matrix<double, HORIZON, 1> HorizonVector;
+    typedef Eigen::Matrix<double, HORIZON, HORIZON> HorizonMatrix;
+    typedef Eigen::Matrix<double, 2*HORIZON, HORIZON> ConstraintMatrix;
+    typedef Eigen::Matrix<double, 2*HORIZON, 1> ConstraintVector;
+
+    MpcProblem() :
+      step_(0.0),
+      position_weight_(0.0),
+      velocity_weight_(0.0),
+      cost_scale_(1.0)
+    {
+      times_.setZero();
+      hessian_.setZero();
+      constraints_.setZero();
+      position_offset_gradient_.setZero();
+      position_velocity_gradient_.setZero();
+      velocity_gradient_.setZero();
+    }
+
+    //! Build the problem for steps of \c step seconds
+    void setup(
+        const double step,
+        const double position_weight,
+        const double velocity_weight,
+        const double acceleration_weight)
+    {
+      step_ = step;
+      position_weight_ = position_weight;
+      velocity_weight_ = velocity_weight;
+
+      HorizonMatrix velocity_map = HorizonMatrix::Zero();
+      HorizonMatrix position_map = HorizonMatrix::Zero();
+      for(int k=0; k<HORIZON; k++) {
+        times_[k] = (k + 1)*step_;
+        for(int i=0; i<=k; i++) {
+          velocity_map(k,i) = step_;
+          position_map(k,i) = step_*step_*(k - i + 0.5);
+        }
+      }
+
+      hessian_ =
+        position_weight_*position_map.transpose()*position_map
+        + velocity_weight_*velocity_map.transpose()*velocity_map
+        + acceleration_weight*HorizonMatrix::Identity();
+
+      // Normalize the cost, so the solver's step size doesn't depend on the
+      // weights or the step
+      cost_scale_ = hessian_.diagonal().maxCoeff();
+      hessian_ /= cost_scale_;
+
+      // The accelerations and the velocity changes are bounded
+      constraints_.template topRows<HORIZON>().setIdentity();
+      constraints_.template bottomRows<HORIZON>() = velocity_map;
+
+      // The sums of the predicted positions' and velocities' gradients
+      position_offset_gradient_ = position_map.transpose()*HorizonVector::Ones();
+      position_velocity_gradient_ = position_map.transpose()*times_;
+      velocity_gradient_ = velocity_map.transpose()*HorizonVector::Ones();
+    }
+
+    const HorizonMatrix& getHessian() const { return hessian_; }
+    const ConstraintMatrix& getConstraints() const { return constraints_; }
+    double getStep() const { return step_; }
+
+    //! The linear cost of a joint \c position_error from its goal
+    void computeCost(
+        const double position_error,
+        const double velocity,
+        HorizonVector &cost) const
+    {
+      cost = (
+          position_weight_*position_error*position_offset_gradient_
+          + position_weight_*velocity*position_velocity_gradient_
+          + velocity_weight_*velocity*velocity_gradient_)/cost_scale_;
+    }
+
+    /** \brief The bounds of a joint's accelerations and velocity changes
+     *
+     * The accelerations have to be within [\c lower_acceleration, \c
+     * upper_acceleration], which has to contain zero, and the velocity after
+     * each step within +/- \c velocity_limit. A joint which is already faster
+     * than its limit can't meet that in the first steps, which would make the
+     * problem infeasible. Each velocity bound is relaxed to the velocity
+     * reached by braking with the largest allowed acceleration, so the joint
+     * brakes until it's back within the limit.
+     */
+    void computeBounds(
+        const double velocity,
+        const double velocity_limit,
+        const double lower_acceleration,
+        const double upper_acceleration,
+        ConstraintVector &lower,
+        ConstraintVector &upper) const
+    {
+      lower.template head<HORIZON>().setConstant(lower_acceleration);
+      upper.template head<HORIZON>().setConstant(upper_acceleration);
+      for(int k=0; k<HORIZON; k++) {
+        lower[HORIZON + k] = std::min(-velocity_limit - velocity, times_[k]*upper_acceleration);
+        upper[HORIZON + k] = std::max(velocity_limit - velocity, times_[k]*lower_acceleration);
+      }
+    }
+
+  private:
+    double step_;
+    double position_weight_, velocity_weight_;
+    double cost_scale_;
+    //! The time at the end of each step
+    HorizonVector times_;
+    HorizonMatrix hessian_;
+    ConstraintMatrix constraints_;
+    HorizonVector position_offset_gradient_, position_velocity_gradient_, velocity_gradient_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_MPC_PROBLEM_H
@@ -0,0 +1,263 @@
+#ifndef __BARRETT_CONTROLLERS_PAYLOAD_ESTIMATOR_H
+#define __BARRETT_CONTROLLERS_PAYLOAD_ESTIMATOR_H
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+namespace barrett_controllers {
+
+  /** \brief Recursive least-squares estimate of the inertial parameters of a
+   * payload on the tip of an arm, and the friction of each joint
+   *
+   * The links of the arm are described by one of the generated arm models
+   * (e.g. \c barrett_model::Wam7DofModel), which come from the URDF inertias,
+   * and the torques that they don't explain are attributed to the payload and
+   * to friction. These torques are linear in the parameters:
+   *
+   *   tau - ID(q, qd, qdd) = Y(q, qd, qdd) theta
+   *
+   * with the parameters ordered as
+   *   - the payload mass [kg]
+   *   - its first mass moment [kg m] in the tip frame
+   *   - its inertia [kg m^2] about the tip origin in the tip frame (xx, xy,
+   *     xz, yy, yz, zz)
+   *   - the viscous friction [Nm/(rad/s)] of each joint
+   *   - the Coulomb friction [Nm] of each joint
+   *
+   * The accelerations are differentiated from the velocities, so the
+   * regressor and the torques are both low-pass filtered, which leaves their
+   * relation unchanged. Each joint's row is then added to the estimate with a
+   * recursive least-squares update, with exponential forgetting once per
+   * cycle. Everything is fixed-size, so memory and time per \ref update are
+   * bounded and nothing is allocated.
+   */
+  template <class Model>
+  class PayloadEstimator
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int N_DOF = Model::N_DOF;
+    static const int N_PAYLOAD_PARAMS = 10;
+    static const int N_PARAMS = N_PAYLOAD_PARAMS + 2*N_DOF;
+
+    typedef typename Model::JointVector JointVector;
+    typedef typename Model::Jacobian Jacobian;
+    typedef Eigen::Matrix<double, N_PARAMS, 1> ParameterVector;
+    typedef Eigen::Matrix<double, N_DOF, N_PARAMS> Regressor;
+    typedef Eigen::Matrix<double, N_PARAMS, N_PARAMS> Covariance;
+    typedef Eigen::Matrix<double, 6, N_PAYLOAD_PARAMS> WrenchRegressor;
+
+    PayloadEstimator() :
+      gravity_(0.0, 0.0, -9.81),
+      forgetting_factor_(0.9999),
+      filter_cutoff_(10.0),
+      coulomb_velocity_(0.01),
+      initial_covariance_(1E3),
+      initialized_(false),
+      n_updates_(0)
+    {
+      this->reset();
+    }
+
+    //! Set the gravity vector in the frame of the root link
+    void setGravityVector(const Eigen::Vector3d &gravity) { gravity_ = gravity; }
+
+    //! Set the factor (0, 1] by which old measurements are discounted each cycle
+    void setForgettingFactor(const double forgetting_factor) { forgetting_factor_ = forgetting_factor; }
+
+    //! Set the cutoff frequency [Hz] of the measurement filter
+    void setFilterCutoff(const double filter_cutoff) { filter_cutoff_ = filter_cutoff; }
+
+    //! Set the velocity [rad/s] below which Coulomb friction is smoothed
+    void setCoulombVelocity(const double coulomb_velocity) { coulomb_velocity_ = coulomb_velocity; }
+
+    //! Set the initial variance of each parameter
+    void setInitialCovariance(const double initial_covariance) { initial_covariance_ = initial_covariance; }
+
+    //! Discard all measurements
+    void reset() {
+      parameters_.setZero();
+      covariance_ = initial_covariance_*Covariance::Identity();
+      filtered_regressor_.setZero();
+      filtered_torques_.setZero();
+      initialized_ = false;
+      n_updates_ = 0;
+    }
+
+    /** \brief Add a measurement
+     *
+     * \param q The joint positions
+     * \param qd The joint velocities
+     * \param tau The joint torques applied to the arm
+     * \param dt The time since the last update [s]
+     */
+    void update(
+        const JointVector &q,
+        const JointVector &qd,
+        const JointVector &tau,
+        const double dt)
+    {
+      if(!initialized_ || dt <= 0.0) {
+        previous_velocities_ = qd;
+        initialized_ = true;
+        return;
+      }
+
+      accelerations_ = (qd - previous_velocities_)/dt;
+      previous_velocities_ = qd;
+
+      // Torques which aren't explained by the links of the arm
+      this->computeRegressor(q, qd, accelerations_, regressor_);
+      Model::inverse_dynamics(q, qd, accelerations_, gravity_, link_torques_);
+      torques_ = tau - link_torques_;
+
+      // Filter both sides of the regression the same way
+      const double alpha = 1.0 - std::exp(-2.0*M_PI*filter_cutoff_*dt);
+      filtered_regressor_ += alpha*(regressor_ - filtered_regressor_);
+      filtered_torques_ += alpha*(torques_ - filtered_torques_);
+
+      // Recursive least squares, one joint at a time
+      covariance_ /= forgetting_factor_;
+      for(int j=0; j<N_DOF; j++) {
+        gain_.noalias() = covariance_*filtered_regressor_.row(j).transpose();
+        const double innovation = filtered_torques_[j] - filtered_regressor_.row(j).dot(parameters_);
+        const double denominator = 1.0 + filtered_regressor_.row(j).dot(gain_);
+        parameters_ += gain_*(innovation/denominator);
+        covariance_.noalias() -= (gain_/denominator)*gain_.transpose();
+      }
+
+      n_updates_++;
+    }
+
+    /** \brief Compute the regressor of the payload and friction torques
+     *
+     * The tip Jacobian's time derivative is taken by finite differences
+     * along the joint velocities.
+     */
+    void computeRegressor(
+        const JointVector &q,
+        const JointVector &qd,
+        const JointVector &qdd,
+        Regressor &regressor)
+    {
+      static const double h = 1E-6;
+
+      Model::tip_jacobian(q, tip_rotation_, tip_position_, jacobian_);
+      perturbed_positions_ = q + h*qd;
+      Model::tip_jacobian(perturbed_positions_, perturbed_rotation_, perturbed_position_, jacobian_dot_);
+      jacobian_dot_ = (jacobian_dot_ - jacobian_)/h;
+
+      // Motion of the tip in the tip frame, with gravity as an upward
+      // acceleration
+      const Eigen::Matrix3d &R = tip_rotation_;
+      const Eigen::Vector3d w = R.transpose()*(jacobian_.template bottomRows<3>()*qd);
+      const Eigen::Vector3d wd = R.transpose()*(
+          jacobian_.template bottomRows<3>()*qdd + jacobian_dot_.template bottomRows<3>()*qd);
+      const Eigen::Vector3d a = R.transpose()*(
+          jacobian_.template topRows<3>()*qdd + jacobian_dot_.template topRows<3>()*qd - gravity_);
+
+      // Newton-Euler equations of the payload about the tip origin
+      const Eigen::Matrix3d w_cross = skew(w);
+      wrench_regressor_.setZero();
+      wrench_regressor_.template block<3,1>(0,0) = a;
+      wrench_regressor_.template block<3,3>(0,1) = skew(wd) + w_cross*w_cross;
+      wrench_regressor_.template block<3,3>(3,1) = -skew(a);
+      wrench_regressor_.template block<3,6>(3,4) = inertia_map(wd) + w_cross*inertia_map(w);
+
+      // Back to the root frame, and onto the joints
+      wrench_regressor_.template topRows<3>() = R*wrench_regressor_.template topRows<3>();
+      wrench_regressor_.template bottomRows<3>() = R*wrench_regressor_.template bottomRows<3>();
+
+      regressor.setZero();
+      regressor.template leftCols<N_PAYLOAD_PARAMS>().noalias() = jacobian_.transpose()*wrench_regressor_;
+
+      // Friction
+      for(int j=0; j<N_DOF; j++) {
+        regressor(j, N_PAYLOAD_PARAMS + j) = qd[j];
+        regressor(j, N_PAYLOAD_PARAMS + N_DOF + j) = std::tanh(qd[j]/coulomb_velocity_);
+      }
+    }
+
+    const ParameterVector& getParameters() const { return parameters_; }
+    const Covariance& getCovariance() const { return covariance_; }
+    unsigned long getNumberOfUpdates() const { return n_updates_; }
+
+    /** \brief The payload's mass, center of mass and inertia about its center
+     * of mass, in the tip frame
+     *
+     * The center of mass and inertia are zero if the mass isn't positive.
+     */
+    void getPayload(
+        double &mass,
+        Eigen::Vector3d &com,
+        Eigen::Matrix3d &inertia) const
+    {
+      mass = parameters_[0];
+      if(mass <= 0.0) {
+        com.setZero();
+        inertia.setZero();
+        return;
+      }
+
+      com = parameters_.template segment<3>(1)/mass;
+      inertia <<
+        parameters_[4], parameters_[5], parameters_[6],
+        parameters_[5], parameters_[7], parameters_[8],
+        parameters_[6], parameters_[8], parameters_[9];
+      // Parallel axis theorem
+      inertia -= mass*(com.squaredNorm()*Eigen::Matrix3d::Identity() - com*com.transpose());
+    }
+
+    double getViscousFriction(const int j) const { return parameters_[N_PAYLOAD_PARAMS + j]; }
+    double getCoulombFriction(const int j) const { return parameters_[N_PAYLOAD_PARAMS + N_DOF + j]; }
+
+  private:
+
+    static Eigen::Matrix3d skew(const Eigen::Vector3d &v) {
+      Eigen::Matrix3d m;
+      m <<
+        0.0, -v.z(), v.y(),
+        v.z(), 0.0, -v.x(),
+        -v.y(), v.x(), 0.0;
+      return m;
+    }
+
+    //! The matrix which multiplies the inertia parameters to give I*v
+    static Eigen::Matrix<double, 3, 6> inertia_map(const Eigen::Vector3d &v) {
+      Eigen::Matrix<double, 3, 6> m;
+      m <<
+        v.x(), v.y(), v.z(), 0.0, 0.0, 0.0,
+        0.0, v.x(), 0.0, v.y(), v.z(), 0.0,
+        0.0, 0.0, v.x(), 0.0, v.y(), v.z();
+      return m;
+    }
+
+    Eigen::Vector3d gravity_;
+    double forgetting_factor_;
+    double filter_cutoff_;
+    double coulomb_velocity_;
+    double initial_covariance_;
+
+    // Estimate
+    bool initialized_;
+    unsigned long n_updates_;
+    ParameterVector parameters_;
+    Covariance covariance_;
+    Regressor filtered_regressor_;
+    JointVector filtered_torques_, previous_velocities_;
+
+    // Workspace
+    JointVector accelerations_, link_torques_, torques_, perturbed_positions_;
+    Regressor regressor_;
+    ParameterVector gain_;
+    Eigen::Matrix3d tip_rotation_, perturbed_rotation_;
+    Eigen::Vector3d tip_position_, perturbed_position_;
+    Jacobian jacobian_, jacobian_dot_;
+    WrenchRegressor wrench_regressor_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_PAYLOAD_ESTIMATOR_H
@@ -0,0 +1,52 @@
+#ifndef __BARRETT_CONTROLLERS_PAYLOAD_FILE_H
+#define __BARRETT_CONTROLLERS_PAYLOAD_FILE_H
+
+#include <string>
+
+#include <Eigen/Dense>
+
+namespace barrett_controllers {
+
+  /** \brief The identified payload of an arm, as it's stored on disk
+   *
+   * The joint friction which is identified along with the payload isn't
+   * stored, since joint friction is compensated from the lookup tables of
+   * \c identify_friction.py.
+   */
+  struct PayloadParameters
+  {
+    PayloadParameters() :
+      link(""),
+      mass(0.0),
+      com(Eigen::Vector3d::Zero()),
+      inertia(Eigen::Matrix3d::Zero())
+    { }
+
+    //! The link the payload is attached to
+    std::string link;
+    //! Mass [kg]
+    double mass;
+    //! Center of mass [m] in the frame of the link
+    Eigen::Vector3d com;
+    //! Inertia [kg m^2] about the center of mass, in the frame of the link
+    Eigen::Matrix3d inertia;
+  };
+
+  /** \brief Write payload parameters to a file
+   *
+   * Like the joint calibrations, the parameters are first written to a
+   * temporary file next to \c path, which is synced to disk and then renamed
+   * over \c path.
+   */
+  bool save_payload(
+      const std::string &path,
+      const PayloadParameters &payload);
+
+  //! Read payload parameters written by \ref save_payload
+  bool load_payload(
+      const std::string &path,
+      PayloadParameters &payload);
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_PAYLOAD_FILE_H
@@ -0,0 +1,101 @@
+#ifndef __BARRETT_CONTROLLERS_PAYLOAD_IDENTIFICATION_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_PAYLOAD_IDENTIFICATION_CONTROLLER_H
+
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <std_srvs/Empty.h>
+#include <boost/thread/mutex.hpp>
+#include <barrett_controllers/pid_bank.h>
+#include <barrett_controllers/payload_estimator.h>
+#include <barrett_controllers/payload_file.h>
+#include <barrett_model/effort_feedforward_interface.h>
+
+namespace barrett_controllers {
+
+  /** \brief Moves an arm along an excitation trajectory and identifies its
+   * payload and joint friction
+   *
+   * Each joint follows a sinusoid about an excitation posture with a PID,
+   * and the amplitude is ramped up over \c ramp_duration from the posture at
+   * start. The torques applied to the arm are read back from the joint
+   * handles, so any gravity compensation running alongside is included. The
+   * estimate is computed by a \ref PayloadEstimator on the generated arm
+   * model.
+   *
+   * The \c save service writes the current payload estimate to \c
+   * payload_file with \ref save_payload, which \ref
+   * GravityCompensationController can load at startup. The joint friction is
+   * only identified so it isn't mistaken for the payload, and it isn't saved;
+   * \ref FrictionCompensationController uses the tables of \c
+   * identify_friction.py instead.
+   *
+   * The joint state is read in calibrated joint coordinates through the \ref
+   * barrett_model::EffortFeedforwardInterface, which doesn't claim the
+   * joints. The controller refuses to identify anything unless all of the
+   * joints are calibrated when it is started: until it is restarted after
+   * calibration, it commands no efforts and the \c save service fails.
+   */
+  template <class Model>
+  class PayloadIdentificationController : public controller_interface::Controller<hardware_interface::EffortJointInterface>
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int N_DOF = Model::N_DOF;
+
+    typedef typename Model::JointVector JointVector;
+
+    PayloadIdentificationController();
+
+    //! Get the calibrated joint state after the usual initialization
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual bool init(
+        hardware_interface::EffortJointInterface* hw,
+        ros::NodeHandle &nh);
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+    bool save_srv_cb(
+        std_srvs::Empty::Request &req,
+        std_srvs::Empty::Response &resp);
+
+  private:
+    //! True if the positions of all joints are known
+    bool is_calibrated() const;
+
+    std::vector<std::string> joint_names_;
+    std::vector<hardware_interface::JointHandle> joint_handles_;
+    std::vector<barrett_model::EffortFeedforwardHandle> state_handles_;
+    //! False if the controller was started before the joints were calibrated
+    volatile bool active_;
+
+    PidBank<N_DOF> pids_;
+    PayloadEstimator<Model> estimator_;
+
+    // Excitation
+    JointVector center_, amplitudes_, frequencies_, phases_, start_positions_;
+    double ramp_duration_;
+    ros::Time start_time_;
+
+    // The realtime thread snapshots the estimate under a try-lock and the
+    // save service writes it to disk
+    std::string payload_file_;
+    boost::mutex payload_mutex_;
+    PayloadParameters payload_snapshot_;
+    ros::ServiceServer save_srv_;
+
+    // Workspace
+    JointVector positions_, velocities_, applied_efforts_;
+    std::vector<double> efforts_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_PAYLOAD_IDENTIFICATION_CONTROLLER_H
@@ -0,0 +1,170 @@
+#ifndef __BARRETT_CONTROLLERS_PID_BANK_H
+#define __BARRETT_CONTROLLERS_PID_BANK_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+namespace barrett_controllers {
+
+  /** \brief A bank of independent PID controllers, one per joint
+   *
+   * The gains, integrators and errors of all joints are stored in
+   * structure-of-arrays form in fixed-capacity Eigen arrays, so all of the
+   * joints are updated in a single vectorizable pass and the bank never
+   * allocates.
+   *
+   * Each joint behaves exactly like a \c control_toolbox::Pid: the integral
+   * term (not the integrator) is clamped to [i_min, i_max], and a joint with a
+   * non-finite error, or a zero time step, produces a zero command without
+   * updating its integrator.
+   *
+   * Each cycle, \ref setErrors is called for the joints which should be
+   * controlled, and \ref update computes their commands together. Joints
+   * without errors are left untouched.
+   */
+  template <int MaxJoints>
+  class PidBank
+  {
+  public:
+    typedef Eigen::Array<double, Eigen::Dynamic, 1, Eigen::ColMajor, MaxJoints, 1> Array;
+    typedef Eigen::Array<bool, Eigen::Dynamic, 1, Eigen::ColMajor, MaxJoints, 1> Mask;
+
+    PidBank() : n_joints_(0) { }
+
+    //! Set the number of joints, returns false if there are more than MaxJoints
+    bool resize(const size_t n_joints) {
+      if(n_joints > static_cast<size_t>(MaxJoints)) {
+        return false;
+      }
+      n_joints_ = n_joints;
+
+      p_gains_.setZero(n_joints_);
+      i_gains_.setZero(n_joints_);
+      d_gains_.setZero(n_joints_);
+      i_max_.setZero(n_joints_);
+      i_min_.setZero(n_joints_);
+
+      p_errors_.setZero(n_joints_);
+      d_errors_.setZero(n_joints_);
+      i_errors_.setZero(n_joints_);
+      commands_.setZero(n_joints_);
+      active_.setConstant(n_joints_, false);
+
+      return true;
+    }
+
+    size_t size() const { return n_joints_; }
+
+    void setGains(
+        const size_t i,
+        const double p, const double i_gain, const double d,
+        const double i_max, const double i_min)
+    {
+      p_gains_[i] = p;
+      i_gains_[i] = i_gain;
+      d_gains_[i] = d;
+      i_max_[i] = i_max;
+      i_min_[i] = i_min;
+    }
+
+    //! Reset the errors and integrators of all joints
+    void reset() {
+      p_errors_.setZero();
+      d_errors_.setZero();
+      i_errors_.setZero();
+      commands_.setZero();
+    }
+
+    //! Reset the errors and integrator of a single joint
+    void reset(const size_t i) {
+      p_errors_[i] = 0.0;
+      d_errors_[i] = 0.0;
+      i_errors_[i] = 0.0;
+      commands_[i] = 0.0;
+    }
+
+    //! Set the errors of a joint to be used by the next \ref update
+    void setErrors(const size_t i, const double error, const double error_dot) {
+      p_errors_[i] = error;
+      d_errors_[i] = error_dot;
+      active_[i] = true;
+    }
+
+    /** \brief Compute the commands of all joints whose errors have been set
+     *
+     * The commands are written into the corresponding elements of \c
+     * commands, and the other elements are left unchanged.
+     */
+    void update(const double dt, std::vector<double> &commands) {
+      const double *p_gains = p_gains_.data();
+      const double *i_gains = i_gains_.data();
+      const double *d_gains = d_gains_.data();
+      const double *i_max = i_max_.data();
+      const double *i_min = i_min_.data();
+      const double *p_errors = p_errors_.data();
+      const double *d_errors = d_errors_.data();
+      double *i_errors = i_errors_.data();
+      double *out = commands_.data();
+      const bool *active = active_.data();
+
+      // A single branch-free pass over all joints, which the compiler can
+      // vectorize. x - x is only zero (and not NaN) for finite x.
+      for(size_t i=0; i<n_joints_; i++) {
+        const bool valid = active[i]
+          && dt != 0.0
+          && (p_errors[i] - p_errors[i]) == 0.0
+          && (d_errors[i] - d_errors[i]) == 0.0;
+
+        const double i_error = valid ? i_errors[i] + dt*p_errors[i] : i_errors[i];
+        const double i_term = std::max(i_min[i], std::min(i_gains[i]*i_error, i_max[i]));
+
+        i_errors[i] = i_error;
+        out[i] = valid ? p_gains[i]*p_errors[i] + i_term + d_gains[i]*d_errors[i] : 0.0;
+      }
+
+      for(size_t i=0; i<n_joints_; i++) {
+        if(active[i]) {
+          commands[i] = out[i];
+        }
+      }
+
+      active_.setConstant(false);
+    }
+
+    //! Compute the command of a single joint immediately
+    double computeCommand(const size_t i, const double error, const double error_dot, const double dt) {
+      p_errors_[i] = error;
+      d_errors_[i] = error_dot;
+
+      if(dt == 0.0 || (error - error) != 0.0 || (error_dot - error_dot) != 0.0) {
+        return 0.0;
+      }
+
+      i_errors_[i] += dt*error;
+      double i_term = i_gains_[i]*i_errors_[i];
+      i_term = std::max(i_min_[i], std::min(i_term, i_max_[i]));
+
+      commands_[i] = p_gains_[i]*error + i_term + d_gains_[i]*error_dot;
+      return commands_[i];
+    }
+
+    double getCommand(const size_t i) const { return commands_[i]; }
+    double getIntegrator(const size_t i) const { return i_errors_[i]; }
+
+  private:
+    size_t n_joints_;
+
+    // Gains
+    Array p_gains_, i_gains_, d_gains_, i_max_, i_min_;
+
+    // State
+    Array p_errors_, d_errors_, i_errors_, commands_;
+    Mask active_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_PID_BANK_H
@@ -0,0 +1,276 @@
+#ifndef __BARRETT_CONTROLLERS_QUINTIC_TRAJECTORY_H
+#define __BARRETT_CONTROLLERS_QUINTIC_TRAJECTORY_H
+
+#include <vector>
+#include <cstddef>
+
+namespace barrett_controllers {
+
+  /** \brief A multi-joint trajectory of quintic spline segments
+   *
+   * The trajectory passes through a list of waypoints, each with a time and a
+   * position, velocity and acceleration for every joint. Segment \c s ends at
+   * waypoint \c s, and starts either at the previous waypoint or, for the
+   * first segment, wherever the trajectory was spliced in (see \ref splice).
+   *
+   * The coefficients of each segment are stored in structure-of-arrays form
+   * (all joints' c0, then all joints' c1, ...) so \ref sample evaluates every
+   * joint in a single pass. Storage for a fixed number of waypoints is
+   * allocated by \ref configure, after which nothing allocates.
+   */
+  class QuinticTrajectory
+  {
+  public:
+    QuinticTrajectory() :
+      n_joints_(0),
+      max_points_(0),
+      n_points_(0),
+      first_(0)
+    { }
+
+    //! Allocate storage for the given number of joints and waypoints (not realtime-safe)
+    void configure(const size_t n_joints, const size_t max_points) {
+      n_joints_ = n_joints;
+      max_points_ = max_points;
+      n_points_ = 0;
+      first_ = 0;
+      start_times_.assign(max_points_, 0.0);
+      end_times_.assign(max_points_, 0.0);
+      points_.assign(3*max_points_*n_joints_, 0.0);
+      coefficients_.assign(6*max_points_*n_joints_, 0.0);
+    }
+
+    size_t n_joints() const { return n_joints_; }
+    size_t max_points() const { return max_points_; }
+    size_t size() const { return n_points_; }
+
+    //! The first segment which is sampled after \ref splice
+    size_t first_segment() const { return first_; }
+
+    //! The time of the last waypoint
+    double end_time() const { return (n_points_ > 0) ? end_times_[n_points_-1] : 0.0; }
+
+    //! Remove all waypoints
+    void clear() {
+      n_points_ = 0;
+      first_ = 0;
+    }
+
+    /** \brief Append a waypoint at an absolute time [s]
+     *
+     * The velocities and accelerations may be NULL, in which case they are
+     * zero. Returns false if the trajectory is full or the waypoint is not
+     * later than the previous one.
+     */
+    bool addPoint(
+        const double time,
+        const double *positions,
+        const double *velocities,
+        const double *accelerations)
+    {
+      if(n_points_ >= max_points_ || (n_points_ > 0 && time <= end_times_[n_points_-1])) {
+        return false;
+      }
+
+      const size_t p = n_points_;
+      double *pos = this->point(p, 0);
+      double *vel = this->point(p, 1);
+      double *acc = this->point(p, 2);
+      for(size_t j=0; j<n_joints_; j++) {
+        pos[j] = positions[j];
+        vel[j] = velocities ? velocities[j] : 0.0;
+        acc[j] = accelerations ? accelerations[j] : 0.0;
+      }
+      end_times_[p] = time;
+      n_points_++;
+
+      // Connect it to the previous waypoint
+      if(p > 0) {
+        this->compute_segment(p, end_times_[p-1],
+            this->point(p-1, 0), this->point(p-1, 1), this->point(p-1, 2));
+      }
+
+      return true;
+    }
+
+    /** \brief Start the trajectory from the given state at the given time
+     *
+     * Waypoints at or before \c time are skipped, and the first remaining
+     * segment is replaced by one from the given state to its waypoint, so the
+     * trajectory continues smoothly from wherever the arm was being sent.
+     * This only computes a single segment, so it can be done in the realtime
+     * thread.
+     *
+     * A trajectory without waypoints holds the given positions. Returns false
+     * if all of the waypoints are in the past, which leaves the trajectory
+     * unusable.
+     */
+    bool splice(
+        const double time,
+        const double *positions,
+        const double *velocities,
+        const double *accelerations)
+    {
+      if(n_points_ == 0) {
+        this->hold(time, positions);
+        return true;
+      }
+
+      size_t s = 0;
+      while(s < n_points_ && end_times_[s] <= time) {
+        s++;
+      }
+      if(s == n_points_) {
+        return false;
+      }
+
+      first_ = s;
+      this->compute_segment(s, time, positions, velocities, accelerations);
+
+      return true;
+    }
+
+    //! Replace the trajectory with a single stationary waypoint
+    void hold(const double time, const double *positions) {
+      if(max_points_ == 0) {
+        return;
+      }
+
+      double *pos = this->point(0, 0);
+      double *vel = this->point(0, 1);
+      double *acc = this->point(0, 2);
+      double *c = &coefficients_[0];
+      for(size_t j=0; j<n_joints_; j++) {
+        pos[j] = positions[j];
+        vel[j] = 0.0;
+        acc[j] = 0.0;
+      }
+      for(size_t k=0; k<6*n_joints_; k++) {
+        c[k] = 0.0;
+      }
+      for(size_t j=0; j<n_joints_; j++) {
+        c[j] = positions[j];
+      }
+
+      start_times_[0] = time;
+      end_times_[0] = time;
+      n_points_ = 1;
+      first_ = 0;
+    }
+
+    /** \brief Evaluate all joints at an absolute time [s]
+     *
+     * \c segment is the segment used by the last call, which is advanced as
+     * time goes on. It should be initialized to \ref first_segment after each
+     * \ref splice. After the last waypoint, its positions are held with zero
+     * velocity and acceleration.
+     */
+    void sample(
+        const double time,
+        size_t &segment,
+        double *positions,
+        double *velocities,
+        double *accelerations) const
+    {
+      if(n_points_ == 0) {
+        return;
+      }
+
+      while(segment+1 < n_points_ && time >= end_times_[segment]) {
+        segment++;
+      }
+
+      if(time >= end_times_[segment] && segment+1 >= n_points_) {
+        const double *pos = this->point(segment, 0);
+        for(size_t j=0; j<n_joints_; j++) {
+          positions[j] = pos[j];
+          velocities[j] = 0.0;
+          accelerations[j] = 0.0;
+        }
+        return;
+      }
+
+      double t = time - start_times_[segment];
+      t = (t < 0.0) ? 0.0 : t;
+
+      const double *c0 = this->coefficients(segment, 0);
+      const double *c1 = this->coefficients(segment, 1);
+      const double *c2 = this->coefficients(segment, 2);
+      const double *c3 = this->coefficients(segment, 3);
+      const double *c4 = this->coefficients(segment, 4);
+      const double *c5 = this->coefficients(segment, 5);
+
+      for(size_t j=0; j<n_joints_; j++) {
+        positions[j] = c0[j] + t*(c1[j] + t*(c2[j] + t*(c3[j] + t*(c4[j] + t*c5[j]))));
+        velocities[j] = c1[j] + t*(2.0*c2[j] + t*(3.0*c3[j] + t*(4.0*c4[j] + t*5.0*c5[j])));
+        accelerations[j] = 2.0*c2[j] + t*(6.0*c3[j] + t*(12.0*c4[j] + t*20.0*c5[j]));
+      }
+    }
+
+  private:
+
+    double* point(const size_t p, const size_t derivative) {
+      return &points_[(3*p + derivative)*n_joints_];
+    }
+    const double* point(const size_t p, const size_t derivative) const {
+      return &points_[(3*p + derivative)*n_joints_];
+    }
+    double* coefficients(const size_t s, const size_t order) {
+      return &coefficients_[(6*s + order)*n_joints_];
+    }
+    const double* coefficients(const size_t s, const size_t order) const {
+      return &coefficients_[(6*s + order)*n_joints_];
+    }
+
+    //! Compute the quintic from the given state to waypoint \c s for all joints
+    void compute_segment(
+        const size_t s,
+        const double start_time,
+        const double *p0,
+        const double *v0,
+        const double *a0)
+    {
+      const double *p1 = this->point(s, 0);
+      const double *v1 = this->point(s, 1);
+      const double *a1 = this->point(s, 2);
+
+      double *c0 = this->coefficients(s, 0);
+      double *c1 = this->coefficients(s, 1);
+      double *c2 = this->coefficients(s, 2);
+      double *c3 = this->coefficients(s, 3);
+      double *c4 = this->coefficients(s, 4);
+      double *c5 = this->coefficients(s, 5);
+
+      start_times_[s] = start_time;
+      const double T = end_times_[s] - start_time;
+      const double T2 = T*T;
+      const double T3 = T2*T;
+
+      for(size_t j=0; j<n_joints_; j++) {
+        const double h = p1[j] - p0[j];
+        c0[j] = p0[j];
+        c1[j] = v0[j];
+        c2[j] = 0.5*a0[j];
+        c3[j] = (20.0*h - (8.0*v1[j] + 12.0*v0[j])*T - (3.0*a0[j] - a1[j])*T2)/(2.0*T3);
+        c4[j] = (-30.0*h + (14.0*v1[j] + 16.0*v0[j])*T + (3.0*a0[j] - 2.0*a1[j])*T2)/(2.0*T3*T);
+        c5[j] = (12.0*h - 6.0*(v1[j] + v0[j])*T + (a1[j] - a0[j])*T2)/(2.0*T3*T2);
+      }
+    }
+
+    size_t n_joints_;
+    size_t max_points_;
+    size_t n_points_;
+    size_t first_;
+
+    // Segment s ends at waypoint s
+    std::vector<double> start_times_;
+    std::vector<double> end_times_;
+    // Waypoint positions, velocities and accelerations
+    std::vector<double> points_;
+    // Six blocks of per-joint coefficients per segment, lowest order first
+    std::vector<double> coefficients_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_QUINTIC_TRAJECTORY_H
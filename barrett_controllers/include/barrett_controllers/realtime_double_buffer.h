@@ -0,0 +1,103 @@
+#ifndef __BARRETT_CONTROLLERS_REALTIME_DOUBLE_BUFFER_H
+#define __BARRETT_CONTROLLERS_REALTIME_DOUBLE_BUFFER_H
+
+#include <boost/thread/thread.hpp>
+
+namespace barrett_controllers {
+
+  /** \brief Hands large objects from a non-realtime thread to the realtime
+   * thread without locking or copying in the realtime thread
+   *
+   * There are two preallocated buffers: the front buffer belongs to the
+   * realtime thread, and the back buffer is filled by the non-realtime thread
+   * between \ref beginWrite and \ref endWrite. The realtime thread picks up a
+   * new back buffer with \ref takePending, can still read the old front
+   * buffer while it adopts the new one (e.g. to splice them), and then calls
+   * \ref swap, or \ref discard if the new buffer can't be used.
+   *
+   * The realtime side never waits. If the realtime thread has not taken the
+   * last buffer when a new one is written, that buffer is withdrawn and
+   * overwritten. Only one thread may write.
+   */
+  template <class T>
+  class RealtimeDoubleBuffer
+  {
+  public:
+    RealtimeDoubleBuffer() :
+      front_(0),
+      state_(IDLE)
+    { }
+
+    //! Allocate both buffers (not realtime-safe)
+    void initialize(const T &value) {
+      buffers_[0] = value;
+      buffers_[1] = value;
+      front_ = 0;
+      state_ = IDLE;
+    }
+
+    /** \brief Get the back buffer to fill it (non-realtime)
+     *
+     * Waits for the realtime thread if it is in the middle of taking the
+     * previous buffer, which only takes a single update.
+     */
+    T& beginWrite() {
+      // Withdraw a buffer which hasn't been taken yet
+      __sync_bool_compare_and_swap(&state_, PENDING, IDLE);
+      while(state_ != IDLE) {
+        boost::this_thread::yield();
+      }
+      __sync_synchronize();
+      return buffers_[1 - front_];
+    }
+
+    //! Hand the back buffer to the realtime thread (non-realtime)
+    void endWrite() {
+      __sync_synchronize();
+      state_ = PENDING;
+    }
+
+    //! The buffer used by the realtime thread
+    T& front() { return buffers_[front_]; }
+
+    /** \brief Take a new buffer if one has been written (realtime)
+     *
+     * If this returns true, the new buffer is available through \ref back
+     * until \ref swap is called.
+     */
+    bool takePending() {
+      if(state_ != PENDING) {
+        return false;
+      }
+      const bool taken = __sync_bool_compare_and_swap(&state_, PENDING, TAKING);
+      __sync_synchronize();
+      return taken;
+    }
+
+    //! The new buffer taken by \ref takePending
+    T& back() { return buffers_[1 - front_]; }
+
+    //! Make the taken buffer the front buffer (realtime)
+    void swap() {
+      front_ = 1 - front_;
+      __sync_synchronize();
+      state_ = IDLE;
+    }
+
+    //! Drop the taken buffer and keep the front buffer (realtime)
+    void discard() {
+      __sync_synchronize();
+      state_ = IDLE;
+    }
+
+  private:
+    enum { IDLE = 0, PENDING = 1, TAKING = 2 };
+
+    T buffers_[2];
+    volatile int front_;
+    volatile int state_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_REALTIME_DOUBLE_BUFFER_H
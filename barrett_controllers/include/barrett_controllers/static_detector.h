@@ -0,0 +1,160 @@
+#ifndef __BARRETT_CONTROLLERS_STATIC_DETECTOR_H
+#define __BARRETT_CONTROLLERS_STATIC_DETECTOR_H
+
+#include <vector>
+#include <cstddef>
+
+namespace barrett_controllers {
+
+  /** \brief Detects when a scalar signal (e.g. a joint position) has settled
+   *
+   * The signal is static once it has moved by more than the threshold at least
+   * once since the last reset (the detector is "armed") and the spread of the
+   * last \c window samples has then fallen back below the threshold.
+   *
+   * The running minimum and maximum over the window are kept in two
+   * monotonic deques stored in fixed-capacity ring buffers, so each update is
+   * O(1) amortized and never allocates once \ref configure has been called.
+   */
+  class StaticDetector
+  {
+  public:
+    StaticDetector() :
+      window_(0),
+      threshold_(0.0),
+      n_samples_(0),
+      armed_(false)
+    { }
+
+    //! The longest window, which is a minute of samples at 1 kHz
+    static const int MAX_WINDOW = 60000;
+
+    //! Allocate storage for a window of \c window samples (not realtime-safe)
+    void configure(const size_t window, const double threshold) {
+      window_ = window > 0 ? window : 1;
+      threshold_ = threshold;
+      min_queue_.configure(window_);
+      max_queue_.configure(window_);
+      this->reset();
+    }
+
+    //! Forget all samples and disarm the detector
+    void reset() {
+      n_samples_ = 0;
+      armed_ = false;
+      min_queue_.clear();
+      max_queue_.clear();
+    }
+
+    //! Add a sample and return true if the signal is static
+    bool update(const double sample) {
+      const unsigned long seq = n_samples_++;
+
+      // Drop samples which have left the window
+      if(seq >= window_) {
+        min_queue_.expire(seq - window_);
+        max_queue_.expire(seq - window_);
+      }
+
+      // Keep the queues monotonic: increasing for the min, decreasing for the max
+      while(!min_queue_.empty() && min_queue_.back_value() >= sample) {
+        min_queue_.pop_back();
+      }
+      min_queue_.push_back(seq, sample);
+
+      while(!max_queue_.empty() && max_queue_.back_value() <= sample) {
+        max_queue_.pop_back();
+      }
+      max_queue_.push_back(seq, sample);
+
+      if(!this->full()) {
+        return false;
+      }
+
+      if(this->range() > threshold_) {
+        armed_ = true;
+        return false;
+      }
+
+      return armed_;
+    }
+
+    //! The spread of the samples currently in the window
+    double range() const {
+      if(min_queue_.empty()) {
+        return 0.0;
+      }
+      return max_queue_.front_value() - min_queue_.front_value();
+    }
+
+    //! True once a full window of samples has been collected
+    bool full() const { return n_samples_ >= window_; }
+
+    bool armed() const { return armed_; }
+    size_t window() const { return window_; }
+    double threshold() const { return threshold_; }
+
+  private:
+
+    /** \brief A fixed-capacity ring buffer used as a deque of (sequence, value)
+     * pairs
+     */
+    class RingDeque
+    {
+    public:
+      RingDeque() : head_(0), size_(0) { }
+
+      void configure(const size_t capacity) {
+        seqs_.assign(capacity, 0);
+        values_.assign(capacity, 0.0);
+        this->clear();
+      }
+
+      void clear() { head_ = 0; size_ = 0; }
+      bool empty() const { return size_ == 0; }
+
+      double front_value() const { return values_[head_]; }
+      double back_value() const { return values_[this->index(size_ - 1)]; }
+
+      void push_back(const unsigned long seq, const double value) {
+        // The window never holds more than capacity samples, so this cannot
+        // overflow as long as expired samples are dropped first
+        const size_t i = this->index(size_);
+        seqs_[i] = seq;
+        values_[i] = value;
+        size_++;
+      }
+
+      void pop_back() { size_--; }
+
+      //! Drop all entries with a sequence number at or before \c seq
+      void expire(const unsigned long seq) {
+        while(size_ > 0 && seqs_[head_] <= seq) {
+          head_ = this->index(1);
+          size_--;
+        }
+      }
+
+    private:
+      size_t index(const size_t offset) const {
+        return (head_ + offset) % seqs_.size();
+      }
+
+      std::vector<unsigned long> seqs_;
+      std::vector<double> values_;
+      size_t head_;
+      size_t size_;
+    };
+
+    size_t window_;
+    double threshold_;
+    unsigned long n_samples_;
+    bool armed_;
+
+    RingDeque min_queue_;
+    RingDeque max_queue_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_STATIC_DETECTOR_H
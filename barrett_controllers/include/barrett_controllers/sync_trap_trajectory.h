@@ -0,0 +1,200 @@
+#ifndef __BARRETT_CONTROLLERS_SYNC_TRAP_TRAJECTORY_H
+#define __BARRETT_CONTROLLERS_SYNC_TRAP_TRAJECTORY_H
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+namespace barrett_controllers {
+
+  /** \brief Time-synchronized trapezoidal velocity profiles for a set of joints
+   *
+   * Moves are queued with \ref plan, and all of the moves queued together are
+   * started by \ref synchronize. Each of these joints gets the same duration:
+   * the longest of their minimum-time trapezoids. Faster joints follow their
+   * own trapezoid slowed down uniformly, like
+   * \c KDL::VelocityProfile_Trap::SetProfileDuration, so all of them arrive at
+   * the same time.
+   *
+   * Only the moves queued before the same \ref synchronize are synchronized.
+   * A move planned in a later cycle gets its own duration, and doesn't change
+   * the moves which are already running, so callers which want a set of
+   * joints to arrive together have to plan all of them in the same cycle.
+   *
+   * The polynomial coefficients of each profile's three segments are computed
+   * once by \ref synchronize, so \ref sample only has to pick a segment and
+   * evaluate the position and velocity together. Storage is allocated by \ref
+   * configure, so planning and sampling never allocate.
+   */
+  class SyncTrapTrajectory
+  {
+  public:
+    SyncTrapTrajectory() { }
+
+    //! Allocate storage for the given number of joints (not realtime-safe)
+    void configure(
+        const std::vector<double> &max_vels,
+        const std::vector<double> &max_accs)
+    {
+      max_vels_ = max_vels;
+      max_accs_ = max_accs;
+      profiles_.assign(max_vels_.size(), Profile());
+      pending_.assign(max_vels_.size(), false);
+    }
+
+    size_t size() const { return profiles_.size(); }
+
+    //! Queue a move of one joint, which will start at the next \ref synchronize
+    void plan(const size_t i, const double start, const double end) {
+      profiles_[i].start = start;
+      profiles_[i].end = end;
+      pending_[i] = true;
+    }
+
+    /** \brief Start all of the queued moves with a common duration
+     *
+     * Sample times of these joints are relative to this call. Returns the
+     * common duration.
+     */
+    double synchronize() {
+      // The slowest joint determines the duration
+      double duration = 0.0;
+      for(size_t i=0; i<profiles_.size(); i++) {
+        if(pending_[i]) {
+          duration = std::max(duration, this->minimum_duration(i));
+        }
+      }
+
+      for(size_t i=0; i<profiles_.size(); i++) {
+        if(pending_[i]) {
+          this->compute_coefficients(i, duration);
+          pending_[i] = false;
+        }
+      }
+
+      return duration;
+    }
+
+    //! Evaluate the position and velocity of a joint \c t seconds after its start
+    void sample(const size_t i, const double t, double &pos, double &vel) const {
+      const Profile &profile = profiles_[i];
+
+      if(t <= 0.0) {
+        pos = profile.start;
+        vel = 0.0;
+        return;
+      } else if(t >= profile.duration) {
+        pos = profile.end;
+        vel = 0.0;
+        return;
+      }
+
+      const Segment &segment =
+        (t < profile.segments[0].end_time) ? profile.segments[0] :
+        (t < profile.segments[1].end_time) ? profile.segments[1] :
+        profile.segments[2];
+
+      pos = segment.c0 + t*(segment.c1 + t*segment.c2);
+      vel = segment.c1 + 2.0*t*segment.c2;
+    }
+
+    //! The duration of a joint's current move
+    double duration(const size_t i) const { return profiles_[i].duration; }
+
+  private:
+
+    //! A segment of the form c0 + c1*t + c2*t^2, which ends at end_time
+    struct Segment {
+      Segment() : end_time(0.0), c0(0.0), c1(0.0), c2(0.0) { }
+      double end_time, c0, c1, c2;
+    };
+
+    struct Profile {
+      Profile() : start(0.0), end(0.0), duration(0.0) { }
+      double start, end, duration;
+      // Acceleration, cruise and deceleration
+      Segment segments[3];
+    };
+
+    //! The minimum-time trapezoid (or triangle) for a joint's queued move
+    void minimum_profile(
+        const size_t i,
+        double &accel_time,
+        double &duration) const
+    {
+      const double distance = std::abs(profiles_[i].end - profiles_[i].start);
+      const double max_vel = max_vels_[i];
+      const double max_acc = max_accs_[i];
+
+      if(distance >= max_vel*max_vel/max_acc) {
+        // Trapezoid which reaches the maximum velocity
+        accel_time = max_vel/max_acc;
+        duration = distance/max_vel + accel_time;
+      } else {
+        // Triangle
+        accel_time = std::sqrt(distance/max_acc);
+        duration = 2.0*accel_time;
+      }
+    }
+
+    double minimum_duration(const size_t i) const {
+      double accel_time, duration;
+      this->minimum_profile(i, accel_time, duration);
+      return duration;
+    }
+
+    void compute_coefficients(const size_t i, const double duration) {
+      Profile &profile = profiles_[i];
+
+      double accel_time, min_duration;
+      this->minimum_profile(i, accel_time, min_duration);
+
+      if(min_duration <= 0.0 || duration <= 0.0) {
+        // Nothing to do
+        profile.duration = 0.0;
+        for(int s=0; s<3; s++) {
+          profile.segments[s] = Segment();
+          profile.segments[s].c0 = profile.end;
+        }
+        return;
+      }
+
+      // Stretch the minimum-time profile to the common duration
+      const double scale = min_duration/duration;
+      const double sign = (profile.end >= profile.start) ? 1.0 : -1.0;
+      const double acc = sign*max_accs_[i]*scale*scale;
+      const double t1 = accel_time/scale;
+      const double t2 = duration - t1;
+      const double cruise_vel = acc*t1;
+
+      profile.duration = duration;
+
+      Segment &accel = profile.segments[0];
+      accel.end_time = t1;
+      accel.c0 = profile.start;
+      accel.c1 = 0.0;
+      accel.c2 = acc/2.0;
+
+      Segment &cruise = profile.segments[1];
+      cruise.end_time = t2;
+      cruise.c0 = profile.start - acc*t1*t1/2.0;
+      cruise.c1 = cruise_vel;
+      cruise.c2 = 0.0;
+
+      Segment &decel = profile.segments[2];
+      decel.end_time = duration;
+      decel.c0 = profile.end - acc*duration*duration/2.0;
+      decel.c1 = acc*duration;
+      decel.c2 = -acc/2.0;
+    }
+
+    std::vector<double> max_vels_;
+    std::vector<double> max_accs_;
+    std::vector<Profile> profiles_;
+    std::vector<bool> pending_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_SYNC_TRAP_TRAJECTORY_H
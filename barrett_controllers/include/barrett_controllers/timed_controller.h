@@ -0,0 +1,68 @@
+#ifndef __BARRETT_CONTROLLERS_TIMED_CONTROLLER_H
+#define __BARRETT_CONTROLLERS_TIMED_CONTROLLER_H
+
+#include <controller_interface/controller_base.h>
+#include <hardware_interface/robot_hw.h>
+#include <pluginlib/class_list_macros.h>
+#include <pluginlib/class_loader.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <barrett_control_msgs/ControllerTiming.h>
+#include <barrett_controllers/timing_histogram.h>
+
+namespace barrett_controllers {
+
+  /** \brief Hosts another controller and measures how long its updates take
+   *
+   * The hosted controller is loaded from the \c controller_type parameter,
+   * and is initialized with the same robot and namespace as this one, so an
+   * existing controller is timed by renaming its \c type parameter to
+   * \c controller_type and setting \c type to
+   * barrett_controllers/TimedController. It claims the same resources and
+   * uses the same hardware interface as the hosted controller, and
+   * starting, updates and stopping are all forwarded to it.
+   *
+   * The wall-clock duration of each update is counted in a \ref
+   * TimingHistogram with \c timing/bins bins of \c timing/resolution
+   * seconds. Updates longer than \c timing/budget seconds are counted as
+   * overruns. The statistics since the controller was started are published
+   * on controller_timing at \c timing/publish_rate.
+   */
+  class TimedController : public controller_interface::ControllerBase
+  {
+  public:
+    TimedController();
+    virtual ~TimedController();
+
+    virtual bool initRequest(
+        hardware_interface::RobotHW* robot_hw,
+        ros::NodeHandle &root_nh,
+        ros::NodeHandle &controller_nh,
+        std::set<std::string> &claimed_resources);
+    virtual std::string getHardwareInterfaceType() const;
+
+    virtual void starting(const ros::Time& time);
+    virtual void update(const ros::Time& time, const ros::Duration& period);
+    virtual void stopping(const ros::Time& time);
+
+  private:
+    std::string controller_type_;
+
+    // The loader has to outlive the controller it created
+    boost::scoped_ptr<pluginlib::ClassLoader<controller_interface::ControllerBase> > controller_loader_;
+    boost::shared_ptr<controller_interface::ControllerBase> controller_;
+
+    TimingHistogram histogram_;
+    double budget_;
+    unsigned long overruns_;
+
+    // State publishing
+    double publish_rate_;
+    ros::Time last_publish_time_;
+    boost::scoped_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::ControllerTiming> > timing_pub_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_TIMED_CONTROLLER_H
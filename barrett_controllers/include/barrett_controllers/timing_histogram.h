@@ -0,0 +1,120 @@
+#ifndef __BARRETT_CONTROLLERS_TIMING_HISTOGRAM_H
+#define __BARRETT_CONTROLLERS_TIMING_HISTOGRAM_H
+
+#include <vector>
+#include <cstddef>
+
+namespace barrett_controllers {
+
+  /** \brief Histogram of durations which can be recorded from the realtime
+   * thread and read from any thread without locking
+   *
+   * The durations are counted in \c n_bins bins of \c resolution seconds,
+   * and the last bin also counts everything longer. The counts, the sum and
+   * the maximum are updated with atomic operations, so \ref record never
+   * waits and never allocates once \ref configure has been called. A reader
+   * sees each value consistently, but not necessarily all of them from the
+   * same instant.
+   */
+  class TimingHistogram
+  {
+  public:
+    TimingHistogram() :
+      resolution_(1E-6),
+      count_(0),
+      total_ns_(0),
+      max_ns_(0),
+      last_ns_(0)
+    { }
+
+    //! Allocate the bins (not realtime-safe)
+    void configure(const size_t n_bins, const double resolution) {
+      resolution_ = resolution > 0.0 ? resolution : 1E-6;
+      counts_.assign(n_bins > 0 ? n_bins : 1, 0);
+      this->reset();
+    }
+
+    //! Clear the counts
+    void reset() {
+      for(size_t i=0; i<counts_.size(); i++) {
+        counts_[i] = 0;
+      }
+      count_ = 0;
+      total_ns_ = 0;
+      max_ns_ = 0;
+      last_ns_ = 0;
+      __sync_synchronize();
+    }
+
+    //! Count a duration [s]
+    void record(const double duration) {
+      const unsigned long long ns = duration > 0.0 ? static_cast<unsigned long long>(duration*1E9) : 0;
+      const double bin = duration/resolution_;
+      const size_t i = bin < static_cast<double>(counts_.size() - 1) ? static_cast<size_t>(bin > 0.0 ? bin : 0.0) : counts_.size() - 1;
+
+      __sync_fetch_and_add(&counts_[i], 1UL);
+      __sync_fetch_and_add(&total_ns_, ns);
+      __sync_fetch_and_add(&count_, 1UL);
+      last_ns_ = ns;
+
+      unsigned long long max_ns = max_ns_;
+      while(ns > max_ns) {
+        max_ns = __sync_val_compare_and_swap(&max_ns_, max_ns, ns);
+      }
+    }
+
+    size_t size() const { return counts_.size(); }
+    double resolution() const { return resolution_; }
+    unsigned long count() const { return count_; }
+    unsigned long count(const size_t i) const { return counts_[i]; }
+
+    //! The mean duration [s]
+    double mean() const {
+      const unsigned long n = count_;
+      return n > 0 ? 1E-9*total_ns_/n : 0.0;
+    }
+
+    //! The longest duration [s]
+    double max() const { return 1E-9*max_ns_; }
+
+    //! The last duration [s]
+    double last() const { return 1E-9*last_ns_; }
+
+    /** \brief The duration [s] below which a fraction of the durations are
+     *
+     * This is the upper edge of the bin which contains the percentile, so it
+     * overestimates by at most the resolution. Durations in the last bin are
+     * reported as the maximum.
+     */
+    double percentile(const double fraction) const {
+      unsigned long n = 0;
+      for(size_t i=0; i<counts_.size(); i++) {
+        n += counts_[i];
+      }
+      if(n == 0) {
+        return 0.0;
+      }
+
+      const double threshold = fraction*n;
+      unsigned long below = 0;
+      for(size_t i=0; i+1<counts_.size(); i++) {
+        below += counts_[i];
+        if(below >= threshold) {
+          return (i + 1)*resolution_;
+        }
+      }
+      return this->max();
+    }
+
+  private:
+    double resolution_;
+    std::vector<unsigned long> counts_;
+    volatile unsigned long count_;
+    volatile unsigned long long total_ns_;
+    volatile unsigned long long max_ns_;
+    volatile unsigned long long last_ns_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_CONTROLLERS_TIMING_HISTOGRAM_H
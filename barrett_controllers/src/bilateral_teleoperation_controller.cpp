@@ -0,0 +1,146 @@
+
+#include <barrett_controllers/bilateral_teleoperation_controller.h>
+
+#include <algorithm>
+
+#include <terse_roscpp/params.h>
+
+namespace barrett_controllers
+{
+
+  BilateralTeleoperationController::BilateralTeleoperationController() :
+    force_feedback_(1.0),
+    coupling_delay_(0.0),
+    max_coupling_delay_(0.0),
+    publish_rate_(50.0)
+  {
+
+  }
+
+  bool BilateralTeleoperationController::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    require_param(nh, "master_joint_names", master_joint_names_,
+        "The names of the joints of the master arm.");
+    require_param(nh, "slave_joint_names", slave_joint_names_,
+        "The names of the joints of the slave arm, in the same order.");
+    require_param(nh, "p_gains", p_gains_,
+        "The stiffness [Nm/rad] of the coupling of each pair of joints.");
+    require_param(nh, "d_gains", d_gains_,
+        "The damping [Nm/(rad/s)] of the coupling of each pair of joints.");
+    if(nh.hasParam("force_feedback")) {
+      require_param(nh, "force_feedback", force_feedback_,
+          "The fraction of the slave's coupling effort which is applied to the master.");
+    }
+    if(nh.hasParam("publish_rate")) {
+      require_param(nh, "publish_rate", publish_rate_,
+          "The rate [Hz] at which the coupling state is published.");
+    }
+
+    const size_t n_joints = master_joint_names_.size();
+    if(slave_joint_names_.size() != n_joints
+        || p_gains_.size() != n_joints
+        || d_gains_.size() != n_joints)
+    {
+      ROS_ERROR("The master and slave joints and the gains must have the same number of elements.");
+      return false;
+    }
+
+    // Each joint can only be driven by one side of the coupling
+    for(size_t j=0; j<n_joints; j++) {
+      if(std::find(slave_joint_names_.begin(), slave_joint_names_.end(), master_joint_names_[j]) != slave_joint_names_.end()) {
+        ROS_ERROR_STREAM("Joint "<<master_joint_names_[j]<<" can't be both a master and a slave joint.");
+        return false;
+      }
+    }
+
+    for(size_t j=0; j<n_joints; j++) {
+      master_handles_.push_back(hw->getHandle(master_joint_names_[j]));
+      slave_handles_.push_back(hw->getHandle(slave_joint_names_[j]));
+    }
+
+    offsets_.assign(n_joints, 0.0);
+    position_errors_.assign(n_joints, 0.0);
+    master_efforts_.assign(n_joints, 0.0);
+    slave_efforts_.assign(n_joints, 0.0);
+
+    // Allocate the state message
+    state_pub_.reset(
+        new realtime_tools::RealtimePublisher<barrett_control_msgs::TeleoperationState>(
+          nh, "teleoperation_state", 4));
+    state_pub_->msg_.master_name = master_joint_names_;
+    state_pub_->msg_.slave_name = slave_joint_names_;
+    state_pub_->msg_.position_error.assign(n_joints, 0.0);
+    state_pub_->msg_.master_effort.assign(n_joints, 0.0);
+    state_pub_->msg_.slave_effort.assign(n_joints, 0.0);
+
+    return true;
+  }
+
+  void BilateralTeleoperationController::starting(const ros::Time& time)
+  {
+    // Hold the arms where they are relative to each other
+    for(size_t j=0; j<master_handles_.size(); j++) {
+      offsets_[j] = slave_handles_[j].getPosition() - master_handles_[j].getPosition();
+    }
+
+    max_coupling_delay_ = 0.0;
+    last_publish_time_ = time;
+  }
+
+  void BilateralTeleoperationController::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // Both arms' states are from this cycle's read
+    for(size_t j=0; j<master_handles_.size(); j++) {
+      position_errors_[j] = slave_handles_[j].getPosition() - master_handles_[j].getPosition() - offsets_[j];
+      const double velocity_error = slave_handles_[j].getVelocity() - master_handles_[j].getVelocity();
+
+      slave_efforts_[j] = -p_gains_[j]*position_errors_[j] - d_gains_[j]*velocity_error;
+      master_efforts_[j] = -force_feedback_*slave_efforts_[j];
+
+      slave_handles_[j].setCommand(slave_efforts_[j]);
+      master_handles_[j].setCommand(master_efforts_[j]);
+    }
+
+    // The cycle's time is taken just before the hardware is read, and it's
+    // stamped on the state message, so the delay is measured on the same
+    // (ROS) clock
+    coupling_delay_ = (ros::Time::now() - time).toSec();
+    max_coupling_delay_ = std::max(max_coupling_delay_, coupling_delay_);
+
+    if(publish_rate_ > 0.0
+        && (time - last_publish_time_).toSec() >= 1.0/publish_rate_
+        && state_pub_->trylock())
+    {
+      barrett_control_msgs::TeleoperationState &msg = state_pub_->msg_;
+      msg.header.stamp = time;
+      for(size_t j=0; j<master_handles_.size(); j++) {
+        msg.position_error[j] = position_errors_[j];
+        msg.master_effort[j] = master_efforts_[j];
+        msg.slave_effort[j] = slave_efforts_[j];
+      }
+      msg.coupling_delay = coupling_delay_;
+      msg.max_coupling_delay = max_coupling_delay_;
+      state_pub_->unlockAndPublish();
+      last_publish_time_ = time;
+    }
+  }
+
+  void BilateralTeleoperationController::stopping(const ros::Time& time)
+  {
+    for(size_t j=0; j<master_handles_.size(); j++) {
+      master_handles_[j].setCommand(0.0);
+      slave_handles_[j].setCommand(0.0);
+    }
+  }
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    BilateralTeleoperationController,
+    barrett_controllers::BilateralTeleoperationController,
+    controller_interface::ControllerBase)
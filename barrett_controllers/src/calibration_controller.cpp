@@ -36,14 +36,16 @@
 
 #include <terse_roscpp/params.h>
 
-#include <list>
+#include <algorithm>
+#include <cmath>
 
 
 namespace barrett_controllers
 {
 
   CalibrationController::CalibrationController()
-    : calibration_step_(IDLE), effort_command_()
+    : calibration_active_(false), total_calibration_time_(0.0), effort_command_(),
+    last_position_command_seq_(0), stale_position_commands_(0), command_timeout_(0.1)
   {
 
   }
@@ -74,6 +76,24 @@ namespace barrett_controllers
         "The list of joints to be calibrated.");
     require_param(nh, "static_thresholds", static_thresholds_,
         "The position change threshold to determine if a joint is stationary (has reached a limit).");
+    if(nh.hasParam("static_windows")) {
+      require_param(nh, "static_windows", static_windows_,
+          "The number of samples over which a joint must be stationary to be considered static.");
+      if(static_windows_.size() != joint_names_.size()) {
+        ROS_ERROR_STREAM("Parameter 'static_windows' in namespace "<<nh.getNamespace()
+            <<" must have one window per joint!");
+        return false;
+      }
+      for(unsigned i=0; i<static_windows_.size(); i++) {
+        if(static_windows_[i] < 1 || static_windows_[i] > StaticDetector::MAX_WINDOW) {
+          ROS_ERROR_STREAM("The static window of joint "<<joint_names_[i]<<" must be between 1 and "
+              <<StaticDetector::MAX_WINDOW<<" samples, not "<<static_windows_[i]<<"!");
+          return false;
+        }
+      }
+    } else {
+      static_windows_.assign(joint_names_.size(), 100);
+    }
     require_param(nh, "upper_limits", upper_limits_,
         "The upper limits of the joints.");
     require_param(nh, "lower_limits", lower_limits_,
@@ -85,6 +105,16 @@ namespace barrett_controllers
     require_param(nh, "resolver_offsets", resolver_offsets_,
         "The absolute resolver angles at the home positions.");
 
+    // Get the coarse joint positions used to calibrate without moving
+    if(nh.hasParam("hint_positions")) {
+      require_param(nh, "hint_positions", hint_positions_,
+          "The approximate positions of the joints when the arm is parked.");
+    }
+    if(nh.hasParam("hint_tolerances")) {
+      require_param(nh, "hint_tolerances", hint_tolerances_,
+          "The maximum distance between a joint's hint and its resolved position.");
+    }
+
     require_param(nh, "p_gains", p_gains_, "PID Proportial gains.");
     require_param(nh, "i_gains", i_gains_, "PID Integral gains.");
     require_param(nh, "d_gains", d_gains_, "PID Derivative gains.");
@@ -94,6 +124,67 @@ namespace barrett_controllers
     require_param(nh, "trap_max_accs", trap_max_accs_);
     require_param(nh, "trap_durations", trap_durations_);
 
+    if(nh.hasParam("command_timeout")) {
+      require_param(nh, "command_timeout", command_timeout_,
+          "The age [s] after which effort and position commands are ignored.");
+    }
+
+    // Get the joints which need to be calibrated before each joint can start
+    // searching for its limit. This is a list of joint name lists, one per
+    // joint, and joints without unmet dependencies calibrate concurrently.
+    dependencies_.assign(joint_names_.size(), std::vector<int>());
+    if(nh.hasParam("calibration_dependencies")) {
+      XmlRpc::XmlRpcValue dependency_names;
+      nh.getParam("calibration_dependencies", dependency_names);
+
+      if(dependency_names.getType() != XmlRpc::XmlRpcValue::TypeArray
+          || dependency_names.size() != (int)joint_names_.size())
+      {
+        ROS_ERROR_STREAM("Parameter 'calibration_dependencies' in namespace "<<nh.getNamespace()
+            <<" must be a list with one list of joint names per joint!");
+        return false;
+      }
+
+      for(unsigned i=0; i<joint_names_.size(); i++) {
+        if(dependency_names[i].getType() != XmlRpc::XmlRpcValue::TypeArray) {
+          ROS_ERROR_STREAM("Calibration dependencies of joint "<<joint_names_[i]<<" must be a list of joint names!");
+          return false;
+        }
+        for(int d=0; d<dependency_names[i].size(); d++) {
+          const int dep = this->joint_index(static_cast<std::string>(dependency_names[i][d]));
+          if(dep < 0) {
+            ROS_ERROR_STREAM("Joint "<<joint_names_[i]<<" depends on unknown joint "
+                <<static_cast<std::string>(dependency_names[i][d]));
+            return false;
+          }
+          dependencies_[i].push_back(dep);
+        }
+      }
+
+      // Make sure the dependency graph is acyclic (Kahn's algorithm)
+      std::vector<int> n_unresolved(joint_names_.size(), 0);
+      for(unsigned i=0; i<joint_names_.size(); i++) {
+        n_unresolved[i] = dependencies_[i].size();
+      }
+      std::vector<int> resolved;
+      for(unsigned i=0; i<joint_names_.size(); i++) {
+        if(n_unresolved[i] == 0) { resolved.push_back(i); }
+      }
+      for(unsigned r=0; r<resolved.size(); r++) {
+        for(unsigned i=0; i<joint_names_.size(); i++) {
+          const int n_resolved = std::count(dependencies_[i].begin(), dependencies_[i].end(), resolved[r]);
+          if(n_resolved > 0) {
+            n_unresolved[i] -= n_resolved;
+            if(n_unresolved[i] == 0) { resolved.push_back(i); }
+          }
+        }
+      }
+      if(resolved.size() != joint_names_.size()) {
+        ROS_ERROR("Calibration dependencies contain a cycle!");
+        return false;
+      }
+    }
+
     // get publishing period
     if (!nh.getParam("publish_rate", publish_rate_)){
       ROS_ERROR_STREAM("Parameter 'publish_rate' in namespace "<<nh.getNamespace()<<" not set!");
@@ -109,16 +200,25 @@ namespace barrett_controllers
     joint_handles_.resize(joint_names_.size());
     effort_command_.resize(joint_names_.size());
     calibration_states_.assign(joint_names_.size(),UNCALIBRATED);
-    position_history_.assign(joint_names_.size(),std::list<double>());
-    bomb_armed_.assign(joint_names_.size(),false);
-    pids_.resize(joint_names_.size());
-    trajectories_.resize(joint_names_.size());
+    calibration_steps_.assign(joint_names_.size(),IDLE);
+    calibration_hints_.assign(joint_names_.size(),0.0);
+    resolved_positions_.assign(joint_names_.size(),0.0);
+    joint_calibration_start_times_.resize(joint_names_.size());
+    joint_calibration_times_.assign(joint_names_.size(),0.0);
+    static_detectors_.resize(joint_names_.size());
+    if(!pids_.resize(joint_names_.size())) {
+      ROS_ERROR_STREAM("CalibrationController can't control more than "<<MAX_JOINTS<<" joints!");
+      return false;
+    }
+    trajectory_.configure(trap_max_vels_, trap_max_accs_);
     trajectory_start_times_.resize(joint_names_.size());
     position_errors_.resize(joint_names_.size());
     velocity_errors_.resize(joint_names_.size());
+    hold_positions_.assign(joint_names_.size(), 0.0);
+    holding_.assign(joint_names_.size(), false);
     for (unsigned i=0; i<joint_names_.size(); i++){
-      pids_[i] = control_toolbox::Pid(p_gains_[i], i_gains_[i], d_gains_[i], i_max_[i], -i_max_[i]);
-      trajectories_[i] = KDL::VelocityProfile_Trap(trap_max_vels_[i], trap_max_accs_[i]);
+      pids_.setGains(i, p_gains_[i], i_gains_[i], d_gains_[i], i_max_[i], -i_max_[i]);
+      static_detectors_[i].configure(static_windows_[i], static_thresholds_[i]);
       joint_handles_[i] = hw->getSemiAbsoluteJointHandle(joint_names_[i]);
       realtime_pub_->msg_.name.push_back(joint_names_[i]);
       realtime_pub_->msg_.effort.push_back(0.0);
@@ -128,8 +228,30 @@ namespace barrett_controllers
       realtime_pub_->msg_.velocity_errors.push_back(0.0);
       realtime_pub_->msg_.resolver_angle.push_back(0.0);
       realtime_pub_->msg_.calibration_state.push_back(UNCALIBRATED);
+      realtime_pub_->msg_.calibration_step.push_back(IDLE);
+      realtime_pub_->msg_.calibration_time.push_back(0.0);
     }    
 
+    // A hint selects the right resolver revolution as long as it's within half
+    // a revolution of the actual position
+    if(hint_tolerances_.empty()) {
+      for (unsigned i=0; i<joint_names_.size(); i++){
+        hint_tolerances_.push_back(joint_handles_[i].getResolverRange()/4.0);
+      }
+    }
+    for (unsigned i=0; i<joint_names_.size(); i++){
+      if(hint_tolerances_[i] >= joint_handles_[i].getResolverRange()/2.0) {
+        ROS_WARN_STREAM("Hint tolerance of joint "<<joint_names_[i]<<" is larger than half a resolver revolution ("
+            <<joint_handles_[i].getResolverRange()/2.0<<"), hints for it will be ambiguous.");
+      }
+    }
+
+    // Allocate the command buffers
+    Command zero_command;
+    zero_command.values.assign(joint_names_.size(), 0.0);
+    effort_command_buffer_.writeFromNonRT(zero_command);
+    position_command_buffer_.writeFromNonRT(zero_command);
+
     // ROS API
     effort_command_sub_ = nh.subscribe("effort_cmd", 1, &CalibrationController::effort_command_cb, this);
     position_command_sub_ = nh.subscribe("position_cmd", 1, &CalibrationController::position_command_cb, this);
@@ -146,58 +268,128 @@ namespace barrett_controllers
     effort_command_.assign(effort_command_.size(), 0.0);
     position_errors_.assign(effort_command_.size(), 0.0);
     velocity_errors_.assign(effort_command_.size(), 0.0);
+    holding_.assign(holding_.size(), false);
+    // Ignore position commands received before the controller was started
+    last_position_command_seq_ = position_command_buffer_.readFromRT()->seq;
+
+    // Adopt calibrations which were restored by the hardware
+    for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
+      if(calibration_states_[jid] == UNCALIBRATED && joint_handles_[jid].isCalibrated() == 1) {
+        calibration_states_[jid] = CALIBRATED;
+        // Hold the current position
+        const double position = joint_handles_[jid].getOffset() + joint_handles_[jid].getPosition();
+        trajectory_.plan(jid, position, position);
+        trajectory_start_times_[jid] = time;
+        pids_.reset(jid);
+      }
+    }
+    trajectory_.synchronize();
   }
 
 
   void CalibrationController::update(const ros::Time& time, const ros::Duration& period)
   {
+    // Joints calibrated from their position hints are resolved together
+    this->resolve_hinted_joints(time);
+
+    // Get the latest commands
+    const Command &effort_command = *(effort_command_buffer_.readFromRT());
+    const Command &position_command = *(position_command_buffer_.readFromRT());
+    const bool effort_command_fresh = this->is_fresh(effort_command, time);
+
+    // Start a synchronized trajectory to a new position command for the
+    // calibrated joints. All of them are planned here in one cycle, so they
+    // arrive together. Joints which finish calibrating later aren't part of
+    // this move, and go to their home positions on their own.
+    if(position_command.seq != last_position_command_seq_) {
+      last_position_command_seq_ = position_command.seq;
+      if(this->is_fresh(position_command, time)) {
+        for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
+          if(calibration_states_[jid] == CALIBRATED) {
+            trajectory_.plan(
+                jid,
+                joint_handles_[jid].getOffset() + joint_handles_[jid].getPosition(),
+                position_command.values[jid]);
+            trajectory_start_times_[jid] = time;
+          }
+        }
+      } else {
+        // Reported in the published state, logging isn't realtime-safe
+        stale_position_commands_++;
+      }
+    }
+
+    // Trajectory setpoint
+    double setpoint_pos, setpoint_vel;
+
+    // Trajectories planned in this loop start at the current time, and are
+    // synchronized with each other after the loop. Sampling them at t = 0
+    // before then gives their start positions.
     for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
       barrett_model::SemiAbsoluteJointHandle &joint = joint_handles_[jid];
 
       switch(calibration_states_[jid]) {
         case UNCALIBRATED:
-          //TODO: hold fixed
+          // Apply the effort command while it's fresh
+          effort_command_[jid] = effort_command_fresh ? effort_command.values[jid] : 0.0;
           break;
         case CALIBRATED:
-          // Hold fixed in home position
-          effort_command_[jid] = 
-            pids_[jid].computeCommand(
-                home_positions_[jid] - (joint.getOffset() + joint.getPosition()),
-                0.0 - joint.getVelocity(),
-                period);
-          break;
+          {
+            // Follow the trajectory to the last position command (or to where
+            // the joint was calibrated), and hold fixed at its end
+            trajectory_.sample(jid, (time - trajectory_start_times_[jid]).toSec(), setpoint_pos, setpoint_vel);
+            position_errors_[jid] = setpoint_pos - (joint.getOffset() + joint.getPosition());
+            velocity_errors_[jid] = setpoint_vel - joint.getVelocity();
+            pids_.setErrors(jid, position_errors_[jid], velocity_errors_[jid]);
+            break;
+          }
         case CALIBRATING:
-          // All actively calibrating joints are in the same step at a time
-          switch(calibration_step_) {
+          // Each calibrating joint runs its own state machine
+          switch(calibration_steps_[jid]) {
             case IDLE:
+            case RESOLVE_FROM_HINT:
               { break; }
+            case WAIT_FOR_DEPENDENCIES:
+              {
+                // Hold the joint where it was when it started waiting, so it
+                // doesn't fall while the joints it depends on are calibrated
+                if(!holding_[jid]) {
+                  hold_positions_[jid] = joint.getPosition();
+                  holding_[jid] = true;
+                  pids_.reset(jid);
+                }
+                position_errors_[jid] = hold_positions_[jid] - joint.getPosition();
+                velocity_errors_[jid] = -joint.getVelocity();
+                pids_.setErrors(jid, position_errors_[jid], velocity_errors_[jid]);
+                break;
+              }
             case START_LIMIT_SEARCH: 
               {
                 // Reset offset
                 joint.setOffset(0.0);
+                joint.setCalibrated(0);
+                joint_calibration_start_times_[jid] = time;
                 // Create the trajectory
                 // Relative move to limit
                 if(limit_search_directions_[jid] > 0.0) {
-                  trajectories_[jid].SetProfile(joint.getPosition(), joint.getPosition() + upper_limits_[jid]-lower_limits_[jid]);
+                  trajectory_.plan(jid, joint.getPosition(), joint.getPosition() + upper_limits_[jid]-lower_limits_[jid]);
                 } else {
-                  trajectories_[jid].SetProfile(joint.getPosition(), joint.getPosition() + lower_limits_[jid]-upper_limits_[jid]);
+                  trajectory_.plan(jid, joint.getPosition(), joint.getPosition() + lower_limits_[jid]-upper_limits_[jid]);
                 }
 
                 // Clear the position buffer
-                position_history_[jid].clear();
-                bomb_armed_[jid] = false;
+                static_detectors_[jid].reset();
                 trajectory_start_times_[jid] = time;
-                pids_[jid].reset();
+                pids_.reset(jid);
               }
             case LIMIT_SEARCH: 
               {
                 // Find the positive or negative limit of this joint
                 // Drive towards the limit
-                position_errors_[jid] = trajectories_[jid].Pos((time - trajectory_start_times_[jid]).toSec()) - joint.getPosition();
-                velocity_errors_[jid] = trajectories_[jid].Vel((time - trajectory_start_times_[jid]).toSec()) - joint.getVelocity();
-                effort_command_[jid] = 
-                  pids_[jid].computeCommand(
-                      position_errors_[jid], velocity_errors_[jid], period);
+                trajectory_.sample(jid, (time - trajectory_start_times_[jid]).toSec(), setpoint_pos, setpoint_vel);
+                position_errors_[jid] = setpoint_pos - joint.getPosition();
+                velocity_errors_[jid] = setpoint_vel - joint.getVelocity();
+                pids_.setErrors(jid, position_errors_[jid], velocity_errors_[jid]);
                 break;
               }
             case START_APPROACH_CALIB_REGION:
@@ -206,14 +398,13 @@ namespace barrett_controllers
                 // Create the trajectory
                 if(limit_search_directions_[jid] > 0.0) {
                   joint.setOffset(upper_limits_[jid] - joint.getPosition());
-                  trajectories_[jid].SetProfile(upper_limits_[jid], home_positions_[jid]);
+                  trajectory_.plan(jid, upper_limits_[jid], home_positions_[jid]);
                 } else {
                   joint.setOffset(lower_limits_[jid] - joint.getPosition());
-                  trajectories_[jid].SetProfile(lower_limits_[jid], home_positions_[jid]);
+                  trajectory_.plan(jid, lower_limits_[jid], home_positions_[jid]);
                 }
                 // Clear the position buffer
-                position_history_[jid].clear();
-                bomb_armed_[jid] = false;
+                static_detectors_[jid].reset();
                 trajectory_start_times_[jid] = time;
                 //NOTE: Don't reset gains here to create a smooth transition
                 //between these two states
@@ -221,12 +412,11 @@ namespace barrett_controllers
               }
             case APPROACH_CALIB_REGION: 
               {
-                position_errors_[jid] = trajectories_[jid].Pos((time - trajectory_start_times_[jid]).toSec()) - (joint.getOffset() + joint.getPosition());
-                velocity_errors_[jid] = trajectories_[jid].Vel((time - trajectory_start_times_[jid]).toSec()) - joint.getVelocity();
+                trajectory_.sample(jid, (time - trajectory_start_times_[jid]).toSec(), setpoint_pos, setpoint_vel);
+                position_errors_[jid] = setpoint_pos - (joint.getOffset() + joint.getPosition());
+                velocity_errors_[jid] = setpoint_vel - joint.getVelocity();
 
-                effort_command_[jid] = 
-                  pids_[jid].computeCommand(
-                      position_errors_[jid], velocity_errors_[jid], period);
+                pids_.setErrors(jid, position_errors_[jid], velocity_errors_[jid]);
                 break;
               }
             case START_GO_HOME:
@@ -236,22 +426,20 @@ namespace barrett_controllers
                 joint.setOffset(joint.getOffset() 
                     + joint.getShortestDistance(resolver_offsets_[jid],joint.getResolverAngle()));
                 // Create the trajectory
-                trajectories_[jid].SetProfile(joint.getOffset() + joint.getPosition(), home_positions_[jid]);
+                trajectory_.plan(jid, joint.getOffset() + joint.getPosition(), home_positions_[jid]);
                 // Clear the position buffer
-                position_history_[jid].clear();
-                bomb_armed_[jid] = false;
+                static_detectors_[jid].reset();
                 trajectory_start_times_[jid] = time;
-                pids_[jid].reset();
+                pids_.reset(jid);
                 break;
               }
             case GO_HOME: 
               {
-                position_errors_[jid] = trajectories_[jid].Pos((time - trajectory_start_times_[jid]).toSec()) - (joint.getOffset() + joint.getPosition());
-                velocity_errors_[jid] = trajectories_[jid].Vel((time - trajectory_start_times_[jid]).toSec()) - joint.getVelocity();
+                trajectory_.sample(jid, (time - trajectory_start_times_[jid]).toSec(), setpoint_pos, setpoint_vel);
+                position_errors_[jid] = setpoint_pos - (joint.getOffset() + joint.getPosition());
+                velocity_errors_[jid] = setpoint_vel - joint.getVelocity();
 
-                effort_command_[jid] = 
-                  pids_[jid].computeCommand(
-                      position_errors_[jid], velocity_errors_[jid], period);
+                pids_.setErrors(jid, position_errors_[jid], velocity_errors_[jid]);
                 break;
               }
             case END_CALIBRATION: 
@@ -259,54 +447,62 @@ namespace barrett_controllers
                 // Mark this joint as calibrated
                 calibration_states_[jid] = CALIBRATED; 
                 joint_handles_[jid].setCalibrated(1);
-                pids_[jid].reset();
+                pids_.reset(jid);
+                joint_calibration_times_[jid] = (time - joint_calibration_start_times_[jid]).toSec();
                 break;
               }
           };
           break;
       };
+    }
+
+    // Start all of the trajectories planned in this cycle together
+    trajectory_.synchronize();
 
-      // Set the actual commands
+    // Compute the PID commands of all servoed joints at once
+    pids_.update(period.toSec(), effort_command_);
+
+    // Set the actual commands
+    for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
       joint_handles_[jid].setCommand(effort_command_[jid]);
     }
 
-    // Flag to determine if all calibrating joints are static
-    bool all_joints_static = true;
+    // Advance the state machine of each calibrating joint
+    bool any_joints_calibrating = false;
     for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
-      bool s = is_static(jid, joint_handles_[jid].getPosition());
+      // Keep feeding the detector so the window is full when it's needed
+      bool joint_static = static_detectors_[jid].update(joint_handles_[jid].getPosition());
 
-      if(calibration_states_[jid] == CALIBRATING) {
-        all_joints_static = all_joints_static && s;
-        if(calibration_step_ != LIMIT_SEARCH) {
-          all_joints_static = all_joints_static && fabs(position_errors_[jid]) < 0.05;
-        }
+      if(calibration_states_[jid] != CALIBRATING) {
+        calibration_steps_[jid] = IDLE;
+        holding_[jid] = false;
+        continue;
       }
-    }
 
-    switch(calibration_step_) {
-      case IDLE:
-        // No-op
-        break;
-      case START_LIMIT_SEARCH: 
-        calibration_step_ = LIMIT_SEARCH; break;
-      case LIMIT_SEARCH:
-        calibration_step_ = all_joints_static ? START_APPROACH_CALIB_REGION : LIMIT_SEARCH; break;
+      any_joints_calibrating = true;
 
-      case START_APPROACH_CALIB_REGION:
-        calibration_step_ = APPROACH_CALIB_REGION; break;
-      case APPROACH_CALIB_REGION:
-        calibration_step_ = all_joints_static ? START_GO_HOME : APPROACH_CALIB_REGION; break;
-
-      case START_GO_HOME:
-        calibration_step_ = GO_HOME; break;
-      case GO_HOME:
-        calibration_step_ = all_joints_static ? END_CALIBRATION : GO_HOME; break;
+      if(calibration_steps_[jid] != WAIT_FOR_DEPENDENCIES) {
+        joint_calibration_times_[jid] = (time - joint_calibration_start_times_[jid]).toSec();
+      }
+      if(calibration_steps_[jid] != LIMIT_SEARCH) {
+        joint_static = joint_static && fabs(position_errors_[jid]) < 0.05;
+      }
 
-      case END_CALIBRATION:
-        calibration_step_ = IDLE;
-        break;
-    };
+      calibration_steps_[jid] = this->next_step(jid, joint_static);
+      holding_[jid] = holding_[jid] && calibration_steps_[jid] == WAIT_FOR_DEPENDENCIES;
+    }
 
+    // Measure the total calibration time, which is published with the state
+    // rather than logged from the realtime thread
+    if(any_joints_calibrating) {
+      if(!calibration_active_) {
+        calibration_active_ = true;
+        calibration_start_time_ = time;
+      }
+      total_calibration_time_ = (time - calibration_start_time_).toSec();
+    } else if(calibration_active_) {
+      calibration_active_ = false;
+    }
 
     // limit rate of publishing
     if (publish_rate_ > 0.0 
@@ -327,8 +523,11 @@ namespace barrett_controllers
           realtime_pub_->msg_.position_errors[i] = position_errors_[i];
           realtime_pub_->msg_.velocity_errors[i] = velocity_errors_[i];
           realtime_pub_->msg_.calibration_state[i] = calibration_states_[i];
+          realtime_pub_->msg_.calibration_step[i] = calibration_steps_[i];
+          realtime_pub_->msg_.calibration_time[i] = joint_calibration_times_[i];
         }
-        realtime_pub_->msg_.calibration_step = calibration_step_;
+        realtime_pub_->msg_.total_calibration_time = total_calibration_time_;
+        realtime_pub_->msg_.stale_position_commands = stale_position_commands_;
         realtime_pub_->unlockAndPublish();
       }
     }
@@ -341,45 +540,221 @@ namespace barrett_controllers
       barrett_control_msgs::Calibrate::Request &req,
       barrett_control_msgs::Calibrate::Response &resp)
   {
-    if(calibration_step_ != IDLE) {
-      ROS_ERROR("Please wait for the active joints to finish calibrating...");
-      resp.ok = false;
-    } else {
-      for(std::vector<std::string>::iterator req_name = req.joint_names.begin();
-          req_name != req.joint_names.end();
-          ++req_name)
+    resp.ok = false;
+
+    const bool use_hints = (req.mode == barrett_control_msgs::Calibrate::Request::RESOLVER);
+    if(use_hints) {
+      if(req.hint_positions.empty() && hint_positions_.size() != joint_names_.size()) {
+        ROS_ERROR("Cannot calibrate from resolver angles without position hints.");
+        return resp.ok;
+      } else if(!req.hint_positions.empty() && req.hint_positions.size() != req.joint_names.size()) {
+        ROS_ERROR("Calibration request must have one position hint per joint.");
+        return resp.ok;
+      }
+    } else if(req.mode != barrett_control_msgs::Calibrate::Request::LIMIT_SEARCH) {
+      ROS_ERROR_STREAM("Unknown calibration mode "<<(int)req.mode);
+      return resp.ok;
+    }
+
+    // Resolve the requested joints
+    std::vector<int> requested_joints;
+    for(std::vector<std::string>::iterator req_name = req.joint_names.begin();
+        req_name != req.joint_names.end();
+        ++req_name)
+    {
+      const int jid = this->joint_index(*req_name);
+      if(jid < 0) {
+        ROS_ERROR_STREAM("Cannot calibrate unknown joint "<<*req_name);
+        return resp.ok;
+      } else if(calibration_states_[jid] == CALIBRATING) {
+        ROS_ERROR_STREAM("Please wait for joint "<<*req_name<<" to finish calibrating...");
+        return resp.ok;
+      }
+      requested_joints.push_back(jid);
+    }
+
+    // Make sure that every joint will eventually be able to start
+    for(std::vector<int>::iterator jid = requested_joints.begin();
+        jid != requested_joints.end();
+        ++jid)
+    {
+      for(std::vector<int>::iterator dep = dependencies_[*jid].begin();
+          dep != dependencies_[*jid].end();
+          ++dep)
       {
-        for(unsigned int i=0; i<joint_handles_.size(); i++) {
-          if(joint_handles_[i].getName() == *req_name) {
-            calibration_states_[i] = CALIBRATING;
-            resp.ok = true;
-            break;
-          }
+        if(calibration_states_[*dep] == UNCALIBRATED
+            && std::find(requested_joints.begin(), requested_joints.end(), *dep) == requested_joints.end())
+        {
+          ROS_ERROR_STREAM("Joint "<<joint_names_[*jid]<<" can't be calibrated until joint "
+              <<joint_names_[*dep]<<" is calibrated.");
+          return resp.ok;
         }
       }
+    }
 
-      // Begin calibration
-      calibration_step_ = START_LIMIT_SEARCH;
+    // Begin calibration
+    for(unsigned i=0; i<requested_joints.size(); i++) {
+      const int jid = requested_joints[i];
+      if(use_hints) {
+        calibration_hints_[jid] = req.hint_positions.empty() ? hint_positions_[jid] : req.hint_positions[i];
+        calibration_steps_[jid] = RESOLVE_FROM_HINT;
+      } else {
+        calibration_steps_[jid] = WAIT_FOR_DEPENDENCIES;
+      }
+      calibration_states_[jid] = CALIBRATING;
     }
+    resp.ok = true;
 
     return resp.ok;
   }
 
 
-  void CalibrationController::effort_command_cb(const barrett_control_msgs::JointCommandConstPtr & msg)
+  int CalibrationController::joint_index(const std::string &joint_name) const
   {
-    for(unsigned int i=0; i<effort_command_.size() && i <msg->command.size(); i++) {
-      effort_command_[i] = msg->command[i];
+    for(unsigned int i=0; i<joint_names_.size(); i++) {
+      if(joint_names_[i] == joint_name) {
+        return i;
+      }
     }
+    return -1;
   }
 
-  void CalibrationController::position_command_cb(const barrett_control_msgs::JointCommandConstPtr & msg)
+  bool CalibrationController::dependencies_satisfied(const int jid) const
+  {
+    for(std::vector<int>::const_iterator dep = dependencies_[jid].begin();
+        dep != dependencies_[jid].end();
+        ++dep)
+    {
+      if(calibration_states_[*dep] != CALIBRATED) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  CalibrationController::calibration_step_t CalibrationController::next_step(
+      const int jid,
+      const bool is_static) const
+  {
+    switch(calibration_steps_[jid]) {
+      case IDLE:
+        return IDLE;
+      case WAIT_FOR_DEPENDENCIES:
+        return this->dependencies_satisfied(jid) ? START_LIMIT_SEARCH : WAIT_FOR_DEPENDENCIES;
+      case RESOLVE_FROM_HINT:
+        return RESOLVE_FROM_HINT;
+
+      case START_LIMIT_SEARCH: 
+        return LIMIT_SEARCH;
+      case LIMIT_SEARCH:
+        return is_static ? START_APPROACH_CALIB_REGION : LIMIT_SEARCH;
+
+      case START_APPROACH_CALIB_REGION:
+        return APPROACH_CALIB_REGION;
+      case APPROACH_CALIB_REGION:
+        return is_static ? START_GO_HOME : APPROACH_CALIB_REGION;
+
+      case START_GO_HOME:
+        return GO_HOME;
+      case GO_HOME:
+        return is_static ? END_CALIBRATION : GO_HOME;
+
+      case END_CALIBRATION:
+        return IDLE;
+    };
+
+    return IDLE;
+  }
+
+  bool CalibrationController::resolve_from_hint(const int jid, double &position) const
+  {
+    const barrett_model::SemiAbsoluteJointHandle &joint = joint_handles_[jid];
+    const double resolver_range = joint.getResolverRange();
+
+    // A position consistent with the resolver angle
+    const double base_position = home_positions_[jid]
+      + joint.getShortestDistance(resolver_offsets_[jid], joint.getResolverAngle());
+
+    // Choose the resolver revolution closest to the hint
+    const double n_revolutions = floor((calibration_hints_[jid] - base_position)/resolver_range + 0.5);
+    position = base_position + n_revolutions*resolver_range;
+
+    return fabs(position - calibration_hints_[jid]) <= hint_tolerances_[jid]
+      && position >= lower_limits_[jid]
+      && position <= upper_limits_[jid];
+  }
+
+  void CalibrationController::resolve_hinted_joints(const ros::Time &time)
   {
-    for(unsigned int i=0; i<position_command_.size() && i <msg->command.size(); i++) {
-      if(calibration_states_[i] == CALIBRATED) {
-        //trajectories_[i].SetProfile(joint.getOffset() + joint.getPosition(), home_positions_[jid]);
+    // Resolve every joint, since one bad hint means the arm isn't in the
+    // hinted pose, and the hints for the other joints can't be trusted either
+    bool any_hinted = false;
+    bool all_resolved = true;
+    for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
+      if(calibration_states_[jid] == CALIBRATING && calibration_steps_[jid] == RESOLVE_FROM_HINT) {
+        any_hinted = true;
+        all_resolved = this->resolve_from_hint(jid, resolved_positions_[jid]) && all_resolved;
       }
     }
+
+    if(!any_hinted) {
+      return;
+    }
+
+    for(unsigned jid=0; jid < joint_handles_.size(); jid++) {
+      if(calibration_states_[jid] == CALIBRATING && calibration_steps_[jid] == RESOLVE_FROM_HINT) {
+        joint_calibration_start_times_[jid] = time;
+        if(all_resolved) {
+          // Calibrate in place
+          joint_handles_[jid].setOffset(resolved_positions_[jid] - joint_handles_[jid].getPosition());
+          trajectory_.plan(jid, resolved_positions_[jid], resolved_positions_[jid]);
+          trajectory_start_times_[jid] = time;
+          pids_.reset(jid);
+          calibration_steps_[jid] = END_CALIBRATION;
+        } else {
+          // Fall back to searching for the limits
+          calibration_steps_[jid] = WAIT_FOR_DEPENDENCIES;
+        }
+      }
+    }
+
+    if(!all_resolved) {
+      ROS_WARN("Joint positions are ambiguous given the position hints, falling back to limit search.");
+    }
+  }
+
+  bool CalibrationController::write_command(
+      const barrett_control_msgs::JointCommandConstPtr & msg,
+      realtime_tools::RealtimeBuffer<Command> &buffer)
+  {
+    if(msg->command.size() != joint_names_.size()) {
+      ROS_ERROR_STREAM("Command has "<<msg->command.size()<<" values, but "<<joint_names_.size()<<" joints are controlled.");
+      return false;
+    }
+
+    // All allocation happens here, the realtime thread only swaps buffers
+    Command command;
+    command.values = msg->command;
+    command.stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
+    command.seq = buffer.readFromNonRT()->seq + 1;
+    buffer.writeFromNonRT(command);
+
+    return true;
+  }
+
+  bool CalibrationController::is_fresh(const Command &command, const ros::Time &time) const
+  {
+    return command.seq > 0 && (time - command.stamp).toSec() < command_timeout_;
+  }
+
+  void CalibrationController::effort_command_cb(const barrett_control_msgs::JointCommandConstPtr & msg)
+  {
+    this->write_command(msg, effort_command_buffer_);
+  }
+
+  void CalibrationController::position_command_cb(const barrett_control_msgs::JointCommandConstPtr & msg)
+  {
+    this->write_command(msg, position_command_buffer_);
   }
 }
 
@@ -0,0 +1,331 @@
+
+#include <barrett_controllers/cartesian_impedance_controller.h>
+
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <terse_roscpp/params.h>
+
+namespace barrett_controllers
+{
+
+  template <class Model>
+  CartesianImpedanceController<Model>::CartesianImpedanceController() :
+    active_(false),
+    last_command_seq_(0),
+    hold_posture_(true),
+    regularization_(1E-6)
+  {
+
+  }
+
+  template <class Model>
+  bool CartesianImpedanceController<Model>::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    // Only the effort interface claims the joints, the calibrated state and
+    // the kinematics are read-only
+    barrett_model::EffortFeedforwardInterface *state_interface =
+      robot_hw->get<barrett_model::EffortFeedforwardInterface>();
+    barrett_model::ArmKinematicsInterface *kinematics_interface =
+      robot_hw->get<barrett_model::ArmKinematicsInterface>();
+    if(!state_interface || !kinematics_interface) {
+      ROS_ERROR("CartesianImpedanceController needs an EffortFeedforwardInterface and an ArmKinematicsInterface to read the calibrated state of the arm.");
+      return false;
+    }
+
+    if(!controller_interface::Controller<hardware_interface::EffortJointInterface>::initRequest(
+          robot_hw, root_nh, controller_nh, claimed_resources))
+    {
+      return false;
+    }
+
+    try {
+      for(int j=0; j<N_DOF; j++) {
+        state_handles_.push_back(state_interface->getEffortFeedforwardHandle(joint_names_[j]));
+      }
+    } catch(hardware_interface::HardwareInterfaceException &ex) {
+      ROS_ERROR_STREAM("Could not get the calibrated state of the joints: "<<ex.what());
+      return false;
+    }
+
+    // Find the arm made of the controlled joints
+    const std::vector<std::string> arm_names = kinematics_interface->getArmNames();
+    for(size_t i=0; i<arm_names.size(); i++) {
+      const barrett_model::ArmKinematicsHandle handle = kinematics_interface->getArmKinematicsHandle(arm_names[i]);
+      if(handle.getJointNames() == joint_names_) {
+        kinematics_handle_ = handle;
+        return true;
+      }
+    }
+
+    ROS_ERROR("No arm in the ArmKinematicsInterface is made of the controlled joints.");
+    return false;
+  }
+
+  template <class Model>
+  bool CartesianImpedanceController<Model>::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    // Get the joints, from root to tip
+    require_param(nh, "joint_names", joint_names_,
+        "The names of the arm's joints, from root to tip.");
+    if(joint_names_.size() != static_cast<size_t>(N_DOF)) {
+      ROS_ERROR_STREAM("CartesianImpedanceController needs "<<N_DOF<<" joints, but "<<joint_names_.size()<<" were given.");
+      return false;
+    }
+
+    std::vector<double> stiffness, damping, null_stiffness, null_damping, posture;
+    require_param(nh, "stiffness", stiffness,
+        "Tip stiffness [N/m, N/m, N/m, Nm/rad, Nm/rad, Nm/rad].");
+    require_param(nh, "damping", damping,
+        "Tip damping [N/(m/s), N/(m/s), N/(m/s), Nm/(rad/s), Nm/(rad/s), Nm/(rad/s)].");
+    require_param(nh, "null_stiffness", null_stiffness,
+        "Null-space posture stiffness [Nm/rad] of each joint.");
+    require_param(nh, "null_damping", null_damping,
+        "Null-space posture damping [Nm/(rad/s)] of each joint.");
+    if(nh.hasParam("posture")) {
+      require_param(nh, "posture", posture,
+          "Null-space posture [rad], the posture at start is held if this is not given.");
+    }
+    if(nh.hasParam("regularization")) {
+      require_param(nh, "regularization", regularization_,
+          "Added to the diagonal of the inverse task-space mass matrix near singularities.");
+    }
+
+    if(stiffness.size() != 6 || damping.size() != 6) {
+      ROS_ERROR("The tip stiffness and damping must have six elements.");
+      return false;
+    }
+    if(null_stiffness.size() != joint_names_.size()
+        || null_damping.size() != joint_names_.size()
+        || (!posture.empty() && posture.size() != joint_names_.size()))
+    {
+      ROS_ERROR("The null-space posture, stiffness and damping must have one element per joint.");
+      return false;
+    }
+
+    for(int i=0; i<6; i++) {
+      stiffness_[i] = stiffness[i];
+      damping_[i] = damping[i];
+    }
+    for(int j=0; j<N_DOF; j++) {
+      null_stiffness_[j] = null_stiffness[j];
+      null_damping_[j] = null_damping[j];
+    }
+    hold_posture_ = posture.empty();
+    posture_.setZero();
+    if(!hold_posture_) {
+      for(int j=0; j<N_DOF; j++) {
+        posture_[j] = posture[j];
+      }
+    }
+
+    // Get the joint handles
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_.push_back(hw->getHandle(joint_names_[j]));
+    }
+
+    target_position_.setZero();
+    target_rotation_.setIdentity();
+
+    // Initialize the command buffer, no command has been received yet
+    command_buffer_.writeFromNonRT(Command());
+
+    command_sub_ = nh.subscribe("command", 1, &CartesianImpedanceController<Model>::command_cb, this);
+
+    return true;
+  }
+
+  template <class Model>
+  bool CartesianImpedanceController<Model>::is_calibrated() const
+  {
+    for(int j=0; j<N_DOF; j++) {
+      if(state_handles_[j].isCalibrated() != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class Model>
+  void CartesianImpedanceController<Model>::hold_current_pose()
+  {
+    target_rotation_ = kinematics_handle_.getToolRotation();
+    target_position_ = kinematics_handle_.getToolPosition();
+    if(hold_posture_) {
+      for(int j=0; j<N_DOF; j++) {
+        posture_[j] = state_handles_[j].getPosition();
+      }
+    }
+  }
+
+  template <class Model>
+  void CartesianImpedanceController<Model>::starting(const ros::Time& time)
+  {
+    // The kinematics are meaningless until all of the joints are calibrated,
+    // so refuse to run until then, the command callback warns about it
+    active_ = this->is_calibrated();
+    if(active_) {
+      // Hold the current pose until a command is received
+      this->hold_current_pose();
+    }
+
+    // Ignore commands which were received before the controller started
+    last_command_seq_ = command_buffer_.readFromRT()->seq;
+  }
+
+  template <class Model>
+  void CartesianImpedanceController<Model>::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // The calibration is lost if it's restarted
+    if(active_ && !this->is_calibrated()) {
+      active_ = false;
+    }
+    if(!active_) {
+      last_command_seq_ = command_buffer_.readFromRT()->seq;
+      for(int j=0; j<N_DOF; j++) {
+        joint_handles_[j].setCommand(0.0);
+      }
+      return;
+    }
+
+    // Apply a new command
+    const Command &command = *(command_buffer_.readFromRT());
+    if(command.seq != last_command_seq_) {
+      last_command_seq_ = command.seq;
+      target_position_ = command.position;
+      target_rotation_ = command.rotation;
+      if(command.has_gains) {
+        stiffness_ = command.stiffness;
+        damping_ = command.damping;
+      }
+      if(command.has_posture) {
+        posture_ = command.posture;
+      }
+    }
+
+    for(int j=0; j<N_DOF; j++) {
+      positions_[j] = state_handles_[j].getPosition();
+      velocities_[j] = state_handles_[j].getVelocity();
+    }
+
+    // The kinematics are shared with the other controllers of the arm
+    jacobian_ = kinematics_handle_.getJacobian();
+    tip_rotation_ = kinematics_handle_.getToolRotation();
+    tip_position_ = kinematics_handle_.getToolPosition();
+    Model::mass_matrix(positions_, mass_);
+
+    // Pose error, the orientation error is the sum of the rotations which
+    // would align each axis of the tip with the target
+    error_.template head<3>() = target_position_ - tip_position_;
+    error_.template tail<3>() = 0.5*(
+        tip_rotation_.col(0).cross(target_rotation_.col(0))
+        + tip_rotation_.col(1).cross(target_rotation_.col(1))
+        + tip_rotation_.col(2).cross(target_rotation_.col(2)));
+
+    // Spring and damper on the tip
+    wrench_ = stiffness_.cwiseProduct(error_) - damping_.cwiseProduct(jacobian_*velocities_);
+    efforts_ = jacobian_.transpose()*wrench_;
+
+    // Dynamically-consistent generalized inverse of the Jacobian
+    mass_ldlt_.compute(mass_);
+    inverse_mass_jacobian_t_ = mass_ldlt_.solve(jacobian_.transpose());
+    inverse_task_mass_ = jacobian_*inverse_mass_jacobian_t_;
+    inverse_task_mass_.diagonal().array() += regularization_;
+    task_mass_ldlt_.compute(inverse_task_mass_);
+    generalized_inverse_ = inverse_mass_jacobian_t_*task_mass_ldlt_.solve(Matrix6::Identity());
+
+    // Posture task, projected so it does not disturb the tip
+    null_efforts_ = null_stiffness_.cwiseProduct(posture_ - positions_) - null_damping_.cwiseProduct(velocities_);
+    efforts_ += null_efforts_ - jacobian_.transpose()*(generalized_inverse_.transpose()*null_efforts_);
+
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(efforts_[j]);
+    }
+  }
+
+  template <class Model>
+  void CartesianImpedanceController<Model>::stopping(const ros::Time& time)
+  {
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(0.0);
+    }
+  }
+
+  template <class Model>
+  void CartesianImpedanceController<Model>::command_cb(
+      const barrett_control_msgs::CartesianImpedanceCommandConstPtr &msg)
+  {
+    if((!msg->stiffness.empty() || !msg->damping.empty())
+        && (msg->stiffness.size() != 6 || msg->damping.size() != 6))
+    {
+      ROS_ERROR("The stiffness and damping must be given together, with six elements each.");
+      return;
+    }
+    if(!msg->posture.empty() && msg->posture.size() != joint_names_.size()) {
+      ROS_ERROR_STREAM("The posture has "<<msg->posture.size()<<" elements, but "<<joint_names_.size()<<" joints are controlled.");
+      return;
+    }
+    if(!active_) {
+      ROS_WARN_THROTTLE(1.0, "CartesianImpedanceController was started before the arm was calibrated, restart it to accept commands.");
+    }
+
+    // A zero (e.g. default-constructed) quaternion has no orientation
+    const Eigen::Quaterniond orientation(
+        msg->pose.orientation.w,
+        msg->pose.orientation.x,
+        msg->pose.orientation.y,
+        msg->pose.orientation.z);
+    if(!(orientation.norm() > 1E-6)) {
+      ROS_WARN_THROTTLE(1.0, "Ignoring a command with an invalid orientation quaternion.");
+      return;
+    }
+
+    Command command;
+    command.position = Eigen::Vector3d(
+        msg->pose.position.x,
+        msg->pose.position.y,
+        msg->pose.position.z);
+    command.rotation = orientation.normalized().toRotationMatrix();
+
+    command.has_gains = !msg->stiffness.empty();
+    for(int i=0; i<6 && command.has_gains; i++) {
+      command.stiffness[i] = msg->stiffness[i];
+      command.damping[i] = msg->damping[i];
+    }
+
+    command.has_posture = !msg->posture.empty();
+    for(int j=0; j<N_DOF && command.has_posture; j++) {
+      command.posture[j] = msg->posture[j];
+    }
+
+    command.seq = command_buffer_.readFromNonRT()->seq + 1;
+    command_buffer_.writeFromNonRT(command);
+  }
+
+  template class CartesianImpedanceController<barrett_model::Wam4DofModel>;
+  template class CartesianImpedanceController<barrett_model::Wam7DofModel>;
+
+  typedef CartesianImpedanceController<barrett_model::Wam4DofModel> Wam4DofCartesianImpedanceController;
+  typedef CartesianImpedanceController<barrett_model::Wam7DofModel> Wam7DofCartesianImpedanceController;
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam4DofCartesianImpedanceController,
+    barrett_controllers::Wam4DofCartesianImpedanceController,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam7DofCartesianImpedanceController,
+    barrett_controllers::Wam7DofCartesianImpedanceController,
+    controller_interface::ControllerBase)
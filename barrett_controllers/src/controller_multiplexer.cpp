@@ -0,0 +1,364 @@
+#include <barrett_controllers/controller_multiplexer.h>
+
+#include <barrett_model/arm_kinematics_interface.h>
+#include <barrett_model/effort_feedforward_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+
+#include <terse_roscpp/params.h>
+
+#include <algorithm>
+
+namespace barrett_controllers
+{
+
+  ControllerMultiplexer::ControllerMultiplexer() :
+    shadow_(false),
+    blend_cycles_(10),
+    last_selection_seq_(0),
+    active_(0),
+    previous_(-1),
+    blend_count_(0),
+    blend_(1.0),
+    switch_count_(0),
+    publish_rate_(10.0)
+  {
+
+  }
+
+  ControllerMultiplexer::~ControllerMultiplexer()
+  {
+    // Destroy the children before the loader which created them
+    children_.clear();
+  }
+
+  bool ControllerMultiplexer::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    if(!controller_interface::Controller<hardware_interface::EffortJointInterface>::initRequest(
+          robot_hw, root_nh, controller_nh, claimed_resources))
+    {
+      return false;
+    }
+
+    return this->load_children(robot_hw, root_nh, controller_nh, claimed_resources);
+  }
+
+  bool ControllerMultiplexer::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    std::vector<std::string> controller_names;
+    require_param(nh, "joint_names", joint_names_,
+        "The names of the joints which are commanded by the children.");
+    require_param(nh, "controllers", controller_names,
+        "The names of the child controllers, the first one is active at start.");
+    if(nh.hasParam("shadow")) {
+      require_param(nh, "shadow", shadow_,
+          "Whether the inactive children are updated too.");
+    }
+    if(nh.hasParam("blend_cycles")) {
+      require_param(nh, "blend_cycles", blend_cycles_,
+          "The number of cycles over which the efforts are blended after a switch.");
+    }
+    if(nh.hasParam("publish_rate")) {
+      require_param(nh, "publish_rate", publish_rate_,
+          "The rate [Hz] at which the multiplexer state is published.");
+    }
+
+    if(controller_names.empty()) {
+      ROS_ERROR("The multiplexer needs at least one child controller.");
+      return false;
+    }
+    if(blend_cycles_ < 0) {
+      ROS_ERROR("The number of blend cycles can't be negative.");
+      return false;
+    }
+
+    for(size_t j=0; j<joint_names_.size(); j++) {
+      joint_handles_.push_back(hw->getHandle(joint_names_[j]));
+    }
+
+    // The children's handles point into their effort buffers, so the
+    // children can't be moved once they're set up
+    children_.resize(controller_names.size());
+    for(size_t c=0; c<children_.size(); c++) {
+      children_[c].name = controller_names[c];
+      children_[c].running = false;
+      children_[c].efforts.assign(joint_names_.size(), 0.0);
+    }
+
+    // Allocate the state message
+    state_pub_.reset(
+        new realtime_tools::RealtimePublisher<barrett_control_msgs::MultiplexerState>(
+          nh, "multiplexer_state", 4));
+    state_pub_->msg_.name = controller_names;
+    state_pub_->msg_.running.assign(children_.size(), false);
+    // Reserve the name strings, so they can be assigned without allocating
+    size_t max_name_length = 0;
+    for(size_t c=0; c<children_.size(); c++) {
+      max_name_length = std::max(max_name_length, children_[c].name.size());
+    }
+    state_pub_->msg_.active.reserve(max_name_length);
+    state_pub_->msg_.previous.reserve(max_name_length);
+
+    // Initialize the selection buffer, no selection has been received yet
+    selection_buffer_.writeFromNonRT(Selection());
+
+    select_srv_ = nh.advertiseService("select", &ControllerMultiplexer::select_srv_cb, this);
+
+    return true;
+  }
+
+  bool ControllerMultiplexer::load_children(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &nh,
+      std::set<std::string> &claimed_resources)
+  {
+    using namespace terse_roscpp;
+
+    // The calibration of the joints is offered to the children if the
+    // hardware has it for all of them
+    std::vector<barrett_model::SemiAbsoluteJointHandle> semi_absolute_handles;
+    barrett_model::SemiAbsoluteJointInterface *semi_absolute_interface =
+      robot_hw->get<barrett_model::SemiAbsoluteJointInterface>();
+    if(semi_absolute_interface) {
+      try {
+        for(size_t j=0; j<joint_names_.size(); j++) {
+          semi_absolute_handles.push_back(semi_absolute_interface->getSemiAbsoluteJointHandle(joint_names_[j]));
+        }
+      } catch(hardware_interface::HardwareInterfaceException &ex) {
+        semi_absolute_handles.clear();
+      }
+      // The joints are claimed through the effort interface
+      semi_absolute_interface->clearClaims();
+    }
+
+    // The read-only interfaces are shared with the hardware
+    hardware_interface::JointStateInterface *state_interface =
+      robot_hw->get<hardware_interface::JointStateInterface>();
+    barrett_model::EffortFeedforwardInterface *feedforward_interface =
+      robot_hw->get<barrett_model::EffortFeedforwardInterface>();
+    barrett_model::ArmKinematicsInterface *kinematics_interface =
+      robot_hw->get<barrett_model::ArmKinematicsInterface>();
+
+    controller_loader_.reset(
+        new pluginlib::ClassLoader<controller_interface::ControllerBase>(
+          "controller_interface", "controller_interface::ControllerBase"));
+
+    for(size_t c=0; c<children_.size(); c++) {
+      Child &child = children_[c];
+
+      ros::NodeHandle child_nh(nh, child.name);
+      std::string type;
+      require_param(child_nh, "type", type,
+          "The type of the child controller.");
+
+      try {
+        child.controller = controller_loader_->createInstance(type);
+      } catch(pluginlib::PluginlibException &ex) {
+        ROS_ERROR_STREAM("Could not load child controller "<<child.name<<" of type "<<type<<": "<<ex.what());
+        return false;
+      }
+
+      // The child reads the real joint states, and commands its own buffers
+      child.robot_hw.reset(new hardware_interface::RobotHW());
+      child.interface.reset(new hardware_interface::EffortJointInterface());
+      for(size_t j=0; j<joint_names_.size(); j++) {
+        child.interface->registerHandle(
+            hardware_interface::JointHandle(joint_handles_[j], &child.efforts[j]));
+      }
+      child.robot_hw->registerInterface(child.interface.get());
+
+      if(!semi_absolute_handles.empty()) {
+        child.semi_absolute_interface.reset(new barrett_model::SemiAbsoluteJointInterface());
+        for(size_t j=0; j<joint_names_.size(); j++) {
+          child.semi_absolute_interface->registerHandle(
+              barrett_model::SemiAbsoluteJointHandle(semi_absolute_handles[j], &child.efforts[j]));
+        }
+        child.robot_hw->registerInterface(child.semi_absolute_interface.get());
+      }
+
+      if(state_interface) {
+        child.robot_hw->registerInterface(state_interface);
+      }
+      if(feedforward_interface) {
+        child.robot_hw->registerInterface(feedforward_interface);
+      }
+      if(kinematics_interface) {
+        child.robot_hw->registerInterface(kinematics_interface);
+      }
+
+      std::set<std::string> child_resources;
+      if(!child.controller->initRequest(child.robot_hw.get(), root_nh, child_nh, child_resources)) {
+        ROS_ERROR_STREAM("Could not initialize child controller "<<child.name<<" of type "<<type
+            <<". Its hardware interface has to be one of the ones offered to the children.");
+        return false;
+      }
+      claimed_resources.insert(child_resources.begin(), child_resources.end());
+    }
+
+    return true;
+  }
+
+  void ControllerMultiplexer::starting(const ros::Time& time)
+  {
+    active_ = 0;
+    previous_ = -1;
+    blend_count_ = 0;
+    blend_ = 1.0;
+    switch_count_ = 0;
+
+    for(size_t c=0; c<children_.size(); c++) {
+      if(shadow_ || static_cast<int>(c) == active_) {
+        this->start_child(children_[c], time);
+      }
+    }
+
+    last_publish_time_ = time;
+
+    // Ignore selections which were made before the multiplexer started
+    last_selection_seq_ = selection_buffer_.readFromRT()->seq;
+  }
+
+  void ControllerMultiplexer::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // Switch at the start of the cycle, once the last blend is finished
+    if(previous_ < 0) {
+      const Selection &selection = *(selection_buffer_.readFromRT());
+      if(selection.seq != last_selection_seq_) {
+        last_selection_seq_ = selection.seq;
+        if(selection.index != active_) {
+          previous_ = active_;
+          active_ = selection.index;
+          blend_count_ = 0;
+          switch_count_++;
+          // This runs in the realtime thread, so the child's starting() has
+          // to be realtime-safe
+          this->start_child(children_[active_], time);
+        }
+      }
+    }
+
+    // Update the running children
+    for(size_t c=0; c<children_.size(); c++) {
+      if(children_[c].running) {
+        children_[c].controller->update(time, period);
+      }
+    }
+
+    // Blend the previous child's efforts into the active child's ones
+    const std::vector<double> &active_efforts = children_[active_].efforts;
+    if(previous_ >= 0) {
+      blend_count_++;
+      blend_ = (blend_cycles_ > 0) ? static_cast<double>(blend_count_)/blend_cycles_ : 1.0;
+      if(blend_ > 1.0) {
+        blend_ = 1.0;
+      }
+
+      const std::vector<double> &previous_efforts = children_[previous_].efforts;
+      for(size_t j=0; j<joint_handles_.size(); j++) {
+        joint_handles_[j].setCommand(
+            blend_*active_efforts[j] + (1.0 - blend_)*previous_efforts[j]);
+      }
+
+      if(blend_count_ >= blend_cycles_) {
+        if(!shadow_) {
+          this->stop_child(children_[previous_], time);
+        }
+        previous_ = -1;
+      }
+    } else {
+      for(size_t j=0; j<joint_handles_.size(); j++) {
+        joint_handles_[j].setCommand(active_efforts[j]);
+      }
+    }
+
+    if(publish_rate_ > 0.0
+        && (time - last_publish_time_).toSec() >= 1.0/publish_rate_
+        && state_pub_->trylock())
+    {
+      barrett_control_msgs::MultiplexerState &msg = state_pub_->msg_;
+      msg.header.stamp = time;
+      for(size_t c=0; c<children_.size(); c++) {
+        msg.running[c] = children_[c].running;
+      }
+      msg.active = children_[active_].name;
+      if(previous_ >= 0) {
+        msg.previous = children_[previous_].name;
+      } else {
+        msg.previous.clear();
+      }
+      msg.blend = blend_;
+      msg.switch_count = switch_count_;
+      state_pub_->unlockAndPublish();
+      last_publish_time_ = time;
+    }
+  }
+
+  void ControllerMultiplexer::stopping(const ros::Time& time)
+  {
+    for(size_t c=0; c<children_.size(); c++) {
+      if(children_[c].running) {
+        this->stop_child(children_[c], time);
+      }
+    }
+    previous_ = -1;
+
+    for(size_t j=0; j<joint_handles_.size(); j++) {
+      joint_handles_[j].setCommand(0.0);
+    }
+  }
+
+  void ControllerMultiplexer::start_child(Child &child, const ros::Time& time)
+  {
+    if(!child.running) {
+      child.controller->starting(time);
+      child.running = true;
+    }
+  }
+
+  void ControllerMultiplexer::stop_child(Child &child, const ros::Time& time)
+  {
+    if(child.running) {
+      child.controller->stopping(time);
+      child.running = false;
+    }
+  }
+
+  bool ControllerMultiplexer::select_srv_cb(
+      barrett_control_msgs::SelectController::Request &req,
+      barrett_control_msgs::SelectController::Response &resp)
+  {
+    resp.ok = false;
+    for(size_t c=0; c<children_.size(); c++) {
+      if(children_[c].name == req.name) {
+        Selection selection;
+        selection.index = c;
+        selection.seq = selection_buffer_.readFromNonRT()->seq + 1;
+        selection_buffer_.writeFromNonRT(selection);
+        resp.ok = true;
+        break;
+      }
+    }
+
+    if(!resp.ok) {
+      ROS_ERROR_STREAM("There is no child controller named "<<req.name<<".");
+    }
+
+    return true;
+  }
+
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    ControllerMultiplexer,
+    barrett_controllers::ControllerMultiplexer,
+    controller_interface::ControllerBase)
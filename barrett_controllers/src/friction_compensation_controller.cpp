@@ -0,0 +1,91 @@
+
+#include <barrett_controllers/friction_compensation_controller.h>
+
+#include <terse_roscpp/params.h>
+
+namespace barrett_controllers
+{
+
+  FrictionCompensationController::FrictionCompensationController()
+  {
+
+  }
+
+  bool FrictionCompensationController::init(
+      barrett_model::EffortFeedforwardInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    std::string friction_file;
+    require_param(nh, "friction_file", friction_file,
+        "The file of friction lookup tables written by identify_friction.py.");
+
+    std::vector<barrett_model::FrictionTable> tables;
+    if(!barrett_model::load_friction_tables(friction_file, tables)) {
+      ROS_ERROR_STREAM("Could not load the friction tables from \""<<friction_file<<"\".");
+      return false;
+    }
+
+    double scale = 1.0;
+    if(nh.hasParam("scale")) {
+      require_param(nh, "scale", scale,
+          "The fraction of the identified friction which is compensated.");
+    }
+
+    // Compensate all of the joints in the file by default
+    std::vector<std::string> joint_names;
+    if(nh.hasParam("joint_names")) {
+      require_param(nh, "joint_names", joint_names,
+          "The names of the compensated joints.");
+    } else {
+      for(size_t i=0; i<tables.size(); i++) {
+        joint_names.push_back(tables[i].getJointName());
+      }
+    }
+
+    for(size_t j=0; j<joint_names.size(); j++) {
+      std::vector<barrett_model::FrictionTable>::const_iterator table = tables.begin();
+      while(table != tables.end() && table->getJointName() != joint_names[j]) {
+        ++table;
+      }
+      if(table == tables.end()) {
+        ROS_ERROR_STREAM("There is no friction table for joint "<<joint_names[j]<<" in \""<<friction_file<<"\".");
+        return false;
+      }
+
+      friction_tables_.push_back(*table);
+      friction_tables_.back().scale(scale);
+      joint_handles_.push_back(hw->getEffortFeedforwardHandle(joint_names[j]));
+    }
+
+    return true;
+  }
+
+  void FrictionCompensationController::starting(const ros::Time& time)
+  {
+
+  }
+
+  void FrictionCompensationController::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // Friction only depends on the velocity, so the joints don't need to be
+    // calibrated. After a collision, the friction has to slow the arm down.
+    for(size_t j=0; j<joint_handles_.size(); j++) {
+      if(joint_handles_[j].isInCollision()) {
+        continue;
+      }
+      joint_handles_[j].addEffort(friction_tables_[j].compute(joint_handles_[j].getVelocity()));
+    }
+  }
+
+  void FrictionCompensationController::stopping(const ros::Time& time)
+  {}
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    FrictionCompensationController,
+    barrett_controllers::FrictionCompensationController,
+    controller_interface::ControllerBase)
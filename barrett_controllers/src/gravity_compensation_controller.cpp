@@ -0,0 +1,156 @@
+
+#include <barrett_controllers/gravity_compensation_controller.h>
+#include <barrett_controllers/payload_file.h>
+
+#include <kdl/tree.hpp>
+#include <kdl_urdf_tools/tools.h>
+#include <urdf/model.h>
+
+#include <terse_roscpp/params.h>
+
+namespace barrett_controllers
+{
+
+  GravityCompensationController::GravityCompensationController()
+  {
+
+  }
+
+  bool GravityCompensationController::init(
+      barrett_model::EffortFeedforwardInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    std::string robot_description_param, robot_description, root_link, tip_link;
+
+    // The robot description is usually global
+    if(!nh.searchParam("robot_description", robot_description_param)) {
+      ROS_ERROR_STREAM("Could not find parameter 'robot_description' above namespace "<<nh.getNamespace());
+      return false;
+    }
+    require_param(nh, robot_description_param, robot_description,
+        "The URDF of the robot.");
+    require_param(nh, "root_link", root_link,
+        "The link at the root of the compensated chain.");
+    require_param(nh, "tip_link", tip_link,
+        "The link at the tip of the compensated chain.");
+
+    std::vector<double> gravity(3, 0.0);
+    gravity[2] = -9.81;
+    if(nh.hasParam("gravity")) {
+      require_param(nh, "gravity", gravity,
+          "The gravity vector [m/s^2] in the frame of the URDF root link.");
+    }
+
+    // Build the chain
+    unsigned int n_dof;
+    KDL::Chain chain;
+    KDL::Tree tree;
+    urdf::Model urdf_model;
+    if(!kdl_urdf_tools::initialize_kinematics_from_urdf(
+          robot_description, root_link, tip_link,
+          n_dof, chain, tree, urdf_model))
+    {
+      ROS_ERROR("Could not initialize robot kinematics!");
+      return false;
+    }
+
+    // Attach an identified payload to the tip link
+    std::string payload_file;
+    if(nh.getParam("payload_file", payload_file)) {
+      PayloadParameters payload;
+      if(!load_payload(payload_file, payload)) {
+        ROS_ERROR_STREAM("Could not load the payload from \""<<payload_file<<"\".");
+        return false;
+      }
+      if(payload.link != tip_link) {
+        ROS_ERROR_STREAM("The payload in \""<<payload_file<<"\" is attached to "<<payload.link
+            <<", not to the tip link "<<tip_link<<".");
+        return false;
+      }
+
+      const Eigen::Matrix3d &I = payload.inertia;
+      chain.addSegment(KDL::Segment(
+            "payload",
+            KDL::Joint(KDL::Joint::None),
+            KDL::Frame::Identity(),
+            KDL::RigidBodyInertia(
+              payload.mass,
+              KDL::Vector(payload.com.x(), payload.com.y(), payload.com.z()),
+              KDL::RotationalInertia(I(0,0), I(1,1), I(2,2), I(0,1), I(0,2), I(1,2)))));
+
+      ROS_INFO_STREAM("Compensating a payload of "<<payload.mass<<" kg on "<<tip_link<<".");
+    }
+
+    if(!gravity_solver_.init(chain)) {
+      ROS_ERROR_STREAM("Could not build a gravity solver for the chain from "<<root_link<<" to "<<tip_link
+          <<". It must have at most "<<MAX_DOF<<" revolute joints.");
+      return false;
+    }
+
+    // Express gravity in the root link of the chain, which has to be fixed
+    // relative to the root of the URDF
+    KDL::Chain base_chain;
+    if(!tree.getChain(tree.getRootSegment()->first, root_link, base_chain)) {
+      ROS_ERROR_STREAM("Could not find the chain from the URDF root to "<<root_link);
+      return false;
+    }
+    KDL::Frame base_frame = KDL::Frame::Identity();
+    for(unsigned int s=0; s<base_chain.getNrOfSegments(); s++) {
+      if(base_chain.getSegment(s).getJoint().getType() != KDL::Joint::None) {
+        ROS_ERROR_STREAM("Root link "<<root_link<<" must be fixed relative to the URDF root.");
+        return false;
+      }
+      base_frame = base_frame*base_chain.getSegment(s).getFrameToTip();
+    }
+    const KDL::Vector root_gravity = base_frame.M.Inverse(KDL::Vector(gravity[0], gravity[1], gravity[2]));
+    gravity_solver_.setGravity(Eigen::Vector3d(root_gravity.x(), root_gravity.y(), root_gravity.z()));
+
+    // Get the joint handles
+    for(unsigned int s=0; s<chain.getNrOfSegments(); s++) {
+      const KDL::Joint &joint = chain.getSegment(s).getJoint();
+      if(joint.getType() != KDL::Joint::None) {
+        joint_names_.push_back(joint.getName());
+        joint_handles_.push_back(hw->getEffortFeedforwardHandle(joint.getName()));
+      }
+    }
+
+    positions_.setZero(n_dof);
+    efforts_.setZero(n_dof);
+
+    return true;
+  }
+
+  void GravityCompensationController::starting(const ros::Time& time)
+  {
+    efforts_.setZero();
+  }
+
+  void GravityCompensationController::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // The positions of all joints need to be known
+    for(unsigned int j=0; j<joint_handles_.size(); j++) {
+      if(!joint_handles_[j].isCalibrated()) {
+        return;
+      }
+      positions_[j] = joint_handles_[j].getPosition();
+    }
+
+    gravity_solver_.compute(positions_, efforts_);
+
+    for(unsigned int j=0; j<joint_handles_.size(); j++) {
+      joint_handles_[j].addEffort(efforts_[j]);
+    }
+  }
+
+  void GravityCompensationController::stopping(const ros::Time& time)
+  {}
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    GravityCompensationController,
+    barrett_controllers::GravityCompensationController,
+    controller_interface::ControllerBase)
@@ -0,0 +1,281 @@
+
+#include <barrett_controllers/joint_trajectory_controller.h>
+
+#include <terse_roscpp/params.h>
+
+#include <algorithm>
+
+namespace barrett_controllers
+{
+
+  JointTrajectoryController::JointTrajectoryController() :
+    active_(false),
+    segment_(0)
+  {
+
+  }
+
+  bool JointTrajectoryController::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    // Only the effort interface claims the joints, the calibrated state is
+    // read-only
+    barrett_model::EffortFeedforwardInterface *state_interface =
+      robot_hw->get<barrett_model::EffortFeedforwardInterface>();
+    if(!state_interface) {
+      ROS_ERROR("JointTrajectoryController needs an EffortFeedforwardInterface to read the calibrated state of the joints.");
+      return false;
+    }
+
+    if(!controller_interface::Controller<hardware_interface::EffortJointInterface>::initRequest(
+          robot_hw, root_nh, controller_nh, claimed_resources))
+    {
+      return false;
+    }
+
+    try {
+      for(size_t j=0; j<joint_names_.size(); j++) {
+        state_handles_.push_back(state_interface->getEffortFeedforwardHandle(joint_names_[j]));
+      }
+    } catch(hardware_interface::HardwareInterfaceException &ex) {
+      ROS_ERROR_STREAM("Could not get the calibrated state of the joints: "<<ex.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool JointTrajectoryController::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    std::vector<double> p_gains, i_gains, d_gains, i_max;
+    int max_points = 256;
+
+    require_param(nh, "joint_names", joint_names_,
+        "The names of the controlled joints.");
+    require_param(nh, "p_gains", p_gains, "PID Proportial gains.");
+    require_param(nh, "i_gains", i_gains, "PID Integral gains.");
+    require_param(nh, "d_gains", d_gains, "PID Derivative gains.");
+    require_param(nh, "i_max", i_max, "PID Integral gain bounds.");
+    if(nh.hasParam("max_points")) {
+      require_param(nh, "max_points", max_points,
+          "The maximum number of waypoints in a trajectory.");
+    }
+
+    const size_t n_joints = joint_names_.size();
+    if(p_gains.size() != n_joints
+        || i_gains.size() != n_joints
+        || d_gains.size() != n_joints
+        || i_max.size() != n_joints)
+    {
+      ROS_ERROR("The PID gains must have one element per joint.");
+      return false;
+    }
+    if(max_points < 1) {
+      ROS_ERROR("A trajectory must be able to hold at least one waypoint.");
+      return false;
+    }
+
+    if(!pids_.resize(n_joints)) {
+      ROS_ERROR_STREAM("JointTrajectoryController can't control more than "<<MAX_JOINTS<<" joints!");
+      return false;
+    }
+    for(size_t j=0; j<n_joints; j++) {
+      pids_.setGains(j, p_gains[j], i_gains[j], d_gains[j], i_max[j], -i_max[j]);
+      joint_handles_.push_back(hw->getHandle(joint_names_[j]));
+    }
+
+    // Allocate both trajectory buffers
+    QuinticTrajectory trajectory;
+    trajectory.configure(n_joints, max_points);
+    trajectories_.initialize(trajectory);
+
+    message_indices_.resize(n_joints);
+    point_positions_.resize(n_joints);
+    point_velocities_.resize(n_joints);
+    point_accelerations_.resize(n_joints);
+
+    desired_positions_.resize(n_joints);
+    desired_velocities_.resize(n_joints);
+    desired_accelerations_.resize(n_joints);
+    efforts_.resize(n_joints);
+
+    command_sub_ = nh.subscribe("command", 1, &JointTrajectoryController::command_cb, this);
+
+    return true;
+  }
+
+  bool JointTrajectoryController::is_calibrated() const
+  {
+    for(size_t j=0; j<state_handles_.size(); j++) {
+      if(state_handles_[j].isCalibrated() != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void JointTrajectoryController::starting(const ros::Time& time)
+  {
+    // The positions are meaningless until all of the joints are calibrated,
+    // so refuse to run until then, the command callback warns about it
+    active_ = this->is_calibrated();
+
+    // Hold the current positions until a trajectory is received
+    for(size_t j=0; j<state_handles_.size(); j++) {
+      desired_positions_[j] = state_handles_[j].getPosition();
+    }
+    trajectories_.front().hold(time.toSec(), &desired_positions_[0]);
+    segment_ = trajectories_.front().first_segment();
+
+    pids_.reset();
+  }
+
+  void JointTrajectoryController::update(const ros::Time& time, const ros::Duration& period)
+  {
+    const double now = time.toSec();
+    const size_t n_joints = joint_handles_.size();
+
+    // The calibration is lost if it's restarted
+    if(active_ && !this->is_calibrated()) {
+      active_ = false;
+    }
+    if(!active_) {
+      if(trajectories_.takePending()) {
+        trajectories_.discard();
+      }
+      for(size_t j=0; j<n_joints; j++) {
+        joint_handles_[j].setCommand(0.0);
+      }
+      return;
+    }
+
+    // Desired state on the current trajectory
+    trajectories_.front().sample(now, segment_,
+        &desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0]);
+
+    // Continue from that state on a new trajectory
+    if(trajectories_.takePending()) {
+      if(trajectories_.back().splice(now,
+            &desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0]))
+      {
+        trajectories_.swap();
+        segment_ = trajectories_.front().first_segment();
+        trajectories_.front().sample(now, segment_,
+            &desired_positions_[0], &desired_velocities_[0], &desired_accelerations_[0]);
+      } else {
+        // The whole trajectory is already in the past
+        trajectories_.discard();
+      }
+    }
+
+    for(size_t j=0; j<n_joints; j++) {
+      pids_.setErrors(j,
+          desired_positions_[j] - state_handles_[j].getPosition(),
+          desired_velocities_[j] - state_handles_[j].getVelocity());
+    }
+    pids_.update(period.toSec(), efforts_);
+
+    for(size_t j=0; j<n_joints; j++) {
+      joint_handles_[j].setCommand(efforts_[j]);
+    }
+  }
+
+  void JointTrajectoryController::stopping(const ros::Time& time)
+  {
+    for(size_t j=0; j<joint_handles_.size(); j++) {
+      joint_handles_[j].setCommand(0.0);
+    }
+  }
+
+  void JointTrajectoryController::command_cb(const trajectory_msgs::JointTrajectoryConstPtr &msg)
+  {
+    const size_t n_joints = joint_names_.size();
+
+    if(!active_) {
+      ROS_WARN_THROTTLE(1.0, "JointTrajectoryController was started before the joints were calibrated, restart it to accept trajectories.");
+      return;
+    }
+
+    // An empty trajectory stops the arm
+    if(msg->points.empty()) {
+      QuinticTrajectory &trajectory = trajectories_.beginWrite();
+      trajectory.clear();
+      trajectories_.endWrite();
+      return;
+    }
+
+    // Find each controlled joint in the message
+    if(msg->joint_names.size() != n_joints) {
+      ROS_ERROR_STREAM("The trajectory has "<<msg->joint_names.size()<<" joints, but "<<n_joints<<" joints are controlled.");
+      return;
+    }
+    for(size_t j=0; j<n_joints; j++) {
+      std::vector<std::string>::const_iterator it =
+        std::find(msg->joint_names.begin(), msg->joint_names.end(), joint_names_[j]);
+      if(it == msg->joint_names.end()) {
+        ROS_ERROR_STREAM("The trajectory does not contain joint "<<joint_names_[j]);
+        return;
+      }
+      message_indices_[j] = it - msg->joint_names.begin();
+    }
+
+    if(msg->points.size() > trajectories_.front().max_points()) {
+      ROS_ERROR_STREAM("The trajectory has "<<msg->points.size()<<" waypoints, but at most "
+          <<trajectories_.front().max_points()<<" are supported.");
+      return;
+    }
+    for(size_t p=0; p<msg->points.size(); p++) {
+      const trajectory_msgs::JointTrajectoryPoint &point = msg->points[p];
+      if(point.positions.size() != n_joints
+          || (!point.velocities.empty() && point.velocities.size() != n_joints)
+          || (!point.accelerations.empty() && point.accelerations.size() != n_joints))
+      {
+        ROS_ERROR_STREAM("Waypoint "<<p<<" must have one position, and optionally one velocity and acceleration, per joint.");
+        return;
+      }
+      if(p > 0 && point.time_from_start <= msg->points[p-1].time_from_start) {
+        ROS_ERROR_STREAM("Waypoint "<<p<<" is not later than the waypoint before it.");
+        return;
+      }
+    }
+
+    // An unstamped trajectory starts now
+    const ros::Time start_time = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
+    if(start_time + msg->points.back().time_from_start <= ros::Time::now()) {
+      ROS_WARN("Ignoring a trajectory which has already ended.");
+      return;
+    }
+
+    QuinticTrajectory &trajectory = trajectories_.beginWrite();
+    trajectory.clear();
+    for(size_t p=0; p<msg->points.size(); p++) {
+      const trajectory_msgs::JointTrajectoryPoint &point = msg->points[p];
+      for(size_t j=0; j<n_joints; j++) {
+        const int m = message_indices_[j];
+        point_positions_[j] = point.positions[m];
+        point_velocities_[j] = point.velocities.empty() ? 0.0 : point.velocities[m];
+        point_accelerations_[j] = point.accelerations.empty() ? 0.0 : point.accelerations[m];
+      }
+      trajectory.addPoint(
+          (start_time + point.time_from_start).toSec(),
+          &point_positions_[0],
+          &point_velocities_[0],
+          &point_accelerations_[0]);
+    }
+    trajectories_.endWrite();
+  }
+
+}
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    JointTrajectoryController,
+    barrett_controllers::JointTrajectoryController,
+    controller_interface::ControllerBase)
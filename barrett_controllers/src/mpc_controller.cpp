@@ -0,0 +1,366 @@
+
+#include <barrett_controllers/mpc_controller.h>
+
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <urdf/model.h>
+
+#include <terse_roscpp/params.h>
+
+#include <algorithm>
+
+namespace barrett_controllers
+{
+
+  template <class Model>
+  MpcController<Model>::MpcController() :
+    active_(false),
+    last_command_seq_(0),
+    step_(0.02),
+    position_weight_(1.0),
+    velocity_weight_(0.05),
+    max_iterations_(100),
+    tolerance_(1E-3),
+    has_previous_(false),
+    publish_rate_(50.0),
+    iterations_(0),
+    solve_time_(0.0),
+    converged_(false),
+    fallback_count_(0),
+    zero_gravity_(0.0, 0.0, 0.0)
+  {
+
+  }
+
+  template <class Model>
+  bool MpcController<Model>::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    // Only the effort interface claims the joints, the calibrated state and
+    // the kinematics are read-only
+    barrett_model::EffortFeedforwardInterface *state_interface =
+      robot_hw->get<barrett_model::EffortFeedforwardInterface>();
+    barrett_model::ArmKinematicsInterface *kinematics_interface =
+      robot_hw->get<barrett_model::ArmKinematicsInterface>();
+    if(!state_interface || !kinematics_interface) {
+      ROS_ERROR("MpcController needs an EffortFeedforwardInterface and an ArmKinematicsInterface to read the calibrated state of the arm.");
+      return false;
+    }
+
+    if(!controller_interface::Controller<hardware_interface::EffortJointInterface>::initRequest(
+          robot_hw, root_nh, controller_nh, claimed_resources))
+    {
+      return false;
+    }
+
+    try {
+      for(int j=0; j<N_DOF; j++) {
+        state_handles_.push_back(state_interface->getEffortFeedforwardHandle(joint_names_[j]));
+      }
+    } catch(hardware_interface::HardwareInterfaceException &ex) {
+      ROS_ERROR_STREAM("Could not get the calibrated state of the joints: "<<ex.what());
+      return false;
+    }
+
+    // Find the arm made of the controlled joints
+    const std::vector<std::string> arm_names = kinematics_interface->getArmNames();
+    for(size_t i=0; i<arm_names.size(); i++) {
+      const barrett_model::ArmKinematicsHandle handle = kinematics_interface->getArmKinematicsHandle(arm_names[i]);
+      if(handle.getJointNames() == joint_names_) {
+        kinematics_handle_ = handle;
+        return true;
+      }
+    }
+
+    ROS_ERROR("No arm in the ArmKinematicsInterface is made of the controlled joints.");
+    return false;
+  }
+
+  template <class Model>
+  bool MpcController<Model>::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    // Get the joints, from root to tip
+    require_param(nh, "joint_names", joint_names_,
+        "The names of the arm's joints, from root to tip.");
+    if(joint_names_.size() != static_cast<size_t>(N_DOF)) {
+      ROS_ERROR_STREAM("MpcController needs "<<N_DOF<<" joints, but "<<joint_names_.size()<<" were given.");
+      return false;
+    }
+
+    // The velocity and effort limits come from the URDF
+    std::string robot_description_param, robot_description;
+    if(!nh.searchParam("robot_description", robot_description_param)) {
+      ROS_ERROR_STREAM("Could not find parameter 'robot_description' above namespace "<<nh.getNamespace());
+      return false;
+    }
+    require_param(nh, robot_description_param, robot_description,
+        "The URDF of the robot.");
+    urdf::Model urdf_model;
+    if(!urdf_model.initString(robot_description)) {
+      ROS_ERROR("Could not parse the URDF.");
+      return false;
+    }
+    for(int j=0; j<N_DOF; j++) {
+      boost::shared_ptr<const urdf::Joint> joint = urdf_model.getJoint(joint_names_[j]);
+      if(!joint || !joint->limits) {
+        ROS_ERROR_STREAM("Joint "<<joint_names_[j]<<" has no limits in the URDF.");
+        return false;
+      }
+      velocity_limits_[j] = joint->limits->velocity;
+      effort_limits_[j] = joint->limits->effort;
+    }
+
+    std::vector<double> acceleration_limits;
+    require_param(nh, "acceleration_limits", acceleration_limits,
+        "The largest acceleration [rad/s^2] of each joint.");
+    if(acceleration_limits.size() != joint_names_.size()) {
+      ROS_ERROR("The acceleration limits must have one element per joint.");
+      return false;
+    }
+    for(int j=0; j<N_DOF; j++) {
+      acceleration_limits_[j] = acceleration_limits[j];
+    }
+
+    // Problem
+    double acceleration_weight = 1E-4, rho = 10.0;
+    nh.getParam("step", step_);
+    nh.getParam("position_weight", position_weight_);
+    nh.getParam("velocity_weight", velocity_weight_);
+    nh.getParam("acceleration_weight", acceleration_weight);
+    nh.getParam("max_iterations", max_iterations_);
+    nh.getParam("tolerance", tolerance_);
+    nh.getParam("rho", rho);
+    nh.getParam("publish_rate", publish_rate_);
+    if(step_ <= 0.0 || max_iterations_ < 1) {
+      ROS_ERROR("The step must be positive, and at least one iteration must be allowed.");
+      return false;
+    }
+
+    problem_.setup(step_, position_weight_, velocity_weight_, acceleration_weight);
+    solver_.setup(problem_.getHessian(), problem_.getConstraints(), rho);
+
+    // Get the joint handles
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_.push_back(hw->getHandle(joint_names_[j]));
+    }
+
+    zero_.setZero();
+    goal_.setZero();
+
+    // Allocate the state message
+    state_pub_.reset(
+        new realtime_tools::RealtimePublisher<barrett_control_msgs::MpcState>(
+          nh, "mpc_state", 4));
+    state_pub_->msg_.name = joint_names_;
+    state_pub_->msg_.goal.assign(N_DOF, 0.0);
+    state_pub_->msg_.position.assign(N_DOF, 0.0);
+    state_pub_->msg_.effort.assign(N_DOF, 0.0);
+
+    // Initialize the command buffer, no command has been received yet
+    command_buffer_.writeFromNonRT(Command());
+
+    command_sub_ = nh.subscribe("command", 1, &MpcController<Model>::command_cb, this);
+
+    return true;
+  }
+
+  template <class Model>
+  bool MpcController<Model>::is_calibrated() const
+  {
+    for(int j=0; j<N_DOF; j++) {
+      if(state_handles_[j].isCalibrated() != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class Model>
+  void MpcController<Model>::starting(const ros::Time& time)
+  {
+    // The dynamics are meaningless until all of the joints are calibrated,
+    // so refuse to run until then, the command callback warns about it
+    active_ = this->is_calibrated();
+
+    // Hold the current positions until a command is received
+    for(int j=0; j<N_DOF; j++) {
+      goal_[j] = state_handles_[j].getPosition();
+    }
+
+    // Start the solver from rest
+    accelerations_.setZero();
+    constraint_values_.setZero();
+    duals_.setZero();
+    has_previous_ = false;
+    fallback_count_ = 0;
+
+    last_publish_time_ = time;
+
+    // Ignore commands which were received before the controller started
+    last_command_seq_ = command_buffer_.readFromRT()->seq;
+  }
+
+  template <class Model>
+  void MpcController<Model>::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // The calibration is lost if it's restarted
+    if(active_ && !this->is_calibrated()) {
+      active_ = false;
+    }
+    if(!active_) {
+      last_command_seq_ = command_buffer_.readFromRT()->seq;
+      for(int j=0; j<N_DOF; j++) {
+        joint_handles_[j].setCommand(0.0);
+      }
+      return;
+    }
+
+    // Apply a new command
+    const Command &command = *(command_buffer_.readFromRT());
+    if(command.seq != last_command_seq_) {
+      goal_ = command.goal;
+      last_command_seq_ = command.seq;
+    }
+
+    for(int j=0; j<N_DOF; j++) {
+      positions_[j] = state_handles_[j].getPosition();
+      velocities_[j] = state_handles_[j].getVelocity();
+    }
+
+    // The accelerations which can be reached within the effort limits,
+    // neglecting the coupling between the joints. The gravity torques are
+    // shared with the other controllers of the arm.
+    Model::mass_matrix(positions_, mass_);
+    Model::inverse_dynamics(positions_, velocities_, zero_, zero_gravity_, bias_);
+    bias_ += kinematics_handle_.getGravity();
+    for(int j=0; j<N_DOF; j++) {
+      upper_accelerations_[j] = std::max(0.0, std::min(acceleration_limits_[j],
+            (effort_limits_[j] - bias_[j])/mass_(j,j)));
+      lower_accelerations_[j] = std::min(0.0, std::max(-acceleration_limits_[j],
+            (-effort_limits_[j] - bias_[j])/mass_(j,j)));
+    }
+
+    // Costs and bounds of each joint's problem
+    for(int j=0; j<N_DOF; j++) {
+      problem_.computeCost(positions_[j] - goal_[j], velocities_[j], joint_cost_);
+      problem_.computeBounds(
+          velocities_[j], velocity_limits_[j],
+          lower_accelerations_[j], upper_accelerations_[j],
+          joint_lower_, joint_upper_);
+      linear_cost_.col(j) = joint_cost_;
+      lower_.col(j) = joint_lower_;
+      upper_.col(j) = joint_upper_;
+    }
+
+    // Solve from the last solution. If it doesn't converge, the next solve
+    // continues from where this one stopped.
+    const ros::WallTime solve_start_time = ros::WallTime::now();
+    converged_ = solver_.solve(
+        linear_cost_, lower_, upper_,
+        accelerations_, constraint_values_, duals_,
+        max_iterations_, tolerance_, iterations_);
+    solve_time_ = (ros::WallTime::now() - solve_start_time).toSec();
+
+    if(converged_) {
+      accelerations_cmd_ = accelerations_.row(0).transpose();
+      previous_accelerations_ = accelerations_;
+      previous_time_ = time;
+      has_previous_ = true;
+    } else {
+      fallback_count_++;
+
+      // Follow the previous solution, or brake when it has run out
+      const int k = has_previous_ ? static_cast<int>((time - previous_time_).toSec()/step_) : HORIZON;
+      if(k < HORIZON) {
+        accelerations_cmd_ = previous_accelerations_.row(k).transpose();
+      } else {
+        accelerations_cmd_ = -velocities_/step_;
+      }
+      accelerations_cmd_ = accelerations_cmd_.cwiseMax(lower_accelerations_).cwiseMin(upper_accelerations_);
+    }
+
+    // Computed torque
+    efforts_.noalias() = mass_*accelerations_cmd_;
+    efforts_ += bias_;
+    efforts_ = efforts_.cwiseMax(-effort_limits_).cwiseMin(effort_limits_);
+
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(efforts_[j]);
+    }
+
+    if(publish_rate_ > 0.0
+        && (time - last_publish_time_).toSec() >= 1.0/publish_rate_
+        && state_pub_->trylock())
+    {
+      barrett_control_msgs::MpcState &msg = state_pub_->msg_;
+      msg.header.stamp = time;
+      for(int j=0; j<N_DOF; j++) {
+        msg.goal[j] = goal_[j];
+        msg.position[j] = positions_[j];
+        msg.effort[j] = efforts_[j];
+      }
+      msg.iterations = iterations_;
+      msg.solve_time = solve_time_;
+      msg.converged = converged_;
+      msg.fallback_count = fallback_count_;
+      state_pub_->unlockAndPublish();
+      last_publish_time_ = time;
+    }
+  }
+
+  template <class Model>
+  void MpcController<Model>::stopping(const ros::Time& time)
+  {
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(0.0);
+    }
+  }
+
+  template <class Model>
+  void MpcController<Model>::command_cb(
+      const barrett_control_msgs::JointCommandConstPtr &msg)
+  {
+    if(msg->command.size() != joint_names_.size()) {
+      ROS_ERROR_STREAM("The command has "<<msg->command.size()<<" elements, but "<<joint_names_.size()<<" joints are controlled.");
+      return;
+    }
+    if(!active_) {
+      ROS_WARN_THROTTLE(1.0, "MpcController was started before the arm was calibrated, restart it to accept commands.");
+    }
+
+    Command command;
+    for(int j=0; j<N_DOF; j++) {
+      command.goal[j] = msg->command[j];
+    }
+
+    command.seq = command_buffer_.readFromNonRT()->seq + 1;
+    command_buffer_.writeFromNonRT(command);
+  }
+
+  template class MpcController<barrett_model::Wam4DofModel>;
+  template class MpcController<barrett_model::Wam7DofModel>;
+
+  typedef MpcController<barrett_model::Wam4DofModel> Wam4DofMpcController;
+  typedef MpcController<barrett_model::Wam7DofModel> Wam7DofMpcController;
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam4DofMpcController,
+    barrett_controllers::Wam4DofMpcController,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam7DofMpcController,
+    barrett_controllers::Wam7DofMpcController,
+    controller_interface::ControllerBase)
@@ -0,0 +1,101 @@
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include <barrett_controllers/payload_file.h>
+
+namespace barrett_controllers {
+
+  bool save_payload(
+      const std::string &path,
+      const PayloadParameters &payload)
+  {
+    const std::string tmp_path = path + ".tmp";
+
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if(file == NULL) {
+      ROS_ERROR_STREAM("Could not open payload file \""<<tmp_path<<"\" for writing.");
+      return false;
+    }
+
+    const Eigen::Matrix3d &I = payload.inertia;
+    bool ok = fprintf(file, "# link link_name\n"
+        "# mass mass\n"
+        "# com x y z\n"
+        "# inertia xx xy xz yy yz zz\n") > 0;
+    ok = ok && fprintf(file, "link %s\n", payload.link.c_str()) > 0;
+    ok = ok && fprintf(file, "mass %.17g\n", payload.mass) > 0;
+    ok = ok && fprintf(file, "com %.17g %.17g %.17g\n",
+        payload.com.x(), payload.com.y(), payload.com.z()) > 0;
+    ok = ok && fprintf(file, "inertia %.17g %.17g %.17g %.17g %.17g %.17g\n",
+        I(0,0), I(0,1), I(0,2), I(1,1), I(1,2), I(2,2)) > 0;
+
+    // Make sure the data is on disk before it replaces the old file
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+      ROS_ERROR_STREAM("Could not write payload file \""<<path<<"\".");
+      unlink(tmp_path.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool load_payload(
+      const std::string &path,
+      PayloadParameters &payload)
+  {
+    std::ifstream file(path.c_str());
+    if(!file.is_open()) {
+      return false;
+    }
+
+    payload = PayloadParameters();
+
+    std::string line;
+    while(std::getline(file, line)) {
+      if(line.empty() || line[0] == '#') {
+        continue;
+      }
+
+      std::istringstream iss(line);
+      std::string key;
+      bool ok = static_cast<bool>(iss >> key);
+
+      if(key == "link") {
+        ok = ok && (iss >> payload.link);
+      } else if(key == "mass") {
+        ok = ok && (iss >> payload.mass);
+      } else if(key == "com") {
+        ok = ok && (iss >> payload.com.x() >> payload.com.y() >> payload.com.z());
+      } else if(key == "inertia") {
+        double xx, xy, xz, yy, yz, zz;
+        ok = ok && (iss >> xx >> xy >> xz >> yy >> yz >> zz);
+        payload.inertia <<
+          xx, xy, xz,
+          xy, yy, yz,
+          xz, yz, zz;
+      } else if(key == "friction") {
+        // Older files also have the identified joint friction, which isn't
+        // used by anything
+      } else {
+        ok = false;
+      }
+
+      if(!ok) {
+        ROS_ERROR_STREAM("Malformed line in payload file \""<<path<<"\": "<<line);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+}
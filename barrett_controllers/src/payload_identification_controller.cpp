@@ -0,0 +1,279 @@
+
+#include <barrett_controllers/payload_identification_controller.h>
+
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <terse_roscpp/params.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace barrett_controllers
+{
+
+  template <class Model>
+  PayloadIdentificationController<Model>::PayloadIdentificationController() :
+    active_(false),
+    ramp_duration_(5.0)
+  {
+
+  }
+
+  template <class Model>
+  bool PayloadIdentificationController<Model>::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    // Only the effort interface claims the joints, the calibrated state is
+    // read-only
+    barrett_model::EffortFeedforwardInterface *state_interface =
+      robot_hw->get<barrett_model::EffortFeedforwardInterface>();
+    if(!state_interface) {
+      ROS_ERROR("PayloadIdentificationController needs an EffortFeedforwardInterface to read the calibrated state of the arm.");
+      return false;
+    }
+
+    if(!controller_interface::Controller<hardware_interface::EffortJointInterface>::initRequest(
+          robot_hw, root_nh, controller_nh, claimed_resources))
+    {
+      return false;
+    }
+
+    try {
+      for(int j=0; j<N_DOF; j++) {
+        state_handles_.push_back(state_interface->getEffortFeedforwardHandle(joint_names_[j]));
+      }
+    } catch(hardware_interface::HardwareInterfaceException &ex) {
+      ROS_ERROR_STREAM("Could not get the calibrated state of the joints: "<<ex.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  template <class Model>
+  bool PayloadIdentificationController<Model>::init(
+      hardware_interface::EffortJointInterface* hw,
+      ros::NodeHandle &nh)
+  {
+    using namespace terse_roscpp;
+
+    // Get the joints, from root to tip
+    require_param(nh, "joint_names", joint_names_,
+        "The names of the arm's joints, from root to tip.");
+    if(joint_names_.size() != static_cast<size_t>(N_DOF)) {
+      ROS_ERROR_STREAM("PayloadIdentificationController needs "<<N_DOF<<" joints, but "<<joint_names_.size()<<" were given.");
+      return false;
+    }
+
+    std::vector<double> p_gains, i_gains, d_gains, i_max, center, amplitudes, frequencies, phases;
+    require_param(nh, "p_gains", p_gains, "PID Proportial gains.");
+    require_param(nh, "i_gains", i_gains, "PID Integral gains.");
+    require_param(nh, "d_gains", d_gains, "PID Derivative gains.");
+    require_param(nh, "i_max", i_max, "PID Integral gain bounds.");
+    require_param(nh, "excitation_center", center,
+        "The posture [rad] about which the joints are excited.");
+    require_param(nh, "excitation_amplitudes", amplitudes,
+        "The amplitude [rad] of each joint's excitation.");
+    require_param(nh, "excitation_frequencies", frequencies,
+        "The frequency [Hz] of each joint's excitation.");
+    if(nh.hasParam("excitation_phases")) {
+      require_param(nh, "excitation_phases", phases,
+          "The phase [rad] of each joint's excitation.");
+    } else {
+      phases.assign(N_DOF, 0.0);
+    }
+    if(nh.hasParam("ramp_duration")) {
+      require_param(nh, "ramp_duration", ramp_duration_,
+          "The time [s] over which the excitation is ramped up.");
+    }
+    require_param(nh, "payload_file", payload_file_,
+        "The file the identified parameters are saved to.");
+
+    if(p_gains.size() != joint_names_.size()
+        || i_gains.size() != joint_names_.size()
+        || d_gains.size() != joint_names_.size()
+        || i_max.size() != joint_names_.size()
+        || center.size() != joint_names_.size()
+        || amplitudes.size() != joint_names_.size()
+        || frequencies.size() != joint_names_.size()
+        || phases.size() != joint_names_.size())
+    {
+      ROS_ERROR("The gains and the excitation must have one element per joint.");
+      return false;
+    }
+
+    // Estimator
+    std::vector<double> gravity(3, 0.0);
+    gravity[2] = -9.81;
+    if(nh.hasParam("gravity")) {
+      require_param(nh, "gravity", gravity,
+          "The gravity vector [m/s^2] in the frame of the arm's root link.");
+    }
+    if(gravity.size() != 3) {
+      ROS_ERROR("The gravity vector must have three elements.");
+      return false;
+    }
+    estimator_.setGravityVector(Eigen::Vector3d(gravity[0], gravity[1], gravity[2]));
+
+    double forgetting_factor, filter_cutoff, coulomb_velocity;
+    if(nh.getParam("forgetting_factor", forgetting_factor)) {
+      estimator_.setForgettingFactor(forgetting_factor);
+    }
+    if(nh.getParam("filter_cutoff", filter_cutoff)) {
+      estimator_.setFilterCutoff(filter_cutoff);
+    }
+    if(nh.getParam("coulomb_velocity", coulomb_velocity)) {
+      estimator_.setCoulombVelocity(coulomb_velocity);
+    }
+
+    pids_.resize(N_DOF);
+    for(int j=0; j<N_DOF; j++) {
+      pids_.setGains(j, p_gains[j], i_gains[j], d_gains[j], i_max[j], -i_max[j]);
+      center_[j] = center[j];
+      amplitudes_[j] = amplitudes[j];
+      frequencies_[j] = 2.0*M_PI*frequencies[j];
+      phases_[j] = phases[j];
+      joint_handles_.push_back(hw->getHandle(joint_names_[j]));
+    }
+
+    // Allocate the snapshot
+    payload_snapshot_.link = Model::tip_link();
+    efforts_.assign(N_DOF, 0.0);
+
+    save_srv_ = nh.advertiseService("save", &PayloadIdentificationController<Model>::save_srv_cb, this);
+
+    return true;
+  }
+
+  template <class Model>
+  bool PayloadIdentificationController<Model>::is_calibrated() const
+  {
+    for(int j=0; j<N_DOF; j++) {
+      if(state_handles_[j].isCalibrated() != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class Model>
+  void PayloadIdentificationController<Model>::starting(const ros::Time& time)
+  {
+    // The dynamics are meaningless until all of the joints are calibrated,
+    // so refuse to run until then, the save service reports it
+    active_ = this->is_calibrated();
+
+    for(int j=0; j<N_DOF; j++) {
+      start_positions_[j] = state_handles_[j].getPosition();
+    }
+    start_time_ = time;
+
+    pids_.reset();
+    estimator_.reset();
+  }
+
+  template <class Model>
+  void PayloadIdentificationController<Model>::update(const ros::Time& time, const ros::Duration& period)
+  {
+    // The calibration is lost if it's restarted
+    if(active_ && !this->is_calibrated()) {
+      active_ = false;
+    }
+    if(!active_) {
+      for(int j=0; j<N_DOF; j++) {
+        joint_handles_[j].setCommand(0.0);
+      }
+      return;
+    }
+
+    const double t = (time - start_time_).toSec();
+
+    // Smoothly move from the start posture to the excitation
+    const double r = std::min(t/ramp_duration_, 1.0);
+    const double ramp = r*r*r*(10.0 - 15.0*r + 6.0*r*r);
+    const double ramp_rate = (r < 1.0) ? 30.0*r*r*(1.0 - r)*(1.0 - r)/ramp_duration_ : 0.0;
+
+    for(int j=0; j<N_DOF; j++) {
+      positions_[j] = state_handles_[j].getPosition();
+      velocities_[j] = state_handles_[j].getVelocity();
+      // The torques applied since the last update
+      applied_efforts_[j] = state_handles_[j].getEffort();
+
+      const double s = std::sin(frequencies_[j]*t + phases_[j]);
+      const double c = std::cos(frequencies_[j]*t + phases_[j]);
+      const double offset = center_[j] - start_positions_[j] + amplitudes_[j]*s;
+      const double setpoint = start_positions_[j] + ramp*offset;
+      const double setpoint_vel = ramp_rate*offset + ramp*amplitudes_[j]*frequencies_[j]*c;
+
+      pids_.setErrors(j, setpoint - positions_[j], setpoint_vel - velocities_[j]);
+    }
+    pids_.update(period.toSec(), efforts_);
+
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(efforts_[j]);
+    }
+
+    estimator_.update(positions_, velocities_, applied_efforts_, period.toSec());
+
+    // Never block the realtime thread, just try again next cycle
+    if(payload_mutex_.try_lock()) {
+      estimator_.getPayload(payload_snapshot_.mass, payload_snapshot_.com, payload_snapshot_.inertia);
+      payload_mutex_.unlock();
+    }
+  }
+
+  template <class Model>
+  void PayloadIdentificationController<Model>::stopping(const ros::Time& time)
+  {
+    for(int j=0; j<N_DOF; j++) {
+      joint_handles_[j].setCommand(0.0);
+    }
+  }
+
+  template <class Model>
+  bool PayloadIdentificationController<Model>::save_srv_cb(
+      std_srvs::Empty::Request &req,
+      std_srvs::Empty::Response &resp)
+  {
+    if(!active_) {
+      ROS_ERROR("PayloadIdentificationController isn't identifying, the arm wasn't calibrated while it ran. Restart it once the arm is calibrated.");
+      return false;
+    }
+
+    PayloadParameters payload;
+    {
+      boost::mutex::scoped_lock lock(payload_mutex_);
+      payload = payload_snapshot_;
+    }
+
+    if(!save_payload(payload_file_, payload)) {
+      return false;
+    }
+
+    ROS_INFO_STREAM("Saved a payload of "<<payload.mass<<" kg on "<<payload.link<<" to \""<<payload_file_<<"\".");
+    return true;
+  }
+
+  template class PayloadIdentificationController<barrett_model::Wam4DofModel>;
+  template class PayloadIdentificationController<barrett_model::Wam7DofModel>;
+
+  typedef PayloadIdentificationController<barrett_model::Wam4DofModel> Wam4DofPayloadIdentificationController;
+  typedef PayloadIdentificationController<barrett_model::Wam7DofModel> Wam7DofPayloadIdentificationController;
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam4DofPayloadIdentificationController,
+    barrett_controllers::Wam4DofPayloadIdentificationController,
+    controller_interface::ControllerBase)
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    Wam7DofPayloadIdentificationController,
+    barrett_controllers::Wam7DofPayloadIdentificationController,
+    controller_interface::ControllerBase)
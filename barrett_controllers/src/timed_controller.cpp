@@ -0,0 +1,152 @@
+#include <barrett_controllers/timed_controller.h>
+
+#include <terse_roscpp/params.h>
+
+namespace barrett_controllers
+{
+
+  TimedController::TimedController() :
+    budget_(0.0),
+    overruns_(0),
+    publish_rate_(1.0)
+  {
+
+  }
+
+  TimedController::~TimedController()
+  {
+    // Destroy the controller before the loader which created it
+    controller_.reset();
+  }
+
+  bool TimedController::initRequest(
+      hardware_interface::RobotHW* robot_hw,
+      ros::NodeHandle &root_nh,
+      ros::NodeHandle &controller_nh,
+      std::set<std::string> &claimed_resources)
+  {
+    using namespace terse_roscpp;
+
+    if(state_ != CONSTRUCTED) {
+      ROS_ERROR("The TimedController can only be initialized once.");
+      return false;
+    }
+
+    int n_bins = 200;
+    double resolution = 5E-6;
+    require_param(controller_nh, "controller_type", controller_type_,
+        "The type of the timed controller.");
+    if(controller_nh.hasParam("timing/bins")) {
+      require_param(controller_nh, "timing/bins", n_bins,
+          "The number of bins of the update duration histogram.");
+    }
+    if(controller_nh.hasParam("timing/resolution")) {
+      require_param(controller_nh, "timing/resolution", resolution,
+          "The width [s] of each bin of the update duration histogram.");
+    }
+    if(controller_nh.hasParam("timing/budget")) {
+      require_param(controller_nh, "timing/budget", budget_,
+          "The update duration [s] above which an update is an overrun, or 0 to not count them.");
+    }
+    if(controller_nh.hasParam("timing/publish_rate")) {
+      require_param(controller_nh, "timing/publish_rate", publish_rate_,
+          "The rate [Hz] at which the update durations are published.");
+    }
+
+    if(n_bins < 1 || resolution <= 0.0) {
+      ROS_ERROR("The histogram needs at least one bin and a positive resolution.");
+      return false;
+    }
+
+    controller_loader_.reset(
+        new pluginlib::ClassLoader<controller_interface::ControllerBase>(
+          "controller_interface", "controller_interface::ControllerBase"));
+
+    try {
+      controller_ = controller_loader_->createInstance(controller_type_);
+    } catch(pluginlib::PluginlibException &ex) {
+      ROS_ERROR_STREAM("Could not load the timed controller of type "<<controller_type_<<": "<<ex.what());
+      return false;
+    }
+
+    // The hosted controller claims the resources
+    if(!controller_->initRequest(robot_hw, root_nh, controller_nh, claimed_resources)) {
+      ROS_ERROR_STREAM("Could not initialize the timed controller of type "<<controller_type_<<".");
+      return false;
+    }
+
+    histogram_.configure(n_bins, resolution);
+
+    // Allocate the timing message
+    timing_pub_.reset(
+        new realtime_tools::RealtimePublisher<barrett_control_msgs::ControllerTiming>(
+          controller_nh, "controller_timing", 4));
+    timing_pub_->msg_.controller_type = controller_type_;
+    timing_pub_->msg_.budget = budget_;
+    timing_pub_->msg_.resolution = resolution;
+    timing_pub_->msg_.histogram.assign(n_bins, 0);
+
+    state_ = INITIALIZED;
+    return true;
+  }
+
+  std::string TimedController::getHardwareInterfaceType() const
+  {
+    return controller_ ? controller_->getHardwareInterfaceType() : std::string();
+  }
+
+  void TimedController::starting(const ros::Time& time)
+  {
+    histogram_.reset();
+    overruns_ = 0;
+    last_publish_time_ = time;
+
+    controller_->startRequest(time);
+  }
+
+  void TimedController::update(const ros::Time& time, const ros::Duration& period)
+  {
+    const ros::WallTime update_start_time = ros::WallTime::now();
+    controller_->updateRequest(time, period);
+    const double duration = (ros::WallTime::now() - update_start_time).toSec();
+
+    histogram_.record(duration);
+    if(budget_ > 0.0 && duration > budget_) {
+      overruns_++;
+    }
+
+    if(publish_rate_ > 0.0
+        && (time - last_publish_time_).toSec() >= 1.0/publish_rate_
+        && timing_pub_->trylock())
+    {
+      barrett_control_msgs::ControllerTiming &msg = timing_pub_->msg_;
+      msg.header.stamp = time;
+      msg.count = histogram_.count();
+      msg.last = histogram_.last();
+      msg.mean = histogram_.mean();
+      msg.max = histogram_.max();
+      msg.p50 = histogram_.percentile(0.5);
+      msg.p90 = histogram_.percentile(0.9);
+      msg.p99 = histogram_.percentile(0.99);
+      msg.overruns = overruns_;
+      for(size_t i=0; i<histogram_.size(); i++) {
+        msg.histogram[i] = histogram_.count(i);
+      }
+      timing_pub_->unlockAndPublish();
+      last_publish_time_ = time;
+    }
+  }
+
+  void TimedController::stopping(const ros::Time& time)
+  {
+    controller_->stopRequest(time);
+  }
+
+}
+
+
+PLUGINLIB_DECLARE_CLASS(
+    barrett_controllers,
+    TimedController,
+    barrett_controllers::TimedController,
+    controller_interface::ControllerBase)
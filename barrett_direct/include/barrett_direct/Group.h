@@ -108,6 +108,9 @@ namespace barrett_direct {
     //! The ID of the group
     Group::ID id;
 
+    //! Skip the replies left from earlier queries
+    bool skipstale;
+
     //! Is the data contain a set property command
     /**
       Pucks have properties that can be read/write. To read/write a property, 
@@ -145,6 +148,13 @@ namespace barrett_direct {
     Group::Errno GetProperty( Barrett::ID id, 
         std::vector<Barrett::Value>& values );
 
+    //! Querry the group, skipping the replies left from earlier queries
+    /**
+      \sa SkipStaleReplies
+      */
+    Group::Errno GetFreshProperty( Barrett::ID id, 
+        std::vector<Barrett::Value>& values );
+
     //! Set the property of a group
     Group::Errno SetProperty( Barrett::ID id, 
         Barrett::Value value,
@@ -197,6 +207,20 @@ namespace barrett_direct {
 
     bool IsEmpty() const { return pucks.empty(); }
 
+    //! Skip the replies left from earlier queries
+    /**
+      A frame can be received twice, e.g. on a faulty bus, and the extra copy
+      is then taken for a reply to the next query. With this set, the frames
+      left on the bus are dropped before each query, by receiving with 
+      MSG_NOBLOCK, and each puck's first reply to the property is kept while
+      its repeated replies and the replies to other properties are skipped.
+      This is off by default. The CAN device must return at once from Recv 
+      with MSG_NOBLOCK, otherwise every query waits for a receive timeout. It
+      has only been tried on the emulated bus of barrett_sim.
+      \param skip True to skip the stale replies
+      */
+    void SkipStaleReplies( bool skip ) { skipstale = skip; }
+
 
     Group::Errno Initialize();
 
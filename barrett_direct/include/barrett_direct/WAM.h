@@ -172,6 +172,15 @@ namespace barrett_direct {
     //! Return the configuration of the WAM (4/7DOF)
     WAM::Configuration GetConfiguration() const { return configuration; }
 
+    //! Skip the replies left from earlier queries in all the groups
+    /**
+      This is off by default. The CAN device must return at once from Recv 
+      with MSG_NOBLOCK.
+      \param skip True to skip the stale replies
+      \sa Group::SkipStaleReplies
+      */
+    void SkipStaleReplies( bool skip );
+
     //! Get joints positions
     /**
       This broadcast a position query to the pucks and process all their replies.
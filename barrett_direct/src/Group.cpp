@@ -61,7 +61,8 @@ Group::ID operator++( Group::ID& gid, int ){
 // default constructor
 Group::Group( Group::ID id, leo_can::CANBus* canbus, bool createfilter ) : 
   canbus( canbus ),
-  id( id ){
+  id( id ),
+  skipstale( false ){
 
     switch( GetID() ){
 
@@ -276,6 +277,9 @@ void Group::AddPuckToGroup( Puck::ID pid ){
 Group::Errno Group::GetProperty( Barrett::ID propid, 
     std::vector<Barrett::Value>& values ){
 
+  if( skipstale )
+  { return GetFreshProperty( propid, values ); }
+
   // pack the query in a CAN frame
   leo_can::CANBusFrame sendframe;
   if( PackProperty( sendframe, Barrett::GET, propid ) != Group::ESUCCESS){
@@ -354,6 +358,95 @@ Group::Errno Group::GetProperty( Barrett::ID propid,
 
 }
 
+// Query a group of puck, skipping the replies left from earlier queries
+Group::Errno Group::GetFreshProperty( Barrett::ID propid, 
+    std::vector<Barrett::Value>& values ){
+
+  // pack the query in a CAN frame
+  leo_can::CANBusFrame sendframe;
+  if( PackProperty( sendframe, Barrett::GET, propid ) != Group::ESUCCESS){
+    std::cerr << "Failed to pack the property" << std::endl;
+    return Group::EFAILURE;
+  }
+
+  // drop the frames left from earlier queries, e.g. duplicated replies, so
+  // they aren't taken for the replies to this one
+  leo_can::CANBusFrame staleframe;
+  while( canbus->Recv( staleframe, leo_can::CANBus::MSG_NOBLOCK ) 
+      == leo_can::CANBus::ESUCCESS ){}
+
+  // send the CAN frame
+  if( canbus->Send( sendframe ) != leo_can::CANBus::ESUCCESS ){
+    std::cerr << ": Failed to querry group" << std::endl;
+    return Group::EFAILURE;
+  }
+
+  values.clear();
+  values.resize( pucks.size() );
+
+  // receive until each puck has replied once, by its ID, so a duplicated
+  // reply can't be taken for the reply of another puck
+  unsigned long replied = 0;
+  size_t nreplies = 0;
+  while( nreplies < pucks.size() ){
+
+    // empty CAN frame
+    leo_can::CANBusFrame recvframe;
+
+    // receive the response in a CAN frame
+    if( canbus->Recv( recvframe ) != leo_can::CANBus::ESUCCESS ){
+      std::cerr << LogPrefix() << "Failed to receive property" 
+        << std::endl;
+      return Group::EFAILURE;
+    }
+
+    // figure which puck send that frame
+    Puck::ID pid = Puck::OriginID( recvframe );
+    int pindex = -1;
+    for( size_t j=0; j<pucks.size(); j++ ){
+      if( pucks[j].GetID() == pid )
+      { pindex = j; }
+    }
+
+    if( pindex < 0 ){
+      std::cerr << LogPrefix() << "Could not index the pucks" 
+        << std::endl;
+      continue;
+    }
+
+    // the puck has already replied, this is a duplicate
+    if( replied & ( 1UL << pindex ) )
+    { continue; }
+
+    Barrett::ID recvpropid;
+    Barrett::Value recvvalue;
+
+    // unpack the frame;
+    if( pucks[pindex].UnpackCANFrame( recvframe, recvpropid, recvvalue ) 
+        != Puck::ESUCCESS){
+      std::cerr << LogPrefix() << "Failed to unpack CAN frame"
+        << std::endl;
+      return Group::EFAILURE;
+    }
+
+    // a reply to an earlier query of another property
+    if( propid != recvpropid ){
+      std::cerr << LogPrefix() << "Unexpected property ID. "
+        << "Expected " << propid << " got " << recvpropid
+        << std::endl;
+      continue;
+    }
+
+    values[ pindex ] = recvvalue;
+    replied |= ( 1UL << pindex );
+    nreplies++;
+
+  }
+
+  return Group::ESUCCESS;
+
+}
+
 
 // Set the properties of a group
 // Unlike devPuck::SetProperty, this doesn't verify the pucks values
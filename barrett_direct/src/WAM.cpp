@@ -62,6 +62,14 @@ WAM::WAM(	leo_can::CANBus* canbus,
 
 WAM::~WAM(){}
 
+void WAM::SkipStaleReplies( bool skip ){
+  broadcast.SkipStaleReplies( skip );
+  uppertorques.SkipStaleReplies( skip );
+  lowertorques.SkipStaleReplies( skip );
+  upperpositions.SkipStaleReplies( skip );
+  lowerpositions.SkipStaleReplies( skip );
+}
+
 WAM::Errno WAM::Initialize(){
 
   // initialize the safety module
@@ -426,7 +434,7 @@ WAM::Errno WAM::SetTorques( const Eigen::VectorXd& jt ){
 
     case WAM::WAM_4DOF:
 
-      if( jt.size() != 4 ){
+      if( jt.size() == 4 ){
         Eigen::VectorXd mt = JointsTrq2MotorsTrq( jt );
 
         Eigen::Vector4d mtu( mt[0], mt[1], mt[2], mt[3] );
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_HW_CALIBRATION_FILE_H
+#define __BARRETT_HW_CALIBRATION_FILE_H
+
+#include <string>
+#include <vector>
+
+namespace barrett_hw {
+
+  //! The calibration of a single joint, as it's stored on disk
+  struct JointCalibration
+  {
+    JointCalibration() :
+      name(""),
+      valid(false),
+      offset(0.0),
+      position(0.0),
+      resolver_angle(0.0)
+    { }
+
+    std::string name;
+    //! False until this joint has been calibrated
+    bool valid;
+    //! The offset from the encoder position to the joint position
+    double offset;
+    //! The encoder position at which the offset was recorded
+    double position;
+    //! The resolver angle at that encoder position
+    double resolver_angle;
+  };
+
+  /** \brief Write the valid joint calibrations to a file
+   *
+   * The calibrations are first written to a temporary file next to \c path,
+   * which is synced to disk and then renamed over \c path, so a crash never
+   * leaves a partially-written calibration file behind.
+   */
+  bool save_calibration(
+      const std::string &path,
+      const std::vector<JointCalibration> &calibrations);
+
+  //! Read joint calibrations written by \ref save_calibration
+  bool load_calibration(
+      const std::string &path,
+      std::vector<JointCalibration> &calibrations);
+
+}
+
+#endif // ifndef __BARRETT_HW_CALIBRATION_FILE_H
@@ -72,14 +72,14 @@ class WamCalibrator(object):
 
         self.calibration_state = barrett_control_msgs.SemiAbsoluteCalibrationState()
 
-    def calibrate(self, calibration_order):
+    def calibrate(self, calibration_order, mode=barrett_control_srvs.CalibrateRequest.LIMIT_SEARCH):
         # Check calibration parameter
         # Get the loaded controllers
 
         for joint_names in calibration_order:
             try:
                 rospy.loginfo("Calibrating joints: " + str(joint_names))
-                self.calibrate_joints(joint_names)
+                self.calibrate_joints(joint_names=joint_names, mode=mode, hint_positions=[])
             except rospy.ServiceException as e:
                 pass
 
@@ -90,6 +90,8 @@ class WamCalibrator(object):
                 all_calibrated = len(self.calibration_state.calibration_state) > 0 and all([s == self.calibration_state.CALIBRATED for n,s in relevant_calibration_states if n in joint_names])
                 rospy.sleep(0.1)
 
+            rospy.loginfo("Calibrated joints in %g seconds." % self.calibration_state.total_calibration_time)
+
         # Set calibrated rosparam
 
 
@@ -108,15 +110,23 @@ def main():
 
     calibrator = WamCalibrator('wam/calibration_controller')
 
-    calibration_order = [
-            ['wam/UpperWristPitchJoint','wam/UpperWristYawJoint','wam/LowerWristYawJoint','wam/ShoulderYawJoint'],
-            ['wam/ElbowJoint'],
-            ['wam/ShoulderPitchJoint'],
-            ['wam/YawJoint']]
+    # The calibration controller sequences the joints according to its
+    # calibration_dependencies parameter, so they can all be requested at once
+    calibration_order = [[
+            'wam/UpperWristPitchJoint','wam/UpperWristYawJoint','wam/LowerWristYawJoint','wam/ShoulderYawJoint',
+            'wam/ElbowJoint',
+            'wam/ShoulderPitchJoint',
+            'wam/YawJoint']]
 
     #calibration_order = [['wam/LowerWristYawJoint']]
     #calibration_order = [['wam/UpperWristPitchJoint','wam/UpperWristYawJoint','wam/LowerWristYawJoint','wam/ShoulderYawJoint']]
-    calibrator.calibrate(calibration_order)
+
+    # With --resolver, calibrate in place from the parked pose, only moving
+    # the joints if their positions are ambiguous
+    if '--resolver' in rospy.myargv():
+        calibrator.calibrate(calibration_order, barrett_control_srvs.CalibrateRequest.RESOLVER)
+    else:
+        calibrator.calibrate(calibration_order)
     
 if __name__ == '__main__':
     main()
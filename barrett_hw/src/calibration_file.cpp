@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include <barrett_hw/calibration_file.h>
+
+namespace barrett_hw {
+
+  bool save_calibration(
+      const std::string &path,
+      const std::vector<JointCalibration> &calibrations)
+  {
+    const std::string tmp_path = path + ".tmp";
+
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if(file == NULL) {
+      ROS_ERROR_STREAM("Could not open calibration file \""<<tmp_path<<"\" for writing.");
+      return false;
+    }
+
+    // One joint per line: name offset position resolver_angle
+    bool ok = fprintf(file, "# joint_name offset encoder_position resolver_angle\n") > 0;
+    for(std::vector<JointCalibration>::const_iterator it = calibrations.begin();
+        it != calibrations.end();
+        ++it)
+    {
+      if(it->valid) {
+        ok = ok && fprintf(file, "%s %.17g %.17g %.17g\n",
+            it->name.c_str(), it->offset, it->position, it->resolver_angle) > 0;
+      }
+    }
+
+    // Make sure the data is on disk before it replaces the old file
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+      ROS_ERROR_STREAM("Could not write calibration file \""<<path<<"\".");
+      unlink(tmp_path.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  bool load_calibration(
+      const std::string &path,
+      std::vector<JointCalibration> &calibrations)
+  {
+    std::ifstream file(path.c_str());
+    if(!file.is_open()) {
+      return false;
+    }
+
+    calibrations.clear();
+
+    std::string line;
+    while(std::getline(file, line)) {
+      if(line.empty() || line[0] == '#') {
+        continue;
+      }
+
+      std::istringstream iss(line);
+      JointCalibration calibration;
+      if(!(iss >> calibration.name >> calibration.offset >> calibration.position >> calibration.resolver_angle)) {
+        ROS_ERROR_STREAM("Malformed line in calibration file \""<<path<<"\": "<<line);
+        return false;
+      }
+      calibration.valid = true;
+      calibrations.push_back(calibration);
+    }
+
+    return true;
+  }
+
+}
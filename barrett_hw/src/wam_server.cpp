@@ -9,6 +9,9 @@
 #include <control_toolbox/filters.h>
 #include <control_toolbox/pid.h>
 #include <std_msgs/Duration.h>
+#include <std_srvs/Empty.h>
+
+#include <boost/thread/mutex.hpp>
 
 #include <hardware_interface/joint_state_interface.h>
 #include <hardware_interface/joint_command_interface.h>
@@ -23,6 +26,16 @@
 #include <barrett/products/product_manager.h>
 
 #include <barrett_model/semi_absolute_joint_interface.h>
+#include <barrett_model/effort_feedforward_interface.h>
+#include <barrett_model/arm_kinematics_interface.h>
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/wam_7dof_model.h>
+#include <barrett_model/momentum_observer.h>
+#include <barrett_model/friction_table.h>
+
+#include <barrett_control_msgs/CollisionState.h>
+
+#include <barrett_hw/calibration_file.h>
 
 #include <terse_roscpp/param.h>
 
@@ -38,6 +51,11 @@ void quitRequested(int sig) {
 
 namespace barrett_hw 
 { 
+  // The generated model of each type of WAM
+  template<size_t DOF> struct WamModel { };
+  template<> struct WamModel<4> { typedef barrett_model::Wam4DofModel Type; };
+  template<> struct WamModel<7> { typedef barrett_model::Wam7DofModel Type; };
+
   class BarrettHW : public hardware_interface::RobotHW 
   {
   public:
@@ -58,6 +76,15 @@ namespace barrett_hw
     void set_mode(
         barrett::SafetyModule::SafetyMode mode);
 
+    // Restore joint calibrations from the calibration file if they still match
+    // the resolvers, and return true if every joint was restored
+    bool restore_calibration();
+
+    // Clear detected collisions at the next read
+    bool reset_collisions_cb(
+        std_srvs::Empty::Request &req,
+        std_srvs::Empty::Response &resp);
+
     // State structure for a Wam
     // This provides storage for the joint handles
     template<size_t DOF>
@@ -76,21 +103,61 @@ namespace barrett_hw
         // State
         Eigen::Matrix<double,DOF,1> 
           joint_positions,
+          joint_calibrated_positions,
           joint_velocities,
           joint_effort_cmds,
+          joint_feedforward_efforts,
+          joint_total_efforts,
           joint_offsets,
           resolver_angles,
           calibration_burn_offsets;
 
         Eigen::Matrix<int,DOF,1> calibrated_joints;
 
+        // Whether the calibration offsets have been burned into the encoders,
+        // which is checked every other write
+        bool calibration_burned;
+        int calibration_decimate;
+
+        // Kinematics, computed at most once per cycle
+        boost::shared_ptr<barrett_model::ArmKinematics> kinematics;
+
+        // Collision detection, disabled if there's no observer
+        boost::shared_ptr<barrett_model::MomentumObserver<typename WamModel<DOF>::Type> > collision_observer;
+        boost::shared_ptr<realtime_tools::RealtimePublisher<barrett_control_msgs::CollisionState> > collision_pub;
+        bool in_collision;
+        double collision_observer_duration;
+        ros::Time last_collision_publish_time;
+
+        // Friction compensation, disabled if there are no tables. Joints
+        // without a table have an empty one, which computes zero friction.
+        std::vector<barrett_model::FrictionTable> friction_tables;
+
+        // Calibration persistence
+        size_t calibration_index;
+        Eigen::Matrix<double,DOF,1> saved_offsets;
+        Eigen::Matrix<int,DOF,1> saved_calibrated_joints;
+
         void set_zero() {
           joint_positions.setZero();
+          joint_calibrated_positions.setZero();
           joint_velocities.setZero();
           joint_effort_cmds.setZero();
+          joint_feedforward_efforts.setZero();
+          joint_total_efforts.setZero();
           joint_offsets.setZero();
           resolver_angles.setZero();
           calibration_burn_offsets.setZero();
+          calibrated_joints.setZero();
+          calibration_burned = false;
+          calibration_decimate = 0;
+          saved_offsets.setZero();
+          saved_calibrated_joints.setZero();
+          in_collision = false;
+          collision_observer_duration = 0.0;
+          if(collision_observer) {
+            collision_observer->reset();
+          }
         }
 
       };
@@ -130,15 +197,32 @@ namespace barrett_hw
     // State
     ros::NodeHandle nh_;
     bool configured_;
-    bool calibrated_;
 
     // Configuration
     urdf::Model urdf_model_;
+    std::string calibration_file_;
+    double calibration_tolerance_;
+    Eigen::Vector3d gravity_;
+    double collision_publish_rate_;
+
+    // Calibration persistence
+    // The realtime thread snapshots the calibration under a try-lock and the
+    // timer callback writes it to disk
+    boost::mutex calibration_mutex_;
+    std::vector<JointCalibration> calibration_snapshot_;
+    bool calibration_dirty_;
+    ros::Timer calibration_timer_;
+
+    // Collision detection
+    volatile bool collision_reset_requested_;
+    ros::ServiceServer reset_collisions_srv_;
 
     // ros-controls interface
     hardware_interface::JointStateInterface state_interface_;
     hardware_interface::EffortJointInterface effort_interface_;
     barrett_model::SemiAbsoluteJointInterface semi_absolute_interface_;
+    barrett_model::EffortFeedforwardInterface feedforward_interface_;
+    barrett_model::ArmKinematicsInterface kinematics_interface_;
 
     // Vectors of various barrett structures
     ManagerMap barrett_managers_;
@@ -159,6 +243,29 @@ namespace barrett_hw
           boost::shared_ptr<barrett::ProductManager> barrett_manager, 
           const libconfig::Setting &wam_config); 
 
+    template <size_t DOF>
+      bool
+      configure_wam_kinematics(
+          const std::string &product_name,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    template <size_t DOF>
+      void
+      configure_wam_collision_detection(
+          const std::string &product_name,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    template <size_t DOF>
+      bool
+      configure_wam_friction_compensation(
+          const std::string &product_name,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    // Express the gravity vector in the frame of a link
+    bool link_gravity(
+        const std::string &link_name,
+        Eigen::Vector3d &gravity);
+
     template <size_t DOF>
       bool
       read_wam(
@@ -166,20 +273,44 @@ namespace barrett_hw
           const ros::Duration period,
           boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
 
+    template <size_t DOF>
+      void
+      detect_wam_collisions(
+          const ros::Time time, 
+          const ros::Duration period,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
     template <size_t DOF>
       void 
       write_wam(
           const ros::Time time, 
           const ros::Duration period,
           boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    template <size_t DOF>
+      void
+      snapshot_wam_calibration(
+          const Eigen::Matrix<double,DOF,1> &raw_positions,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    template <size_t DOF>
+      size_t
+      restore_wam_calibration(
+          const std::vector<JointCalibration> &calibrations,
+          boost::shared_ptr<BarrettHW::WamDevice<DOF> > device);
+
+    void save_calibration_cb(const ros::TimerEvent &event);
   };
 
   BarrettHW::BarrettHW(ros::NodeHandle nh) :
     nh_(nh),
     configured_(false),
-    calibrated_(false)
+    calibration_tolerance_(0.02),
+    gravity_(0.0, 0.0, -9.81),
+    collision_publish_rate_(50.0),
+    calibration_dirty_(false),
+    collision_reset_requested_(false)
   {
-    // TODO: Determine pre-existing calibration from ROS parameter server
   }
 
   bool BarrettHW::configure() 
@@ -194,6 +325,17 @@ namespace barrett_hw
 
     // Load parameters
     param::require(nh_,"product_names",product_names, "The unique barrett product names.");
+    param::get(nh_,"calibration_file",calibration_file_, "File used to persist joint calibrations across restarts.");
+    param::get(nh_,"calibration_tolerance",calibration_tolerance_, "Maximum resolver disagreement [rad] for a stored calibration to be restored.");
+    std::vector<double> gravity;
+    if(param::get(nh_,"gravity",gravity, "The gravity vector [m/s^2] in the frame of the URDF root link.")) {
+      if(gravity.size() != 3) {
+        ROS_ERROR("The gravity vector must have three elements.");
+        return false;
+      }
+      gravity_ = Eigen::Vector3d(gravity[0], gravity[1], gravity[2]);
+    }
+    param::get(nh_,"collision_publish_rate",collision_publish_rate_, "The rate [Hz] at which the collision state of each arm is published.");
 
     for(std::vector<std::string>::const_iterator it = product_names.begin();
         it != product_names.end();
@@ -241,8 +383,20 @@ namespace barrett_hw
         // Construct and store the wam interface
         if(barrett_manager->foundWam4()) { 
           wam4s_[product_name] = this->configure_wam<4>(product_nh, barrett_manager, wam_config);
+          if(!this->configure_wam_friction_compensation<4>(product_name, wam4s_[product_name])) {
+            return false;
+          }
+          if(this->configure_wam_kinematics<4>(product_name, wam4s_[product_name])) {
+            this->configure_wam_collision_detection<4>(product_name, wam4s_[product_name]);
+          }
         } else if(barrett_manager->foundWam7()) {
           wam7s_[product_name] = this->configure_wam<7>(product_nh, barrett_manager, wam_config);
+          if(!this->configure_wam_friction_compensation<7>(product_name, wam7s_[product_name])) {
+            return false;
+          }
+          if(this->configure_wam_kinematics<7>(product_name, wam7s_[product_name])) {
+            this->configure_wam_collision_detection<7>(product_name, wam7s_[product_name]);
+          }
         } else {
           ROS_ERROR("Could not find WAM on bus!"); 
           continue; 
@@ -256,13 +410,38 @@ namespace barrett_hw
       }
     }
 
-    // TODO: Set up gravity compensator
-    // Write kdl_ros_integration package which handles kdl/urdf/ros_control? interfaces
+    // Allocate the calibration snapshot so the realtime thread can fill it in place
+    calibration_snapshot_.clear();
+    for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+      it->second->calibration_index = calibration_snapshot_.size();
+      calibration_snapshot_.resize(calibration_snapshot_.size() + 4);
+      for(size_t i=0; i<4; i++) {
+        calibration_snapshot_[it->second->calibration_index + i].name = it->second->joint_names[i];
+      }
+    }
+    for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+      it->second->calibration_index = calibration_snapshot_.size();
+      calibration_snapshot_.resize(calibration_snapshot_.size() + 7);
+      for(size_t i=0; i<7; i++) {
+        calibration_snapshot_[it->second->calibration_index + i].name = it->second->joint_names[i];
+      }
+    }
+    calibration_dirty_ = false;
+
+    if(!calibration_file_.empty()) {
+      calibration_timer_ = nh_.createTimer(ros::Duration(1.0), &BarrettHW::save_calibration_cb, this);
+    }
+
+    reset_collisions_srv_ = nh_.advertiseService("reset_collisions", &BarrettHW::reset_collisions_cb, this);
 
     // Register ros-controls interfaces
+    // Gravity compensation is provided by controllers using the feedforward
+    // interface
     this->registerInterface(&state_interface_);
     this->registerInterface(&effort_interface_);
     this->registerInterface(&semi_absolute_interface_);
+    this->registerInterface(&feedforward_interface_);
+    this->registerInterface(&kinematics_interface_);
 
     // Set configured flag
     configured_ = true;
@@ -336,7 +515,7 @@ namespace barrett_hw
         hardware_interface::JointStateHandle state_handle(joint->name,
             &wam_device->joint_positions(i),
             &wam_device->joint_velocities(i),
-            &wam_device->joint_effort_cmds(i));
+            &wam_device->joint_total_efforts(i));
         state_interface_.registerHandle(state_handle);
 
         // Effort Command Handle
@@ -353,11 +532,172 @@ namespace barrett_hw
             &wam_device->joint_offsets(i),
             &wam_device->calibrated_joints(i));
 
+        // Feedforward effort handle, in calibrated coordinates
+        feedforward_interface_.registerJoint(
+            hardware_interface::JointStateHandle(joint->name,
+              &wam_device->joint_calibrated_positions(i),
+              &wam_device->joint_velocities(i),
+              &wam_device->joint_total_efforts(i)),
+            &wam_device->joint_feedforward_efforts(i),
+            &wam_device->calibrated_joints(i),
+            &wam_device->in_collision);
       }
 
       return wam_device;
     }
 
+  template<size_t DOF>
+    bool BarrettHW::configure_wam_kinematics(
+        const std::string &product_name,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      typedef typename WamModel<DOF>::Type Model;
+
+      // The generated model has to describe the same joints, regardless of
+      // their prefix
+      for(size_t i=0; i<DOF; i++) {
+        const std::string &joint_name = device->joint_names[i];
+        const std::string model_joint_name = Model::joint_name(i);
+        const std::string suffix = model_joint_name.substr(model_joint_name.rfind('/') + 1);
+        if(joint_name.size() < suffix.size() 
+            || joint_name.compare(joint_name.size() - suffix.size(), suffix.size(), suffix) != 0) 
+        {
+          ROS_WARN_STREAM("Joint \""<<joint_name<<"\" of "<<product_name<<" does not match joint \""
+              <<model_joint_name<<"\" of the "<<DOF<<"-DOF WAM model, its kinematics will not be available.");
+          return false;
+        }
+      }
+
+      // The model is expressed in the frame of the parent of the first joint
+      boost::shared_ptr<const urdf::Joint> root_joint = urdf_model_.getJoint(device->joint_names[0]);
+      Eigen::Vector3d gravity;
+      if(!root_joint || !this->link_gravity(root_joint->parent_link_name, gravity)) {
+        ROS_WARN_STREAM("Could not find the gravity vector for "<<product_name<<", its kinematics will not be available.");
+        return false;
+      }
+
+      device->kinematics.reset(
+          new barrett_model::ModelArmKinematics<Model>(device->joint_calibrated_positions.data()));
+      device->kinematics->setGravityVector(gravity);
+
+      kinematics_interface_.registerArm(
+          barrett_model::ArmKinematicsHandle(
+            product_name,
+            device->joint_names,
+            device->kinematics.get(),
+            device->calibrated_joints.data()));
+
+      return true;
+    }
+
+  template<size_t DOF>
+    void BarrettHW::configure_wam_collision_detection(
+        const std::string &product_name,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      using namespace terse_roscpp;
+      typedef typename WamModel<DOF>::Type Model;
+
+      ros::NodeHandle product_nh(nh_,"products/"+product_name);
+
+      // Collision detection is only enabled if thresholds are given
+      std::vector<double> thresholds, gains;
+      if(!param::get(product_nh,"collision_thresholds",thresholds, "Estimated external torque [Nm] above which each joint is in collision.")) {
+        return;
+      }
+      if(!param::get(product_nh,"collision_gains",gains, "Collision observer gain [1/s] of each joint.")) {
+        gains.assign(DOF, 50.0);
+      }
+      if(thresholds.size() != DOF || gains.size() != DOF) {
+        ROS_ERROR_STREAM("The collision thresholds and gains of "<<product_name<<" must have "<<DOF<<" elements, collision detection is disabled.");
+        return;
+      }
+      double onset_fraction = 0.5;
+      param::get(product_nh,"collision_onset_fraction",onset_fraction, "Fraction of the collision thresholds at which latency measurements start.");
+
+      device->collision_observer.reset(new barrett_model::MomentumObserver<Model>());
+      device->collision_observer->setGravityVector(device->kinematics->getGravityVector());
+      device->collision_observer->setThresholds(Eigen::Map<const Eigen::Matrix<double,DOF,1> >(&thresholds[0]));
+      device->collision_observer->setGains(Eigen::Map<const Eigen::Matrix<double,DOF,1> >(&gains[0]));
+      device->collision_observer->setOnsetFraction(onset_fraction);
+
+      // Allocate the collision state message
+      device->collision_pub.reset(
+          new realtime_tools::RealtimePublisher<barrett_control_msgs::CollisionState>(
+            product_nh, "collision_state", 4));
+      device->collision_pub->msg_.name = device->joint_names;
+      device->collision_pub->msg_.residual.assign(DOF, 0.0);
+      device->collision_pub->msg_.threshold = thresholds;
+    }
+
+  template<size_t DOF>
+    bool BarrettHW::configure_wam_friction_compensation(
+        const std::string &product_name,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      using namespace terse_roscpp;
+
+      ros::NodeHandle product_nh(nh_,"products/"+product_name);
+
+      // Friction compensation is only enabled if a file is given
+      std::string friction_file;
+      if(!param::get(product_nh,"friction_file",friction_file, "File of friction lookup tables written by identify_friction.py.")) {
+        return true;
+      }
+      double friction_scale = 1.0;
+      param::get(product_nh,"friction_scale",friction_scale, "Fraction of the identified friction which is compensated.");
+
+      std::vector<barrett_model::FrictionTable> tables;
+      if(!barrett_model::load_friction_tables(friction_file, tables)) {
+        ROS_ERROR_STREAM("Could not load the friction tables of "<<product_name<<" from \""<<friction_file<<"\".");
+        return false;
+      }
+
+      device->friction_tables.resize(DOF);
+      size_t n_compensated = 0;
+      for(size_t i=0; i<DOF; i++) {
+        for(size_t t=0; t<tables.size(); t++) {
+          if(tables[t].getJointName() == device->joint_names[i]) {
+            device->friction_tables[i] = tables[t];
+            device->friction_tables[i].scale(friction_scale);
+            n_compensated++;
+            break;
+          }
+        }
+      }
+
+      ROS_INFO_STREAM("Compensating the friction of "<<n_compensated<<" of the "<<DOF<<" joints of "<<product_name<<".");
+
+      return true;
+    }
+
+  bool BarrettHW::link_gravity(
+      const std::string &link_name,
+      Eigen::Vector3d &gravity)
+  {
+    boost::shared_ptr<const urdf::Link> link = urdf_model_.getLink(link_name);
+    if(!link) {
+      return false;
+    }
+
+    // Rotation of the link in the frame of the URDF root, which has to be
+    // fixed
+    urdf::Rotation rotation;
+    while(link->parent_joint) {
+      if(link->parent_joint->type != urdf::Joint::FIXED) {
+        ROS_ERROR_STREAM("Link \""<<link_name<<"\" is not fixed to the URDF root.");
+        return false;
+      }
+      rotation = link->parent_joint->parent_to_joint_origin_transform.rotation * rotation;
+      link = urdf_model_.getLink(link->parent_joint->parent_link_name);
+    }
+
+    const urdf::Vector3 link_gravity = rotation.GetInverse() * urdf::Vector3(gravity_[0], gravity_[1], gravity_[2]);
+    gravity = Eigen::Vector3d(link_gravity.x, link_gravity.y, link_gravity.z);
+
+    return true;
+  }
+
   bool BarrettHW::start()
   {
     // Guard on configured
@@ -390,6 +730,17 @@ namespace barrett_hw
 
   bool BarrettHW::read(const ros::Time time, const ros::Duration period)
   {
+    // Restart collision detection when requested
+    if(collision_reset_requested_) {
+      for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+        if(it->second->collision_observer) { it->second->collision_observer->reset(); }
+      }
+      for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+        if(it->second->collision_observer) { it->second->collision_observer->reset(); }
+      }
+      collision_reset_requested_ = false;
+    }
+
     // Iterate over all devices
     for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
       this->read_wam(time, period, it->second);
@@ -447,6 +798,10 @@ namespace barrett_hw
 
       // Store position
       device->joint_positions = raw_positions;
+      device->joint_calibrated_positions = raw_positions + device->joint_offsets;
+      if(device->kinematics) {
+        device->kinematics->invalidate();
+      }
 
       // Read resolver angles
       std::vector<barrett::Puck*> pucks = device->interface->getPucks();	
@@ -454,9 +809,200 @@ namespace barrett_hw
         device->resolver_angles(i) = pucks[i]->getProperty(barrett::Puck::MECH);
       }
 
+      // Check for collisions, so they can be acted on in this cycle's write
+      if(device->collision_observer) {
+        this->detect_wam_collisions(time, period, device);
+      }
+
+      // Snapshot the calibration whenever it changes
+      if(device->calibrated_joints != device->saved_calibrated_joints
+          || device->joint_offsets != device->saved_offsets) 
+      {
+        this->snapshot_wam_calibration(raw_positions, device);
+      }
+
       return true;
     }
 
+  template <size_t DOF>
+    void BarrettHW::detect_wam_collisions(
+        const ros::Time time, 
+        const ros::Duration period,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      // The model only applies to calibrated positions
+      if((device->calibrated_joints.array() != 1).any()) {
+        device->collision_observer->reset();
+        device->in_collision = false;
+        return;
+      }
+
+      // The total efforts are the torques applied since the last read
+      const ros::WallTime observer_start_time = ros::WallTime::now();
+      const bool in_collision = device->collision_observer->update(
+          device->joint_calibrated_positions,
+          device->joint_velocities,
+          device->joint_total_efforts,
+          period.toSec());
+      device->collision_observer_duration = (ros::WallTime::now() - observer_start_time).toSec();
+
+      // Publish the state periodically, and as soon as a collision is detected
+      const bool detected = in_collision && !device->in_collision;
+      device->in_collision = in_collision;
+      if((detected || (time - device->last_collision_publish_time).toSec() >= 1.0/collision_publish_rate_)
+          && device->collision_pub->trylock())
+      {
+        barrett_control_msgs::CollisionState &msg = device->collision_pub->msg_;
+        msg.header.stamp = time;
+        for(size_t i=0; i<DOF; i++) {
+          msg.residual[i] = device->collision_observer->getResidual()(i);
+        }
+        msg.in_collision = in_collision;
+        msg.detection_latency = device->collision_observer->getDetectionLatency();
+        msg.observer_duration = device->collision_observer_duration;
+        device->collision_pub->unlockAndPublish();
+        device->last_collision_publish_time = time;
+      }
+    }
+
+  bool BarrettHW::reset_collisions_cb(
+      std_srvs::Empty::Request &req,
+      std_srvs::Empty::Response &resp)
+  {
+    collision_reset_requested_ = true;
+    return true;
+  }
+
+  template <size_t DOF>
+    void BarrettHW::snapshot_wam_calibration(
+        const Eigen::Matrix<double,DOF,1> &raw_positions,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      // Never block the realtime thread, just try again next cycle
+      if(!calibration_mutex_.try_lock()) {
+        return;
+      }
+
+      for(size_t i=0; i<DOF; i++) {
+        JointCalibration &calibration = calibration_snapshot_[device->calibration_index + i];
+        calibration.valid = (device->calibrated_joints(i) == 1);
+        calibration.offset = device->joint_offsets(i);
+        calibration.position = raw_positions(i);
+        calibration.resolver_angle = device->resolver_angles(i);
+      }
+      calibration_dirty_ = true;
+
+      calibration_mutex_.unlock();
+
+      device->saved_offsets = device->joint_offsets;
+      device->saved_calibrated_joints = device->calibrated_joints;
+    }
+
+  void BarrettHW::save_calibration_cb(const ros::TimerEvent &event)
+  {
+    std::vector<JointCalibration> calibrations;
+    {
+      boost::mutex::scoped_lock lock(calibration_mutex_);
+      if(!calibration_dirty_) {
+        return;
+      }
+      calibrations = calibration_snapshot_;
+      calibration_dirty_ = false;
+    }
+
+    if(!save_calibration(calibration_file_, calibrations)) {
+      // Try again on the next timer event
+      boost::mutex::scoped_lock lock(calibration_mutex_);
+      calibration_dirty_ = true;
+    }
+  }
+
+  bool BarrettHW::restore_calibration()
+  {
+    if(calibration_file_.empty()) {
+      return false;
+    }
+
+    ros::WallTime restore_start_time = ros::WallTime::now();
+
+    std::vector<JointCalibration> calibrations;
+    if(!load_calibration(calibration_file_, calibrations)) {
+      ROS_INFO_STREAM("No stored calibration in \""<<calibration_file_<<"\", joints need to be calibrated.");
+      return false;
+    }
+
+    size_t n_joints = 0, n_restored = 0;
+    for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+      n_joints += 4;
+      n_restored += this->restore_wam_calibration(calibrations, it->second);
+    }
+    for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+      n_joints += 7;
+      n_restored += this->restore_wam_calibration(calibrations, it->second);
+    }
+
+    ROS_INFO("Restored the calibration of %zu of %zu joints in %g ms.",
+        n_restored, n_joints, (ros::WallTime::now() - restore_start_time).toSec()*1E3);
+
+    return n_joints > 0 && n_restored == n_joints;
+  }
+
+  template <size_t DOF>
+    size_t BarrettHW::restore_wam_calibration(
+        const std::vector<JointCalibration> &calibrations,
+        boost::shared_ptr<BarrettHW::WamDevice<DOF> > device)
+    {
+      size_t n_restored = 0;
+
+      // Compare the file against the current resolver and encoder readings,
+      // not the ones from the last cycle
+      device->joint_positions = device->interface->getJointPositions();
+      std::vector<barrett::Puck*> pucks = device->interface->getPucks();
+      for(size_t i=0; i<pucks.size(); i++) {
+        device->resolver_angles(i) = pucks[i]->getProperty(barrett::Puck::MECH);
+      }
+
+      for(size_t i=0; i<DOF; i++) {
+        const std::string &joint_name = device->joint_names[i];
+
+        // Find the stored calibration for this joint
+        std::vector<JointCalibration>::const_iterator calibration = calibrations.begin();
+        while(calibration != calibrations.end() && calibration->name != joint_name) {
+          ++calibration;
+        }
+        if(calibration == calibrations.end()) {
+          continue;
+        }
+
+        barrett_model::SemiAbsoluteJointHandle joint = 
+          semi_absolute_interface_.getSemiAbsoluteJointHandle(joint_name);
+
+        // If the encoder has been tracking the joint since the calibration was
+        // stored, the resolver has moved by the same amount as the encoder
+        double resolver_error = joint.getShortestDistance(
+            calibration->resolver_angle + (joint.getPosition() - calibration->position),
+            joint.getResolverAngle());
+
+        if(std::abs(resolver_error) > calibration_tolerance_) {
+          ROS_WARN_STREAM("Stored calibration for joint \""<<joint_name<<"\" is stale (resolver error: "<<resolver_error<<"), it needs to be recalibrated.");
+          continue;
+        }
+
+        joint.setOffset(calibration->offset);
+        joint.setCalibrated(1);
+        n_restored++;
+      }
+
+      // The offsets have already been burned into the encoders if they're all
+      // zero, otherwise they're burned in the next write once every joint is
+      // calibrated
+      if(n_restored == DOF && device->joint_offsets.isZero(0.0)) {
+        device->calibration_burned = true;
+      }
+
+      return n_restored;
+    }
+
   template <size_t DOF>
     void BarrettHW::write_wam(
         const ros::Time time, 
@@ -465,26 +1011,44 @@ namespace barrett_hw
     {
       static int warning = 0;
 
+      // Add the feedforward efforts to the commands, and clear them for the
+      // next cycle. After a collision, only the feedforward efforts (e.g.
+      // gravity compensation) are applied so the arm yields, until the
+      // collision is reset. Friction is only cancelled without a collision,
+      // since cancelling it would keep the arm moving into the obstacle, and
+      // the feedforward controllers which cancel it check the same flag.
+      if(device->in_collision) {
+        device->joint_total_efforts = device->joint_feedforward_efforts;
+      } else {
+        // Cancel the friction at the measured velocities
+        if(!device->friction_tables.empty()) {
+          for(size_t i=0; i<DOF; i++) {
+            device->joint_feedforward_efforts(i) += device->friction_tables[i].compute(device->joint_velocities(i));
+          }
+        }
+        device->joint_total_efforts = device->joint_effort_cmds + device->joint_feedforward_efforts;
+      }
+      device->joint_feedforward_efforts.setZero();
+
       for(size_t i=0; i<DOF; i++) {
-        if(std::abs(device->joint_effort_cmds(i)) > device->effort_limits[i]) {
+        if(std::abs(device->joint_total_efforts(i)) > device->effort_limits[i]) {
           if(warning++ > 1000) {
-            ROS_WARN_STREAM("Commanded torque ("<<device->joint_effort_cmds(i)<<") of joint ("<<i<<") exceeded safety limits! They have been truncated to: +/- "<<device->effort_limits[i]);
+            ROS_WARN_STREAM("Commanded torque ("<<device->joint_total_efforts(i)<<") of joint ("<<i<<") exceeded safety limits! They have been truncated to: +/- "<<device->effort_limits[i]);
             warning = 0;
           }
           // Truncate this joint torque
-          device->joint_effort_cmds(i) = std::max(
-              std::min(device->joint_effort_cmds(i), device->effort_limits[i]),
+          device->joint_total_efforts(i) = std::max(
+              std::min(device->joint_total_efforts(i), device->effort_limits[i]),
               -1.0*device->effort_limits[i]);
         }
       }
 
       // Set the torques
-      device->interface->setTorques(device->joint_effort_cmds);
+      device->interface->setTorques(device->joint_total_efforts);
 
       // If not calibrated, servo estimated position to calibration position
-      static int calib_decimate = 0;
-      if(!calibrated_ && calib_decimate++ > 0) {
-        calib_decimate = 0;
+      if(!device->calibration_burned && device->calibration_decimate++ > 0) {
+        device->calibration_decimate = 0;
 
         // Check if each joint is calibrated, if
         bool all_joints_calibrated = true;
@@ -513,15 +1077,21 @@ namespace barrett_hw
           }
 #endif
 
-          // Assign the positions to the current robot configuration
-          device->calibration_burn_offsets.setZero();
+          // Burn the offsets into the encoders, so the raw positions become
+          // the calibrated positions
+          device->calibration_burn_offsets = device->joint_positions + device->joint_offsets;
           device->interface->definePosition(device->calibration_burn_offsets);
+          device->joint_positions = device->calibration_burn_offsets;
+          device->joint_offsets.setZero();
+
+          // The encoder positions have changed, so store a new snapshot
+          device->saved_calibrated_joints.setConstant(-1);
 
           //if(std::abs(step-1.0) < 1E-4) {
-          calibrated_ = true;
+          device->calibration_burned = true;
           //}
 
-          ROS_INFO("Zeroed joints.");
+          ROS_INFO("Burned the calibration offsets into the joint encoders.");
 
         }
       }
@@ -615,6 +1185,7 @@ int main( int argc, char** argv ){
         ROS_ERROR("Could not read from WAM!");
       } else {
         wam_ok = true;
+        barrett_robot.restore_calibration();
       }
     }
 
@@ -0,0 +1,381 @@
+/*
+ * Checks the generated WAM kinematics and dynamics against the KDL solvers on
+ * the same URDF, and compares their cost. Also measures the cost and the
+ * detection latency of the momentum observer on a simulated collision, and
+ * the cost of friction lookup tables against the analytic model they sample.
+ *
+ * Usage: wam_model_benchmark WAM_7DOF_URDF WAM_4DOF_URDF [n_cycles]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+#include <Eigen/StdVector>
+
+#include <ros/time.h>
+
+#include <kdl/chain.hpp>
+#include <kdl/tree.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <kdl/chaindynparam.hpp>
+#include <kdl/chainidsolver_recursive_newton_euler.hpp>
+#include <kdl_urdf_tools/tools.h>
+#include <urdf/model.h>
+
+#include <barrett_model/wam_7dof_model.h>
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/momentum_observer.h>
+#include <barrett_model/friction_table.h>
+
+static const int N_SAMPLES = 256;
+static const double TOLERANCE = 1E-9;
+
+// Collision simulation
+static const double CYCLE = 1E-3;
+static const int SUBSTEPS = 10;
+static const double COLLISION_TIME = 1.0;
+static const double COLLISION_TORQUE = 5.0;
+static const double COLLISION_THRESHOLD = 2.0;
+
+// Friction tables
+static const double FRICTION_MAX_VELOCITY = 2.0;
+static const int FRICTION_SAMPLES = 401;
+
+//! Coulomb, Stribeck and viscous friction of a cable-driven joint
+double stribeck_friction(
+    const double velocity,
+    const double coulomb,
+    const double stiction,
+    const double stribeck_velocity,
+    const double viscous)
+{
+  const double s = velocity/stribeck_velocity;
+  return (coulomb + (stiction - coulomb)*std::exp(-s*s))*std::tanh(velocity/1E-3) + viscous*velocity;
+}
+
+double uniform(const double lo, const double hi) {
+  return lo + (hi - lo)*(static_cast<double>(rand())/RAND_MAX);
+}
+
+double max_difference(const Eigen::MatrixXd &a, const Eigen::MatrixXd &b) {
+  return (a - b).cwiseAbs().maxCoeff();
+}
+
+void report(const char *name, const double kdl_time, const double model_time, const int n_cycles) {
+  printf("  %-18s KDL: %9.1f ns  generated: %8.1f ns  speedup: %6.1fx\n",
+      name, 1E9*kdl_time/n_cycles, 1E9*model_time/n_cycles, kdl_time/model_time);
+}
+
+template <class Model>
+bool benchmark(const std::string &urdf_file, const int n_cycles)
+{
+  static const int N = Model::N_DOF;
+
+  // Build the KDL chain
+  std::ifstream urdf_stream(urdf_file.c_str());
+  if(!urdf_stream) {
+    fprintf(stderr, "Could not read %s\n", urdf_file.c_str());
+    return false;
+  }
+  std::stringstream robot_description;
+  robot_description << urdf_stream.rdbuf();
+
+  unsigned int n_dof;
+  KDL::Chain chain;
+  KDL::Tree tree;
+  urdf::Model urdf_model;
+  if(!kdl_urdf_tools::initialize_kinematics_from_urdf(
+        robot_description.str(), Model::root_link(), Model::tip_link(),
+        n_dof, chain, tree, urdf_model)
+      || n_dof != static_cast<unsigned int>(N))
+  {
+    fprintf(stderr, "Could not build the %d-DOF chain from %s\n", N, urdf_file.c_str());
+    return false;
+  }
+
+  const Eigen::Vector3d gravity(0.0, 0.0, -9.81);
+  const KDL::Vector kdl_gravity(gravity[0], gravity[1], gravity[2]);
+
+  KDL::ChainFkSolverPos_recursive fk_solver(chain);
+  KDL::ChainJntToJacSolver jac_solver(chain);
+  KDL::ChainDynParam dyn_param(chain, kdl_gravity);
+  KDL::ChainIdSolver_RNE id_solver(chain, kdl_gravity);
+
+  // Random joint states
+  typedef std::vector<typename Model::JointVector,
+          Eigen::aligned_allocator<typename Model::JointVector> > JointVectors;
+  JointVectors qs(N_SAMPLES), qds(N_SAMPLES), qdds(N_SAMPLES);
+  srand(0);
+  for(int s=0; s<N_SAMPLES; s++) {
+    for(int j=0; j<N; j++) {
+      qs[s][j] = uniform(-M_PI, M_PI);
+      qds[s][j] = uniform(-2.0, 2.0);
+      qdds[s][j] = uniform(-5.0, 5.0);
+    }
+  }
+
+  KDL::JntArray q(N), qd(N), qdd(N), kdl_torques(N);
+  KDL::Frame kdl_frame;
+  KDL::Jacobian kdl_jacobian(N);
+  KDL::JntSpaceInertiaMatrix kdl_mass(N);
+  KDL::Wrenches f_ext(chain.getNrOfSegments(), KDL::Wrench::Zero());
+
+  Eigen::Matrix3d rotation;
+  Eigen::Vector3d position;
+  typename Model::Jacobian jacobian;
+  typename Model::MassMatrix mass;
+  typename Model::JointVector torques;
+
+  // Check that both compute the same thing
+  double fk_error = 0.0, jac_error = 0.0, mass_error = 0.0, gravity_error = 0.0, id_error = 0.0;
+  for(int s=0; s<N_SAMPLES; s++) {
+    q.data = qs[s];
+    qd.data = qds[s];
+    qdd.data = qdds[s];
+
+    fk_solver.JntToCart(q, kdl_frame);
+    Model::tip_pose(qs[s], rotation, position);
+    for(int r=0; r<3; r++) {
+      fk_error = std::max(fk_error, std::abs(position[r] - kdl_frame.p[r]));
+      for(int c=0; c<3; c++) {
+        fk_error = std::max(fk_error, std::abs(rotation(r,c) - kdl_frame.M(r,c)));
+      }
+    }
+
+    jac_solver.JntToJac(q, kdl_jacobian);
+    Model::tip_jacobian(qs[s], rotation, position, jacobian);
+    jac_error = std::max(jac_error, max_difference(jacobian, kdl_jacobian.data));
+
+    dyn_param.JntToMass(q, kdl_mass);
+    Model::mass_matrix(qs[s], mass);
+    mass_error = std::max(mass_error, max_difference(mass, kdl_mass.data));
+
+    dyn_param.JntToGravity(q, kdl_torques);
+    Model::gravity_torques(qs[s], gravity, torques);
+    gravity_error = std::max(gravity_error, max_difference(torques, kdl_torques.data));
+
+    id_solver.CartToJnt(q, qd, qdd, f_ext, kdl_torques);
+    Model::inverse_dynamics(qs[s], qds[s], qdds[s], gravity, torques);
+    id_error = std::max(id_error, max_difference(torques, kdl_torques.data));
+  }
+
+  printf("%d-DOF chain from %s to %s\n", N, Model::root_link(), Model::tip_link());
+  printf("  max difference: pose %g jacobian %g mass %g gravity %g inverse dynamics %g\n",
+      fk_error, jac_error, mass_error, gravity_error, id_error);
+
+  // Time each of them
+  double checksum = 0.0;
+  ros::WallTime start;
+  double kdl_time, model_time;
+
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    q.data = qs[c % N_SAMPLES];
+    fk_solver.JntToCart(q, kdl_frame);
+    checksum += kdl_frame.p[0];
+  }
+  kdl_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    Model::tip_pose(qs[c % N_SAMPLES], rotation, position);
+    checksum += position[0];
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+  report("pose", kdl_time, model_time, n_cycles);
+
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    q.data = qs[c % N_SAMPLES];
+    fk_solver.JntToCart(q, kdl_frame);
+    jac_solver.JntToJac(q, kdl_jacobian);
+    checksum += kdl_jacobian(0,0);
+  }
+  kdl_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    Model::tip_jacobian(qs[c % N_SAMPLES], rotation, position, jacobian);
+    checksum += jacobian(0,0);
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+  report("pose and jacobian", kdl_time, model_time, n_cycles);
+
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    q.data = qs[c % N_SAMPLES];
+    dyn_param.JntToMass(q, kdl_mass);
+    checksum += kdl_mass(0,0);
+  }
+  kdl_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    Model::mass_matrix(qs[c % N_SAMPLES], mass);
+    checksum += mass(0,0);
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+  report("mass matrix", kdl_time, model_time, n_cycles);
+
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    q.data = qs[c % N_SAMPLES];
+    dyn_param.JntToGravity(q, kdl_torques);
+    checksum += kdl_torques(0);
+  }
+  kdl_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    Model::gravity_torques(qs[c % N_SAMPLES], gravity, torques);
+    checksum += torques[0];
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+  report("gravity", kdl_time, model_time, n_cycles);
+
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    q.data = qs[c % N_SAMPLES];
+    qd.data = qds[c % N_SAMPLES];
+    qdd.data = qdds[c % N_SAMPLES];
+    id_solver.CartToJnt(q, qd, qdd, f_ext, kdl_torques);
+    checksum += kdl_torques(0);
+  }
+  kdl_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    Model::inverse_dynamics(qs[c % N_SAMPLES], qds[c % N_SAMPLES], qdds[c % N_SAMPLES], gravity, torques);
+    checksum += torques[0];
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+  report("inverse dynamics", kdl_time, model_time, n_cycles);
+
+  // Simulate the arm under gravity compensation plus a small excitation, and
+  // push on its middle joint after COLLISION_TIME
+  barrett_model::MomentumObserver<Model> observer;
+  typename Model::JointVector thresholds;
+  thresholds.setConstant(COLLISION_THRESHOLD);
+  observer.setGravityVector(gravity);
+  observer.setThresholds(thresholds);
+
+  typename Model::JointVector sim_q = qs[0], sim_qd, sim_qdd, zero, applied, external, bias;
+  sim_qd.setZero();
+  zero.setZero();
+  external.setZero();
+
+  double quiet_residual = 0.0, detection_time = -1.0;
+  const int n_steps = static_cast<int>(2.0*COLLISION_TIME/CYCLE);
+  for(int c=0; c<n_steps && detection_time < 0.0; c++) {
+    const double t = c*CYCLE;
+    Model::gravity_torques(sim_q, gravity, applied);
+    for(int j=0; j<N; j++) {
+      applied[j] += 0.5*std::sin((j+1)*t);
+    }
+    if(t >= COLLISION_TIME) {
+      external[N/2] = COLLISION_TORQUE;
+    }
+
+    for(int s=0; s<SUBSTEPS; s++) {
+      Model::mass_matrix(sim_q, mass);
+      Model::inverse_dynamics(sim_q, sim_qd, zero, gravity, bias);
+      sim_qdd = mass.ldlt().solve(applied + external - bias);
+      sim_qd += sim_qdd*(CYCLE/SUBSTEPS);
+      sim_q += sim_qd*(CYCLE/SUBSTEPS);
+    }
+
+    if(observer.update(sim_q, sim_qd, applied, CYCLE)) {
+      detection_time = t + CYCLE - COLLISION_TIME;
+    } else if(t < COLLISION_TIME) {
+      quiet_residual = std::max(quiet_residual, observer.getResidual().cwiseAbs().maxCoeff());
+    }
+  }
+
+  const double detection_latency = observer.getDetectionLatency();
+
+  observer.reset();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    observer.update(qs[c % N_SAMPLES], qds[c % N_SAMPLES], qdds[c % N_SAMPLES], CYCLE);
+    checksum += observer.getResidual()[0];
+  }
+  model_time = (ros::WallTime::now() - start).toSec();
+
+  printf("  momentum observer: %8.1f ns  max residual without contact: %g Nm\n",
+      1E9*model_time/n_cycles, quiet_residual);
+  printf("  %g Nm collision detected after %g ms (measured latency %g ms)\n",
+      COLLISION_TORQUE, 1E3*detection_time, 1E3*detection_latency);
+
+  // Sample a friction curve for each joint, and compare the lookup to the
+  // analytic model
+  std::vector<barrett_model::FrictionTable> friction_tables(N);
+  Eigen::Matrix<double, N, 4> friction_params;
+  for(int j=0; j<N; j++) {
+    friction_params(j,0) = uniform(0.5, 2.0);
+    friction_params(j,1) = friction_params(j,0)*uniform(1.1, 1.5);
+    friction_params(j,2) = uniform(0.02, 0.1);
+    friction_params(j,3) = uniform(0.1, 1.0);
+    std::vector<double> samples(FRICTION_SAMPLES);
+    for(int i=0; i<FRICTION_SAMPLES; i++) {
+      const double v = -FRICTION_MAX_VELOCITY + 2.0*FRICTION_MAX_VELOCITY*i/(FRICTION_SAMPLES - 1);
+      samples[i] = stribeck_friction(v,
+          friction_params(j,0), friction_params(j,1), friction_params(j,2), friction_params(j,3));
+    }
+    friction_tables[j].init("joint", -FRICTION_MAX_VELOCITY, FRICTION_MAX_VELOCITY, samples);
+  }
+
+  // Outside of the transition through zero velocity
+  double friction_error = 0.0;
+  for(int c=0; c<N_SAMPLES; c++) {
+    for(int j=0; j<N; j++) {
+      const double v = uniform(0.05, FRICTION_MAX_VELOCITY)*(rand() % 2 ? 1.0 : -1.0);
+      friction_error = std::max(friction_error, std::abs(friction_tables[j].compute(v)
+            - stribeck_friction(v, friction_params(j,0), friction_params(j,1), friction_params(j,2), friction_params(j,3))));
+    }
+  }
+
+  double analytic_time, table_time;
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    const typename Model::JointVector &v = qds[c % N_SAMPLES];
+    for(int j=0; j<N; j++) {
+      checksum += stribeck_friction(v[j], friction_params(j,0), friction_params(j,1), friction_params(j,2), friction_params(j,3));
+    }
+  }
+  analytic_time = (ros::WallTime::now() - start).toSec();
+  start = ros::WallTime::now();
+  for(int c=0; c<n_cycles; c++) {
+    const typename Model::JointVector &v = qds[c % N_SAMPLES];
+    for(int j=0; j<N; j++) {
+      checksum += friction_tables[j].compute(v[j]);
+    }
+  }
+  table_time = (ros::WallTime::now() - start).toSec();
+  printf("  friction           analytic: %6.1f ns  table: %8.1f ns  speedup: %6.1fx  max error: %g Nm\n",
+      1E9*analytic_time/n_cycles, 1E9*table_time/n_cycles, analytic_time/table_time, friction_error);
+
+  printf("  (checksum %g)\n", checksum);
+
+  return fk_error < TOLERANCE
+    && jac_error < TOLERANCE
+    && mass_error < TOLERANCE
+    && gravity_error < TOLERANCE
+    && id_error < TOLERANCE
+    && detection_time >= 0.0;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 3) {
+    fprintf(stderr, "Usage: %s WAM_7DOF_URDF WAM_4DOF_URDF [n_cycles]\n", argv[0]);
+    return -1;
+  }
+
+  const int n_cycles = (argc > 3) ? atoi(argv[3]) : 100000;
+
+  const bool ok_7dof = benchmark<barrett_model::Wam7DofModel>(argv[1], n_cycles);
+  const bool ok_4dof = benchmark<barrett_model::Wam4DofModel>(argv[2], n_cycles);
+
+  return (ok_7dof && ok_4dof) ? 0 : 1;
+}
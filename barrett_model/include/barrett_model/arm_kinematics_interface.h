@@ -0,0 +1,310 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2012, hiDOF INC.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of hiDOF, Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BARRETT_MODEL_ARM_KINEMATICS_INTERFACE_H
+#define __BARRETT_MODEL_ARM_KINEMATICS_INTERFACE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <Eigen/Dense>
+
+#include <hardware_interface/hardware_interface.h>
+
+namespace barrett_model
+{
+
+/** \brief The kinematics of an arm at its current joint state
+ *
+ * The hardware calls \ref invalidate each time it reads a new joint state, and
+ * each quantity is computed the first time it is requested after that, so all
+ * of the controllers which use it during a control cycle share a single
+ * computation. It is only meant to be used from the control thread.
+ *
+ * Everything is expressed in the frame of the link at the root of the arm,
+ * and the Jacobian is that of the tool frame origin.
+ */
+class ArmKinematics
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  //! The largest arm supported (the 7-DOF WAM)
+  static const int MAX_DOF = 7;
+
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, MAX_DOF, 1> JointVector;
+  typedef Eigen::Matrix<double, 6, Eigen::Dynamic, Eigen::ColMajor, 6, MAX_DOF> Jacobian;
+
+  ArmKinematics(const unsigned int n_dof) :
+    n_dof_(n_dof),
+    pose_valid_(false),
+    jacobian_valid_(false),
+    gravity_valid_(false),
+    gravity_vector_(0.0, 0.0, -9.81)
+  {
+    tool_rotation_.setIdentity();
+    tool_position_.setZero();
+    jacobian_.setZero(6, n_dof_);
+    gravity_.setZero(n_dof_);
+  }
+
+  virtual ~ArmKinematics() { }
+
+  unsigned int size() const { return n_dof_; }
+
+  //! Mark everything as stale, called by the hardware after each read
+  void invalidate() {
+    pose_valid_ = false;
+    jacobian_valid_ = false;
+    gravity_valid_ = false;
+  }
+
+  //! Set the gravity vector in the frame of the root link
+  void setGravityVector(const Eigen::Vector3d &gravity_vector) {
+    gravity_vector_ = gravity_vector;
+    gravity_valid_ = false;
+  }
+
+  const Eigen::Vector3d& getGravityVector() const { return gravity_vector_; }
+
+  const Eigen::Matrix3d& getToolRotation() {
+    this->update_pose();
+    return tool_rotation_;
+  }
+
+  const Eigen::Vector3d& getToolPosition() {
+    this->update_pose();
+    return tool_position_;
+  }
+
+  const Jacobian& getJacobian() {
+    if(!jacobian_valid_) {
+      // The pose comes for free with the Jacobian
+      this->compute_jacobian(tool_rotation_, tool_position_, jacobian_);
+      pose_valid_ = true;
+      jacobian_valid_ = true;
+    }
+    return jacobian_;
+  }
+
+  //! The joint torques which hold the arm against gravity
+  const JointVector& getGravity() {
+    if(!gravity_valid_) {
+      this->compute_gravity(gravity_vector_, gravity_);
+      gravity_valid_ = true;
+    }
+    return gravity_;
+  }
+
+protected:
+  virtual void compute_pose(
+      Eigen::Matrix3d &rotation,
+      Eigen::Vector3d &position) = 0;
+
+  virtual void compute_jacobian(
+      Eigen::Matrix3d &rotation,
+      Eigen::Vector3d &position,
+      Jacobian &jacobian) = 0;
+
+  virtual void compute_gravity(
+      const Eigen::Vector3d &gravity_vector,
+      JointVector &gravity) = 0;
+
+private:
+  void update_pose() {
+    if(!pose_valid_) {
+      this->compute_pose(tool_rotation_, tool_position_);
+      pose_valid_ = true;
+    }
+  }
+
+  unsigned int n_dof_;
+  bool pose_valid_, jacobian_valid_, gravity_valid_;
+
+  Eigen::Vector3d gravity_vector_;
+
+  Eigen::Matrix3d tool_rotation_;
+  Eigen::Vector3d tool_position_;
+  Jacobian jacobian_;
+  JointVector gravity_;
+};
+
+/** \brief \ref ArmKinematics computed by one of the generated arm models
+ * (e.g. \c Wam7DofModel) from an array of joint positions
+ */
+template <class Model>
+class ModelArmKinematics : public ArmKinematics
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Eigen::Map<const typename Model::JointVector> PositionMap;
+
+  //! \param positions The storage for the arm's N_DOF joint positions
+  ModelArmKinematics(const double *positions) :
+    ArmKinematics(Model::N_DOF),
+    positions_(positions)
+  { }
+
+protected:
+  virtual void compute_pose(
+      Eigen::Matrix3d &rotation,
+      Eigen::Vector3d &position)
+  {
+    Model::tip_pose(PositionMap(positions_), rotation, position);
+  }
+
+  virtual void compute_jacobian(
+      Eigen::Matrix3d &rotation,
+      Eigen::Vector3d &position,
+      Jacobian &jacobian)
+  {
+    Model::tip_jacobian(PositionMap(positions_), rotation, position, jacobian);
+  }
+
+  virtual void compute_gravity(
+      const Eigen::Vector3d &gravity_vector,
+      JointVector &gravity)
+  {
+    Model::gravity_torques(PositionMap(positions_), gravity_vector, gravity);
+  }
+
+private:
+  const double *positions_;
+};
+
+
+/** \brief A handle used to read the shared kinematics of an arm
+ */
+class ArmKinematicsHandle
+{
+public:
+  ArmKinematicsHandle() :
+    kinematics_(NULL),
+    is_calibrated_(NULL)
+  {};
+
+  /**
+   * \param name The name of the arm
+   * \param joint_names The names of the arm's joints, from root to tip
+   * \param kinematics The arm's kinematics cache
+   * \param is_calibrated A pointer to the arm's per-joint calibration flags
+   */
+  ArmKinematicsHandle(
+      const std::string &name,
+      const std::vector<std::string> &joint_names,
+      ArmKinematics *kinematics,
+      const int *is_calibrated)
+    : name_(name),
+    joint_names_(joint_names),
+    kinematics_(kinematics),
+    is_calibrated_(is_calibrated)
+  {}
+
+  std::string getName() const { return name_; }
+  const std::vector<std::string>& getJointNames() const { return joint_names_; }
+
+  //! The kinematics are meaningless until all of the joints are calibrated
+  bool isCalibrated() const {
+    for(size_t i=0; i<joint_names_.size(); i++) {
+      if(is_calibrated_[i] != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const Eigen::Vector3d& getGravityVector() const { return kinematics_->getGravityVector(); }
+  const Eigen::Matrix3d& getToolRotation() const { return kinematics_->getToolRotation(); }
+  const Eigen::Vector3d& getToolPosition() const { return kinematics_->getToolPosition(); }
+  const ArmKinematics::Jacobian& getJacobian() const { return kinematics_->getJacobian(); }
+  const ArmKinematics::JointVector& getGravity() const { return kinematics_->getGravity(); }
+
+private:
+  std::string name_;
+  std::vector<std::string> joint_names_;
+  ArmKinematics *kinematics_;
+  const int *is_calibrated_;
+};
+
+
+/** \brief Hardware interface to read the kinematics of each arm, which are
+ * computed at most once per control cycle
+ *
+ * Since it is read-only, acquiring a handle does not claim anything.
+ */
+class ArmKinematicsInterface : public hardware_interface::HardwareInterface
+{
+public:
+  /// Get the vector of arm names registered to this interface.
+  std::vector<std::string> getArmNames() const
+  {
+    std::vector<std::string> out;
+    out.reserve(handle_map_.size());
+    for( HandleMap::const_iterator it = handle_map_.begin(); it != handle_map_.end(); ++it)
+    {
+      out.push_back(it->first);
+    }
+    return out;
+  }
+
+  /** \brief Register a new arm with this interface.
+   *
+   * \param handle A handle to the arm's kinematics
+   */
+  void registerArm(const ArmKinematicsHandle& handle)
+  {
+    HandleMap::iterator it = handle_map_.find(handle.getName());
+    if (it == handle_map_.end())
+      handle_map_.insert(std::make_pair(handle.getName(), handle));
+    else
+      it->second = handle;
+  }
+
+  /** \brief Get an \ref ArmKinematicsHandle for an arm
+   *
+   * \param name The name of the arm
+   */
+  ArmKinematicsHandle getArmKinematicsHandle(const std::string& name) const
+  {
+    HandleMap::const_iterator it = handle_map_.find(name);
+
+    if (it == handle_map_.end())
+      throw hardware_interface::HardwareInterfaceException("Could not find arm [" + name + "] in ArmKinematicsInterface");
+
+    return it->second;
+  }
+
+protected:
+  typedef std::map<std::string, ArmKinematicsHandle> HandleMap;
+  HandleMap handle_map_;
+};
+
+}
+
+#endif // ifndef __BARRETT_MODEL_ARM_KINEMATICS_INTERFACE_H
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (C) 2012, hiDOF INC.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright
+//     notice, this list of conditions and the following disclaimer in the
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of hiDOF, Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived from
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BARRETT_MODEL_EFFORT_FEEDFORWARD_INTERFACE_H
+#define __BARRETT_MODEL_EFFORT_FEEDFORWARD_INTERFACE_H
+
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/hardware_interface.h>
+
+namespace barrett_model
+{
+
+/** \brief A handle used to add a feedforward effort to a joint
+ *
+ * The state of the joint is reported in calibrated joint coordinates, and
+ * the efforts added by all handles to a joint during a control cycle are
+ * summed with the joint's effort command by the hardware.
+ *
+ * After a collision, the hardware drops the effort commands but keeps
+ * applying the feedforward efforts, so that e.g. gravity compensation holds
+ * the arm while it yields. Efforts which would push the arm on (e.g. friction
+ * cancellation) must not be added while \ref isInCollision is true.
+ */
+class EffortFeedforwardHandle : public hardware_interface::JointStateHandle
+{
+public:
+  EffortFeedforwardHandle() {};
+  EffortFeedforwardHandle(
+      const hardware_interface::JointStateHandle& js,
+      double* feedforward,
+      const int* is_calibrated,
+      const bool* in_collision = NULL)
+    : hardware_interface::JointStateHandle(js),
+    feedforward_(feedforward),
+    is_calibrated_(is_calibrated),
+    in_collision_(in_collision)
+  {}
+
+  void addEffort(const double effort) {
+    *feedforward_ += effort;
+  }
+
+  double getFeedforward() const {
+    return *feedforward_;
+  }
+
+  //! Feedforward efforts are meaningless until the joint's position is known
+  int isCalibrated() const {
+    return *is_calibrated_;
+  }
+
+  //! True while the hardware handles a collision of the joint's arm
+  bool isInCollision() const {
+    return in_collision_ && *in_collision_;
+  }
+
+private:
+  double* feedforward_;
+  const int* is_calibrated_;
+  const bool* in_collision_;
+};
+
+
+/** \brief Hardware interface to add feedforward efforts (e.g. gravity
+ * compensation) on top of the effort commands of other controllers
+ *
+ * Since the efforts from all handles are summed, acquiring a handle does not
+ * claim the joint, and any number of controllers can use it alongside a
+ * controller which claims the joint's \ref EffortJointInterface.
+ */
+class EffortFeedforwardInterface : public hardware_interface::HardwareInterface
+{
+public:
+  /// Get the vector of joint names registered to this interface.
+  std::vector<std::string> getJointNames() const
+  {
+    std::vector<std::string> out;
+    out.reserve(handle_map_.size());
+    for( HandleMap::const_iterator it = handle_map_.begin(); it != handle_map_.end(); ++it)
+    {
+      out.push_back(it->first);
+    }
+    return out;
+  }
+
+  /** \brief Register a new joint with this interface.
+   *
+   * \param js A handle to the calibrated state of the joint
+   * \param feedforward A pointer to the storage for the summed feedforward effort
+   * \param is_calibrated A pointer to the joint's calibration flag
+   * \param in_collision A pointer to the collision flag of the joint's arm,
+   * if the hardware detects collisions
+   */
+  void registerJoint(
+      const hardware_interface::JointStateHandle& js,
+      double* feedforward,
+      const int* is_calibrated,
+      const bool* in_collision = NULL)
+  {
+    EffortFeedforwardHandle handle(js, feedforward, is_calibrated, in_collision);
+    HandleMap::iterator it = handle_map_.find(js.getName());
+    if (it == handle_map_.end())
+      handle_map_.insert(std::make_pair(js.getName(), handle));
+    else
+      it->second = handle;
+  }
+
+  /** \brief Get an \ref EffortFeedforwardHandle for a joint
+   *
+   * \param name The name of the joint
+   */
+  EffortFeedforwardHandle getEffortFeedforwardHandle(const std::string& name) const
+  {
+    HandleMap::const_iterator it = handle_map_.find(name);
+
+    if (it == handle_map_.end())
+      throw hardware_interface::HardwareInterfaceException("Could not find joint [" + name + "] in EffortFeedforwardInterface");
+
+    return it->second;
+  }
+
+protected:
+  typedef std::map<std::string, EffortFeedforwardHandle> HandleMap;
+  HandleMap handle_map_;
+};
+
+}
+
+#endif // ifndef __BARRETT_MODEL_EFFORT_FEEDFORWARD_INTERFACE_H
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_MODEL_FRICTION_TABLE_H
+#define __BARRETT_MODEL_FRICTION_TABLE_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace barrett_model {
+
+  /** \brief The friction torque of a joint as a function of its velocity,
+   * sampled on a uniform grid
+   *
+   * The table is identified offline from logged joint states by
+   * \c identify_friction.py, so nothing about the shape of the curve (e.g.
+   * Stribeck or Coulomb terms) is assumed. \ref compute interpolates
+   * linearly between the two nearest samples in constant time, and holds the
+   * first and last samples outside of the table's velocity range.
+   *
+   * A table which hasn't been initialized computes zero friction.
+   */
+  class FrictionTable
+  {
+  public:
+    FrictionTable() :
+      joint_name_(""),
+      min_velocity_(0.0),
+      max_velocity_(0.0),
+      inverse_step_(0.0),
+      last_index_(0.0)
+    { }
+
+    /** \brief Fill the table
+     *
+     * \param joint_name The name of the joint
+     * \param min_velocity The velocity [rad/s] of the first sample
+     * \param max_velocity The velocity [rad/s] of the last sample
+     * \param torques The friction torques [Nm] at evenly spaced velocities,
+     * at least two
+     */
+    bool init(
+        const std::string &joint_name,
+        const double min_velocity,
+        const double max_velocity,
+        const std::vector<double> &torques)
+    {
+      if(torques.size() < 2 || !(max_velocity > min_velocity)) {
+        return false;
+      }
+
+      joint_name_ = joint_name;
+      min_velocity_ = min_velocity;
+      max_velocity_ = max_velocity;
+      torques_ = torques;
+      last_index_ = static_cast<double>(torques_.size() - 1);
+      inverse_step_ = last_index_/(max_velocity_ - min_velocity_);
+
+      return true;
+    }
+
+    //! Scale all of the torques, e.g. to only partially compensate friction
+    void scale(const double factor) {
+      for(size_t i=0; i<torques_.size(); i++) {
+        torques_[i] *= factor;
+      }
+    }
+
+    //! The friction torque [Nm] at a joint velocity [rad/s]
+    double compute(const double velocity) const {
+      if(torques_.empty()) {
+        return 0.0;
+      }
+
+      const double x = (velocity - min_velocity_)*inverse_step_;
+      if(x <= 0.0) {
+        return torques_.front();
+      } else if(x >= last_index_) {
+        return torques_.back();
+      }
+
+      const size_t i = static_cast<size_t>(x);
+      const double fraction = x - static_cast<double>(i);
+      return torques_[i] + fraction*(torques_[i+1] - torques_[i]);
+    }
+
+    const std::string& getJointName() const { return joint_name_; }
+    double getMinVelocity() const { return min_velocity_; }
+    double getMaxVelocity() const { return max_velocity_; }
+    const std::vector<double>& getTorques() const { return torques_; }
+
+  private:
+    std::string joint_name_;
+    double min_velocity_, max_velocity_;
+    double inverse_step_;
+    double last_index_;
+    std::vector<double> torques_;
+  };
+
+  /** \brief Read the friction tables written by \c identify_friction.py
+   *
+   * Each line which isn't empty or a comment holds one joint's table:
+   *
+   *   JOINT_NAME MIN_VELOCITY MAX_VELOCITY TORQUE TORQUE ...
+   */
+  inline bool load_friction_tables(
+      const std::string &path,
+      std::vector<FrictionTable> &tables)
+  {
+    std::ifstream file(path.c_str());
+    if(!file.is_open()) {
+      return false;
+    }
+
+    tables.clear();
+
+    std::string line;
+    while(std::getline(file, line)) {
+      if(line.empty() || line[0] == '#') {
+        continue;
+      }
+
+      std::istringstream iss(line);
+      std::string joint_name;
+      double min_velocity, max_velocity, torque;
+      if(!(iss >> joint_name >> min_velocity >> max_velocity)) {
+        return false;
+      }
+      std::vector<double> torques;
+      while(iss >> torque) {
+        torques.push_back(torque);
+      }
+      if(!iss.eof()) {
+        return false;
+      }
+
+      FrictionTable table;
+      if(!table.init(joint_name, min_velocity, max_velocity, torques)) {
+        return false;
+      }
+      tables.push_back(table);
+    }
+
+    return true;
+  }
+
+}
+
+#endif // ifndef __BARRETT_MODEL_FRICTION_TABLE_H
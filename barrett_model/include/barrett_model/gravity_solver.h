@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_MODEL_GRAVITY_SOLVER_H
+#define __BARRETT_MODEL_GRAVITY_SOLVER_H
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+#include <kdl/chain.hpp>
+
+namespace barrett_model {
+
+  /** \brief Computes the joint torques which hold a serial chain of revolute
+   * joints against gravity
+   *
+   * This is the recursive Newton-Euler algorithm specialized for zero joint
+   * velocities and accelerations: a forward pass computes the pose of each
+   * joint, and a backward pass accumulates the mass and first mass moment of
+   * the links outboard of each joint.
+   *
+   * The chain is copied from a \c KDL::Chain by \ref init, which lumps links
+   * attached by fixed joints into the preceding moving link. All storage is
+   * sized by \c MaxDOF at compile time, so \ref compute never allocates.
+   */
+  template <int MaxDOF>
+  class GravitySolver
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 1, Eigen::ColMajor, MaxDOF, 1> JointVector;
+
+    GravitySolver() :
+      n_dof_(0),
+      gravity_(0.0, 0.0, -9.81)
+    { }
+
+    //! Build the solver from a chain of revolute and fixed joints
+    bool init(const KDL::Chain &chain)
+    {
+      if(chain.getNrOfJoints() > static_cast<unsigned int>(MaxDOF)) {
+        return false;
+      }
+      n_dof_ = chain.getNrOfJoints();
+
+      for(int j=0; j<MaxDOF; j++) {
+        joint_rotations_[j].setIdentity();
+        joint_translations_[j].setZero();
+        joint_axes_[j] = Eigen::Vector3d::UnitZ();
+        link_masses_[j] = 0.0;
+        link_moments_[j].setZero();
+      }
+
+      // The frame of the last link, relative to the frame of its joint
+      KDL::Frame link_frame = KDL::Frame::Identity();
+      int j = -1;
+
+      for(unsigned int s=0; s<chain.getNrOfSegments(); s++) {
+        const KDL::Segment &segment = chain.getSegment(s);
+        const KDL::Joint &joint = segment.getJoint();
+
+        if(joint.getType() == KDL::Joint::None) {
+          // Rigidly attached to the previous link
+          if(j >= 0) {
+            this->add_inertia(j, link_frame*segment.getFrameToTip(), segment.getInertia());
+          }
+          link_frame = link_frame*segment.getFrameToTip();
+          continue;
+        }
+
+        if(joint.getType() == KDL::Joint::TransAxis
+            || joint.getType() == KDL::Joint::TransX
+            || joint.getType() == KDL::Joint::TransY
+            || joint.getType() == KDL::Joint::TransZ)
+        {
+          // Only revolute joints are supported
+          return false;
+        }
+
+        j++;
+
+        // The joint frame is at the joint origin, with the orientation of
+        // the segment's base frame, and rotates about the joint axis
+        const KDL::Frame joint_frame = link_frame*KDL::Frame(joint.JointOrigin());
+        this->set_joint(j, joint_frame, joint.JointAxis());
+
+        // The tip of the segment relative to the rotated joint frame
+        link_frame = KDL::Frame(-joint.JointOrigin())*segment.getFrameToTip();
+        this->add_inertia(j, link_frame, segment.getInertia());
+      }
+
+      return (j+1 == static_cast<int>(n_dof_));
+    }
+
+    //! Set the gravity vector in the chain's root frame
+    void setGravity(const Eigen::Vector3d &gravity) { gravity_ = gravity; }
+
+    unsigned int size() const { return n_dof_; }
+
+    //! Compute the joint torques that hold the chain at the given positions
+    template <class PositionVector, class TorqueVector>
+      void compute(const PositionVector &q, TorqueVector &tau) const
+      {
+        // Pose of the current frame in the root frame
+        Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d p = Eigen::Vector3d::Zero();
+
+        // Forward pass: joint axes, joint origins, and link first mass moments
+        // in the root frame
+        for(unsigned int j=0; j<n_dof_; j++) {
+          p += R*joint_translations_[j];
+          R = R*joint_rotations_[j];
+
+          origins_[j] = p;
+          axes_[j] = R*joint_axes_[j];
+
+          R = R*this->axis_rotation(joint_axes_[j], q[j]);
+
+          moments_[j] = R*link_moments_[j] + link_masses_[j]*p;
+        }
+
+        // Backward pass: the gravity torque about each joint is due to all of
+        // the links outboard of it
+        double mass = 0.0;
+        Eigen::Vector3d moment = Eigen::Vector3d::Zero();
+        for(int j=n_dof_-1; j>=0; j--) {
+          mass += link_masses_[j];
+          moment += moments_[j];
+          tau[j] = -axes_[j].dot((moment - mass*origins_[j]).cross(gravity_));
+        }
+      }
+
+  protected:
+
+    void set_joint(const int j, const KDL::Frame &frame, const KDL::Vector &axis) {
+      for(int r=0; r<3; r++) {
+        for(int c=0; c<3; c++) {
+          joint_rotations_[j](r,c) = frame.M(r,c);
+        }
+        joint_translations_[j][r] = frame.p[r];
+      }
+      joint_axes_[j] = Eigen::Vector3d(axis.x(), axis.y(), axis.z()).normalized();
+    }
+
+    //! Add the mass and first mass moment of a rigid body to link j
+    void add_inertia(const int j, const KDL::Frame &frame, const KDL::RigidBodyInertia &inertia) {
+      const KDL::Vector cog = frame*inertia.getCOG();
+      link_masses_[j] += inertia.getMass();
+      link_moments_[j] += inertia.getMass()*Eigen::Vector3d(cog.x(), cog.y(), cog.z());
+    }
+
+    //! Rotation of angle about a unit axis
+    static Eigen::Matrix3d axis_rotation(const Eigen::Vector3d &axis, const double angle) {
+      const double c = std::cos(angle), s = std::sin(angle), v = 1.0 - c;
+      Eigen::Matrix3d rotation;
+      rotation <<
+        c + axis.x()*axis.x()*v,          axis.x()*axis.y()*v - axis.z()*s, axis.x()*axis.z()*v + axis.y()*s,
+        axis.y()*axis.x()*v + axis.z()*s, c + axis.y()*axis.y()*v,          axis.y()*axis.z()*v - axis.x()*s,
+        axis.z()*axis.x()*v - axis.y()*s, axis.z()*axis.y()*v + axis.x()*s, c + axis.z()*axis.z()*v;
+      return rotation;
+    }
+
+    unsigned int n_dof_;
+    Eigen::Vector3d gravity_;
+
+    // Chain parameters, per joint
+    Eigen::Matrix3d joint_rotations_[MaxDOF];
+    Eigen::Vector3d joint_translations_[MaxDOF];
+    Eigen::Vector3d joint_axes_[MaxDOF];
+    double link_masses_[MaxDOF];
+    Eigen::Vector3d link_moments_[MaxDOF];
+
+    // Workspace
+    mutable Eigen::Vector3d origins_[MaxDOF];
+    mutable Eigen::Vector3d axes_[MaxDOF];
+    mutable Eigen::Vector3d moments_[MaxDOF];
+  };
+
+}
+
+#endif // ifndef __BARRETT_MODEL_GRAVITY_SOLVER_H
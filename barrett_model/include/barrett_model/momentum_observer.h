@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_MODEL_MOMENTUM_OBSERVER_H
+#define __BARRETT_MODEL_MOMENTUM_OBSERVER_H
+
+#include <limits>
+
+#include <Eigen/Dense>
+
+namespace barrett_model {
+
+  /** \brief Estimates the external joint torques on an arm from its
+   * generalized momentum, to detect collisions
+   *
+   * The residual r = K (p - p0 - integral(tau + C^T qd - g + r)) follows the
+   * external torques through a first-order filter with time constant 1/K,
+   * where p = M(q) qd. It only needs the joint positions, the velocities and
+   * the applied torques, not the accelerations.
+   *
+   * C^T qd - g is computed as Mdot qd - (C qd + g), with C qd + g from the
+   * inverse dynamics at zero acceleration, and Mdot qd dt from the change of
+   * the mass matrix over the cycle. The kinematics and dynamics come from
+   * one of the generated arm models (e.g. \c Wam7DofModel), so \ref update
+   * never allocates.
+   *
+   * A collision is detected when the residual of any joint exceeds its
+   * threshold, and stays detected until \ref reset. Unmodelled friction shows
+   * up in the residual, so the thresholds have to be above it.
+   *
+   * The detection latency is the time from the last cycle in which every
+   * residual was below the onset fraction of its threshold to the cycle in
+   * which the collision was detected.
+   */
+  template <class Model>
+  class MomentumObserver
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef typename Model::JointVector JointVector;
+    typedef typename Model::MassMatrix MassMatrix;
+
+    MomentumObserver() :
+      gravity_(0.0, 0.0, -9.81),
+      onset_fraction_(0.5),
+      initialized_(false),
+      in_collision_(false),
+      in_onset_(false),
+      onset_elapsed_(0.0),
+      detection_latency_(0.0)
+    {
+      gains_.setConstant(50.0);
+      thresholds_.setConstant(std::numeric_limits<double>::infinity());
+      zero_.setZero();
+      residual_.setZero();
+    }
+
+    //! Set the gravity vector in the frame of the root link
+    void setGravityVector(const Eigen::Vector3d &gravity) { gravity_ = gravity; }
+
+    //! Set the observer gain [1/s] of each joint
+    void setGains(const JointVector &gains) { gains_ = gains; }
+
+    //! Set the residual [Nm] above which each joint is in collision
+    void setThresholds(const JointVector &thresholds) { thresholds_ = thresholds; }
+
+    //! Set the fraction of the thresholds at which latency measurements start
+    void setOnsetFraction(const double onset_fraction) { onset_fraction_ = onset_fraction; }
+
+    //! Restart the integration at the next \ref update and clear the collision
+    void reset() {
+      initialized_ = false;
+      in_collision_ = false;
+      in_onset_ = false;
+      onset_elapsed_ = 0.0;
+      residual_.setZero();
+    }
+
+    /** \brief Update the residual with a new joint state
+     *
+     * \param q The joint positions
+     * \param qd The joint velocities
+     * \param tau The joint torques applied since the last update
+     * \param dt The time since the last update [s]
+     *
+     * Returns true if a collision has been detected.
+     */
+    bool update(
+        const JointVector &q,
+        const JointVector &qd,
+        const JointVector &tau,
+        const double dt)
+    {
+      Model::mass_matrix(q, mass_);
+      momentum_ = mass_*qd;
+
+      if(!initialized_) {
+        initial_momentum_ = momentum_;
+        previous_mass_ = mass_;
+        integral_.setZero();
+        residual_.setZero();
+        initialized_ = true;
+        return in_collision_;
+      }
+
+      // Coriolis, centrifugal and gravity torques
+      Model::inverse_dynamics(q, qd, zero_, gravity_, bias_);
+
+      integral_ += (tau - bias_ + residual_)*dt + (mass_ - previous_mass_)*qd;
+      previous_mass_ = mass_;
+
+      residual_ = gains_.cwiseProduct(momentum_ - initial_momentum_ - integral_);
+
+      if(!in_collision_) {
+        const Eigen::Array<double, Model::N_DOF, 1> magnitude = residual_.cwiseAbs().array();
+
+        // Time since the residual started rising
+        if((magnitude > onset_fraction_*thresholds_.array()).any()) {
+          onset_elapsed_ = in_onset_ ? onset_elapsed_ + dt : 0.0;
+          in_onset_ = true;
+        } else {
+          in_onset_ = false;
+        }
+
+        if((magnitude > thresholds_.array()).any()) {
+          in_collision_ = true;
+          detection_latency_ = onset_elapsed_;
+        }
+      }
+
+      return in_collision_;
+    }
+
+    bool inCollision() const { return in_collision_; }
+
+    //! The estimated external joint torques [Nm]
+    const JointVector& getResidual() const { return residual_; }
+
+    const JointVector& getThresholds() const { return thresholds_; }
+
+    //! The detection latency [s] of the last collision
+    double getDetectionLatency() const { return detection_latency_; }
+
+  private:
+    Eigen::Vector3d gravity_;
+    JointVector gains_, thresholds_;
+    double onset_fraction_;
+
+    bool initialized_;
+    bool in_collision_;
+    bool in_onset_;
+    double onset_elapsed_;
+    double detection_latency_;
+
+    // State
+    JointVector initial_momentum_, integral_, residual_;
+    MassMatrix previous_mass_;
+
+    // Workspace
+    JointVector zero_, momentum_, bias_;
+    MassMatrix mass_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_MODEL_MOMENTUM_OBSERVER_H
@@ -54,6 +54,17 @@ public:
     is_calibrated_(is_calibrated)
   {}
 
+  //! A handle to the same joint as \c other, whose commands go to \c cmd
+  SemiAbsoluteJointHandle(
+      const SemiAbsoluteJointHandle& other,
+      double* cmd)
+    : hardware_interface::JointHandle(other, cmd),
+    resolver_range_(other.resolver_range_),
+    resolver_angle_(other.resolver_angle_),
+    joint_offset_(other.joint_offset_),
+    is_calibrated_(other.is_calibrated_)
+  {}
+
   double getResolverAngle() const {
     return *resolver_angle_;
   };
@@ -74,6 +85,11 @@ public:
     return *is_calibrated_;
   }
 
+  //! The joint displacement over which the resolver angle wraps around
+  double getResolverRange() const {
+    return resolver_range_;
+  }
+
   inline double getShortestDistance(double from, double to) const
   {
     return resolver_range_/2.0/M_PI * angles::shortest_angular_distance(
@@ -120,10 +136,18 @@ public:
    */
   void registerJoint(const hardware_interface::JointHandle& js, double resolver_range, double* resolver_angle, double* joint_offset, int* is_calibrated)
   {
-    SemiAbsoluteJointHandle handle(js, resolver_range, resolver_angle, joint_offset, is_calibrated);
-    HandleMap::iterator it = handle_map_.find(js.getName());
+    this->registerHandle(SemiAbsoluteJointHandle(js, resolver_range, resolver_angle, joint_offset, is_calibrated));
+  }
+
+  /** \brief Register an existing handle with this interface.
+   *
+   * \param handle The handle, e.g. one whose commands are redirected
+   */
+  void registerHandle(const SemiAbsoluteJointHandle& handle)
+  {
+    HandleMap::iterator it = handle_map_.find(handle.getName());
     if (it == handle_map_.end())
-      handle_map_.insert(std::make_pair(js.getName(), handle));
+      handle_map_.insert(std::make_pair(handle.getName(), handle));
     else
       it->second = handle;
   }
@@ -0,0 +1,643 @@
+#!/usr/bin/env python
+"""
+Generates fixed-size C++ kinematics and dynamics for a serial chain in a URDF.
+
+The chain from the root link to the tip link is read from an (already
+xacro-expanded) URDF, links attached by fixed joints are lumped into the
+preceding moving link, and a header is written with straight-line code for the
+tip pose, the Jacobian, the joint-space mass matrix, the gravity torques and
+the recursive Newton-Euler inverse dynamics of the chain.
+
+The joint loops are unrolled and all of the link parameters are written as
+literals. Each joint's constant rotation and its rotation about its axis are
+multiplied out ahead of time, so the terms which are zero in the model (e.g.
+from the 90 degree twists between the WAM's joints) do not appear in the
+generated code at all.
+
+The conventions match KDL: everything is expressed in the frame of the root
+link, the Jacobian's reference point is the origin of the tip link and its
+first three rows are linear velocities, and gravity is given as an
+acceleration.
+
+Usage: generate_dynamics.py URDF ROOT_LINK TIP_LINK CLASS_NAME OUTPUT_HEADER
+"""
+
+from __future__ import print_function
+
+import sys
+import os
+import math
+import xml.etree.ElementTree as ET
+
+# Constants this close to 0 or +/-1 are rounded, since they come from sums of
+# multiples of pi/2 in the URDF
+EPSILON = 1E-12
+
+###############################################################################
+# Small dense linear algebra on nested lists
+
+def identity():
+    return [[1.0, 0.0, 0.0], [0.0, 1.0, 0.0], [0.0, 0.0, 1.0]]
+
+def zeros():
+    return [[0.0]*3 for r in range(3)]
+
+def mat_mul(A, B):
+    return [[sum(A[r][k]*B[k][c] for k in range(3)) for c in range(3)] for r in range(3)]
+
+def mat_vec(A, v):
+    return [sum(A[r][k]*v[k] for k in range(3)) for r in range(3)]
+
+def mat_add(A, B):
+    return [[A[r][c] + B[r][c] for c in range(3)] for r in range(3)]
+
+def mat_scale(A, s):
+    return [[s*A[r][c] for c in range(3)] for r in range(3)]
+
+def transpose(A):
+    return [[A[c][r] for c in range(3)] for r in range(3)]
+
+def vec_add(a, b):
+    return [a[i] + b[i] for i in range(3)]
+
+def vec_scale(a, s):
+    return [s*x for x in a]
+
+def dot(a, b):
+    return sum(a[i]*b[i] for i in range(3))
+
+def skew(v):
+    return [[0.0, -v[2], v[1]], [v[2], 0.0, -v[0]], [-v[1], v[0], 0.0]]
+
+def outer(a, b):
+    return [[a[r]*b[c] for c in range(3)] for r in range(3)]
+
+def parallel_axis(mass, c):
+    """The inertia of a point mass at c about the origin"""
+    return mat_scale(mat_add(mat_scale(identity(), dot(c, c)), mat_scale(outer(c, c), -1.0)), mass)
+
+def rpy_to_matrix(rpy):
+    """URDF fixed-axis roll, pitch, yaw: Rz(y)*Ry(p)*Rx(r)"""
+    r, p, y = rpy
+    cr, sr = math.cos(r), math.sin(r)
+    cp, sp = math.cos(p), math.sin(p)
+    cy, sy = math.cos(y), math.sin(y)
+    Rx = [[1.0, 0.0, 0.0], [0.0, cr, -sr], [0.0, sr, cr]]
+    Ry = [[cp, 0.0, sp], [0.0, 1.0, 0.0], [-sp, 0.0, cp]]
+    Rz = [[cy, -sy, 0.0], [sy, cy, 0.0], [0.0, 0.0, 1.0]]
+    return mat_mul(Rz, mat_mul(Ry, Rx))
+
+class Frame(object):
+    def __init__(self, R=None, p=None):
+        self.R = R if R is not None else identity()
+        self.p = p if p is not None else [0.0, 0.0, 0.0]
+
+    def __mul__(self, other):
+        return Frame(mat_mul(self.R, other.R), vec_add(self.p, mat_vec(self.R, other.p)))
+
+###############################################################################
+# URDF parsing
+
+def parse_floats(text, default):
+    if text is None:
+        return list(default)
+    return [float(x) for x in text.split()]
+
+def parse_origin(element):
+    if element is None:
+        return Frame()
+    xyz = parse_floats(element.get('xyz'), [0.0, 0.0, 0.0])
+    rpy = parse_floats(element.get('rpy'), [0.0, 0.0, 0.0])
+    return Frame(rpy_to_matrix(rpy), xyz)
+
+class Body(object):
+    """Mass, first mass moment and inertia about the origin of a link frame"""
+    def __init__(self):
+        self.mass = 0.0
+        self.moment = [0.0, 0.0, 0.0]
+        self.inertia = zeros()
+
+    def add(self, frame, mass, com, inertia):
+        """Add a rigid body with its COG and rotational inertia in the given frame"""
+        c = vec_add(frame.p, mat_vec(frame.R, com))
+        I = mat_mul(frame.R, mat_mul(inertia, transpose(frame.R)))
+        self.mass += mass
+        self.moment = vec_add(self.moment, vec_scale(c, mass))
+        self.inertia = mat_add(self.inertia, mat_add(I, parallel_axis(mass, c)))
+
+    def cog(self):
+        if self.mass == 0.0:
+            return [0.0, 0.0, 0.0]
+        return vec_scale(self.moment, 1.0/self.mass)
+
+    def cog_inertia(self):
+        """Rotational inertia about the COG"""
+        return mat_add(self.inertia, mat_scale(parallel_axis(self.mass, self.cog()), -1.0))
+
+def parse_inertial(link):
+    """Returns the mass, COG and inertia of a link in the link frame, or None
+
+    The inertial origin places the COG in the link frame, and its rotation
+    only orients the principal axes of the inertia, so it's only applied to
+    the inertia.
+    """
+    inertial = link.find('inertial')
+    if inertial is None:
+        return None
+    # Like the URDF parser, only the first origin is used
+    frame = parse_origin(inertial.find('origin'))
+    mass = float(inertial.find('mass').get('value'))
+    i = inertial.find('inertia')
+    get = lambda name: float(i.get(name, '0'))
+    inertia = [
+            [get('ixx'), get('ixy'), get('ixz')],
+            [get('ixy'), get('iyy'), get('iyz')],
+            [get('ixz'), get('iyz'), get('izz')]]
+    return mass, frame.p, mat_mul(frame.R, mat_mul(inertia, transpose(frame.R)))
+
+class Chain(object):
+    """A chain of revolute joints with lumped links"""
+    def __init__(self, urdf_file, root_link, tip_link):
+        robot = ET.parse(urdf_file).getroot()
+
+        links = dict((l.get('name'), l) for l in robot.findall('link'))
+        joints_by_child = dict((j.find('child').get('link'), j) for j in robot.findall('joint'))
+
+        if root_link not in links:
+            raise Exception('Root link %s is not in the URDF' % root_link)
+        if tip_link not in links:
+            raise Exception('Tip link %s is not in the URDF' % tip_link)
+
+        # Walk up from the tip
+        urdf_joints = []
+        link = tip_link
+        while link != root_link:
+            if link not in joints_by_child:
+                raise Exception('%s is not a descendant of %s' % (tip_link, root_link))
+            joint = joints_by_child[link]
+            urdf_joints.insert(0, joint)
+            link = joint.find('parent').get('link')
+
+        self.root_link = root_link
+        self.tip_link = tip_link
+        self.joint_names = []
+        # Per joint: constant rotation and translation relative to the
+        # previous link frame, and the axis
+        self.rotations = []
+        self.translations = []
+        self.axes = []
+        self.bodies = []
+
+        # The frame of the current link relative to the last moving link frame
+        pending = Frame()
+        for joint in urdf_joints:
+            joint_type = joint.get('type')
+            origin = parse_origin(joint.find('origin'))
+            child = links[joint.find('child').get('link')]
+
+            if joint_type == 'fixed':
+                pending = pending*origin
+            elif joint_type in ('revolute', 'continuous'):
+                frame = pending*origin
+                axis = parse_floats(
+                        joint.find('axis').get('xyz') if joint.find('axis') is not None else None,
+                        [1.0, 0.0, 0.0])
+                norm = math.sqrt(dot(axis, axis))
+                self.joint_names.append(joint.get('name'))
+                self.rotations.append(frame.R)
+                self.translations.append(frame.p)
+                self.axes.append(vec_scale(axis, 1.0/norm))
+                self.bodies.append(Body())
+                pending = Frame()
+            else:
+                raise Exception('Joint %s has unsupported type %s' % (joint.get('name'), joint_type))
+
+            # Links which are fixed to the root do not move
+            inertial = parse_inertial(child)
+            if inertial and self.bodies:
+                mass, com, inertia = inertial
+                self.bodies[-1].add(pending, mass, com, inertia)
+
+        if not self.joint_names:
+            raise Exception('There are no moving joints between %s and %s' % (root_link, tip_link))
+
+        self.tip = pending
+
+    def size(self):
+        return len(self.joint_names)
+
+###############################################################################
+# Code emission
+
+def literal(x):
+    # The shortest representation which reads back as the same double
+    text = repr(float(x))
+    if 'e' in text and '.' not in text:
+        text = text.replace('e', '.0e')
+    return text
+
+def clean(x):
+    """Round constants which are numerically 0 or +/-1"""
+    if abs(x) < EPSILON:
+        return 0.0
+    if abs(x - 1.0) < EPSILON:
+        return 1.0
+    if abs(x + 1.0) < EPSILON:
+        return -1.0
+    return x
+
+def linear_combination(terms):
+    """C++ for sum(coefficient*symbol) over (coefficient, symbol) pairs,
+    where a symbol of None is the constant 1"""
+    parts = []
+    for coefficient, symbol in terms:
+        coefficient = clean(coefficient)
+        if coefficient == 0.0:
+            continue
+        if symbol is None:
+            text = literal(abs(coefficient))
+        elif abs(coefficient) == 1.0:
+            text = symbol
+        else:
+            text = '%s*%s' % (literal(abs(coefficient)), symbol)
+        parts.append(('-' if coefficient < 0.0 else '+', text))
+    if not parts:
+        return '0.0'
+    code = ('-' if parts[0][0] == '-' else '') + parts[0][1]
+    for sign, text in parts[1:]:
+        code += ' %s %s' % (sign, text)
+    return code
+
+class Emitter(object):
+    def __init__(self, chain):
+        self.chain = chain
+        self.lines = []
+        self.indent = 6
+
+    def line(self, text=''):
+        self.lines.append((' '*self.indent + text) if text else '')
+
+    def local_rotation(self, j):
+        """The rotation of joint j relative to the previous link frame as a 3x3
+        array of [(coefficient, symbol)] sums in cos(q[j]) and sin(q[j])"""
+        C = self.chain.rotations[j]
+        a = self.chain.axes[j]
+        # Rot(a, q) = a*a' + cos(q)*(I - a*a') + sin(q)*[a]x
+        constant = mat_mul(C, outer(a, a))
+        cosine = mat_mul(C, mat_add(identity(), mat_scale(outer(a, a), -1.0)))
+        sine = mat_mul(C, skew(a))
+        c, s = 'c%d' % j, 's%d' % j
+        return [[[(constant[r][k], None), (cosine[r][k], c), (sine[r][k], s)] for k in range(3)] for r in range(3)]
+
+    def forward_kinematics(self, axes=True):
+        """Declare the rotation Rj and origin pj of each link frame and, with
+        axes, the axis zj of each joint in the root frame"""
+        n = self.chain.size()
+        for j in range(n):
+            self.line('const double c%d = std::cos(q[%d]), s%d = std::sin(q[%d]);' % (j, j, j, j))
+        for j in range(n):
+            self.line()
+            self.line('// %s' % self.chain.joint_names[j])
+            L = self.local_rotation(j)
+            t = self.chain.translations[j]
+            self.line('Eigen::Matrix3d R%d;' % j)
+            if j == 0:
+                self.line('const Eigen::Vector3d p0(%s, %s, %s);' % tuple(literal(clean(x)) for x in t))
+                for r in range(3):
+                    self.line('R0(%d,0) = %s; R0(%d,1) = %s; R0(%d,2) = %s;' % (
+                        r, linear_combination(L[r][0]),
+                        r, linear_combination(L[r][1]),
+                        r, linear_combination(L[r][2])))
+            else:
+                self.line('const Eigen::Vector3d p%d = p%d%s;' % (j, j-1, self.rotate_constant(j-1, t, leading_sign=True)))
+                for r in range(3):
+                    entries = []
+                    for c in range(3):
+                        # Expand the product of the previous rotation with the
+                        # local rotation
+                        products = []
+                        for k in range(3):
+                            factor = linear_combination(L[k][c])
+                            if factor == '0.0':
+                                continue
+                            products.append(multiply('R%d(%d,%d)' % (j-1, r, k), factor))
+                        entries.append('R%d(%d,%d) = %s;' % (j, r, c, join_sum(products)))
+                    self.line(' '.join(entries))
+            if axes:
+                self.line('const Eigen::Vector3d z%d = %s;' % (j, self.rotate_constant(j, self.chain.axes[j])))
+
+    def rotate_constant(self, j, v, leading_sign=False):
+        """C++ for Rj*v with a constant vector v"""
+        terms = []
+        for k in range(3):
+            x = clean(v[k])
+            if x == 0.0:
+                continue
+            column = 'R%d.col(%d)' % (j, k)
+            if abs(x) == 1.0:
+                terms.append(('-' if x < 0 else '+', column))
+            else:
+                terms.append(('-' if x < 0 else '+', '%s*%s' % (literal(abs(x)), column)))
+        if not terms:
+            return '' if leading_sign else 'Eigen::Vector3d::Zero()'
+        if leading_sign:
+            return ''.join(' %s %s' % term for term in terms)
+        code = ('-' if terms[0][0] == '-' else '') + terms[0][1]
+        return code + ''.join(' %s %s' % term for term in terms[1:])
+
+    def tip(self):
+        """Declare the tip rotation Rt and origin pt"""
+        n = self.chain.size()
+        T = self.chain.tip
+        self.line('const Eigen::Vector3d pt = p%d%s;' % (n-1, self.rotate_constant(n-1, T.p, leading_sign=True)))
+        self.line('Eigen::Matrix3d Rt;')
+        for c in range(3):
+            self.line('Rt.col(%d) = %s;' % (c, self.rotate_constant(n-1, [T.R[r][c] for r in range(3)])))
+
+    def link_inertia(self, j):
+        """Declare the lumped link parameters of link j"""
+        body = self.chain.bodies[j]
+        cog = body.cog()
+        I = body.cog_inertia()
+        self.line('const double m%d = %s;' % (j, literal(body.mass)))
+        self.line('const Eigen::Vector3d r%d = %s;' % (j, self.rotate_constant(j, cog)))
+        self.line('Eigen::Matrix3d I%d;' % j)
+        self.line('I%d << %s;' % (j, ', '.join(literal(clean(I[r][c])) for r in range(3) for c in range(3))))
+
+def multiply(symbol, factor):
+    """C++ for symbol*factor, where factor is a linear combination"""
+    if factor == '1.0':
+        return symbol
+    if factor == '-1.0':
+        return '-' + symbol
+    if ' ' in factor:
+        return '%s*(%s)' % (symbol, factor)
+    if factor.startswith('-'):
+        return '-%s*%s' % (symbol, factor[1:])
+    return '%s*%s' % (symbol, factor)
+
+def join_sum(products):
+    if not products:
+        return '0.0'
+    code = products[0]
+    for p in products[1:]:
+        if p.startswith('-'):
+            code += ' - ' + p[1:]
+        else:
+            code += ' + ' + p
+    return code
+
+###############################################################################
+# Functions
+
+def generate(chain, class_name, source):
+    n = chain.size()
+    guard = '__BARRETT_MODEL_%s_H' % os.path.splitext(os.path.basename(source['output']))[0].upper()
+
+    out = []
+    w = out.append
+    w('/*')
+    w(' * Generated by barrett_model/scripts/generate_dynamics.py from')
+    w(' * %s' % os.path.basename(source['urdf']))
+    w(' * with root link %s and tip link %s.' % (chain.root_link, chain.tip_link))
+    w(' *')
+    w(' * Do not edit this file, it is regenerated by the build.')
+    w(' */')
+    w('')
+    w('#ifndef %s' % guard)
+    w('#define %s' % guard)
+    w('')
+    w('#include <cmath>')
+    w('')
+    w('#include <Eigen/Dense>')
+    w('')
+    w('namespace barrett_model {')
+    w('')
+    w('  /** \\brief Kinematics and dynamics of the %d-DOF chain from %s to %s' % (n, chain.root_link, chain.tip_link))
+    w('   *')
+    w('   * Everything is expressed in the frame of the root link. None of these')
+    w('   * functions allocate.')
+    w('   */')
+    w('  class %s' % class_name)
+    w('  {')
+    w('  public:')
+    w('    static const int N_DOF = %d;' % n)
+    w('')
+    w('    typedef Eigen::Matrix<double, N_DOF, 1> JointVector;')
+    w('    typedef Eigen::Matrix<double, 6, N_DOF> Jacobian;')
+    w('    typedef Eigen::Matrix<double, N_DOF, N_DOF> MassMatrix;')
+    w('')
+    w('    static const char* root_link() { return "%s"; }' % chain.root_link)
+    w('    static const char* tip_link() { return "%s"; }' % chain.tip_link)
+    w('')
+    w('    static const char* joint_name(const int j) {')
+    w('      static const char* names[N_DOF] = {')
+    for j, name in enumerate(chain.joint_names):
+        w('        "%s"%s' % (name, ',' if j < n-1 else ''))
+    w('      };')
+    w('      return names[j];')
+    w('    }')
+    w('')
+
+    # Tip pose, which doesn't need the joint axes
+    e = Emitter(chain)
+    e.forward_kinematics(axes=False)
+    e.line()
+    e.tip()
+    e.line()
+    e.line('rotation = Rt;')
+    e.line('position = pt;')
+    w('    //! Pose of the tip link')
+    w('    template <class Vector>')
+    w('    static void tip_pose(')
+    w('        const Vector &q,')
+    w('        Eigen::Matrix3d &rotation,')
+    w('        Eigen::Vector3d &position)')
+    w('    {')
+    out.extend(e.lines)
+    w('    }')
+    w('')
+
+    # Pose and Jacobian
+    e = Emitter(chain)
+    e.forward_kinematics()
+    e.line()
+    e.tip()
+    e.line()
+    e.line('rotation = Rt;')
+    e.line('position = pt;')
+    e.line()
+    for j in range(n):
+        e.line('jacobian.template block<3,1>(0,%d) = z%d.cross(pt - p%d);' % (j, j, j))
+        e.line('jacobian.template block<3,1>(3,%d) = z%d;' % (j, j))
+    w('    /** \\brief Pose of the tip link and the Jacobian of its origin')
+    w('     *')
+    w('     * The first three rows of the Jacobian are the linear velocity of the')
+    w('     * tip origin and the last three are the angular velocity of the tip.')
+    w('     */')
+    w('    template <class Vector, class JacobianMatrix>')
+    w('    static void tip_jacobian(')
+    w('        const Vector &q,')
+    w('        Eigen::Matrix3d &rotation,')
+    w('        Eigen::Vector3d &position,')
+    w('        JacobianMatrix &jacobian)')
+    w('    {')
+    out.extend(e.lines)
+    w('    }')
+    w('')
+
+    # Mass matrix (composite rigid body algorithm)
+    e = Emitter(chain)
+    e.forward_kinematics()
+    e.line()
+    e.line('// Composite inertias of the links outboard of each joint about the')
+    e.line('// root origin: mass, first mass moment and rotational inertia')
+    for j in reversed(range(n)):
+        e.line()
+        e.link_inertia(j)
+        e.line('const Eigen::Vector3d x%d = p%d + r%d;' % (j, j, j))
+        e.line('Eigen::Matrix3d J%d = R%d*I%d*R%d.transpose() + m%d*(x%d.squaredNorm()*Eigen::Matrix3d::Identity() - x%d*x%d.transpose());'
+                % (j, j, j, j, j, j, j, j))
+        if j == n-1:
+            e.line('const double mc%d = m%d;' % (j, j))
+            e.line('const Eigen::Vector3d hc%d = m%d*x%d;' % (j, j, j))
+            e.line('const Eigen::Matrix3d Jc%d = J%d;' % (j, j))
+        else:
+            e.line('const double mc%d = mc%d + m%d;' % (j, j+1, j))
+            e.line('const Eigen::Vector3d hc%d = hc%d + m%d*x%d;' % (j, j+1, j, j))
+            e.line('const Eigen::Matrix3d Jc%d = Jc%d + J%d;' % (j, j+1, j))
+    e.line()
+    e.line('// Joint motion axes')
+    for j in range(n):
+        e.line('const Eigen::Vector3d v%d = p%d.cross(z%d);' % (j, j, j))
+    for j in range(n):
+        e.line()
+        e.line('// Momentum of the composite link %d moving about joint %d' % (j, j))
+        e.line('{')
+        e.indent += 2
+        e.line('const Eigen::Vector3d L = mc%d*v%d + z%d.cross(hc%d);' % (j, j, j, j))
+        e.line('const Eigen::Vector3d H = hc%d.cross(v%d) + Jc%d*z%d;' % (j, j, j, j))
+        for i in range(j+1):
+            e.line('mass(%d,%d) = z%d.dot(H) + v%d.dot(L);' % (i, j, i, i))
+            if i != j:
+                e.line('mass(%d,%d) = mass(%d,%d);' % (j, i, i, j))
+        e.indent -= 2
+        e.line('}')
+    w('    //! Joint-space mass matrix')
+    w('    template <class Vector, class Matrix>')
+    w('    static void mass_matrix(')
+    w('        const Vector &q,')
+    w('        Matrix &mass)')
+    w('    {')
+    out.extend(e.lines)
+    w('    }')
+    w('')
+
+    # Gravity
+    e = Emitter(chain)
+    e.forward_kinematics()
+    e.line()
+    e.line('// Mass and first mass moment of the links outboard of each joint')
+    for j in reversed(range(n)):
+        body = chain.bodies[j]
+        e.line('const double m%d = %s;' % (j, literal(body.mass)))
+        moment = e.rotate_constant(j, body.moment, leading_sign=True)
+        if j == n-1:
+            e.line('const double mc%d = m%d;' % (j, j))
+            e.line('const Eigen::Vector3d hc%d = m%d*p%d%s;' % (j, j, j, moment))
+        else:
+            e.line('const double mc%d = mc%d + m%d;' % (j, j+1, j))
+            e.line('const Eigen::Vector3d hc%d = hc%d + m%d*p%d%s;' % (j, j+1, j, j, moment))
+    e.line()
+    for j in range(n):
+        e.line('tau[%d] = -z%d.dot((hc%d - mc%d*p%d).cross(gravity));' % (j, j, j, j, j))
+    w('    //! Joint torques which hold the chain against gravity')
+    w('    template <class Vector, class TorqueVector>')
+    w('    static void gravity_torques(')
+    w('        const Vector &q,')
+    w('        const Eigen::Vector3d &gravity,')
+    w('        TorqueVector &tau)')
+    w('    {')
+    out.extend(e.lines)
+    w('    }')
+    w('')
+
+    # Inverse dynamics (recursive Newton-Euler)
+    e = Emitter(chain)
+    e.forward_kinematics()
+    e.line()
+    e.line('// Forward pass: angular velocity and acceleration, and linear')
+    e.line('// acceleration of each link origin, then the force and moment')
+    e.line('// (about the COG) on each link')
+    for j in range(n):
+        e.line()
+        e.link_inertia(j)
+        if j == 0:
+            e.line('const Eigen::Vector3d w0 = z0*qd[0];')
+            e.line('const Eigen::Vector3d wd0 = z0*qdd[0];')
+            e.line('const Eigen::Vector3d a0 = -gravity;')
+        else:
+            e.line('const Eigen::Vector3d d%d = p%d - p%d;' % (j, j, j-1))
+            e.line('const Eigen::Vector3d w%d = w%d + z%d*qd[%d];' % (j, j-1, j, j))
+            e.line('const Eigen::Vector3d wd%d = wd%d + z%d*qdd[%d] + w%d.cross(z%d*qd[%d]);' % (j, j-1, j, j, j-1, j, j))
+            e.line('const Eigen::Vector3d a%d = a%d + wd%d.cross(d%d) + w%d.cross(w%d.cross(d%d));' % (j, j-1, j-1, j, j-1, j-1, j))
+        e.line('const Eigen::Vector3d F%d = m%d*(a%d + wd%d.cross(r%d) + w%d.cross(w%d.cross(r%d)));' % (j, j, j, j, j, j, j, j))
+        e.line('const Eigen::Vector3d N%d = R%d*(I%d*(R%d.transpose()*wd%d)) + w%d.cross(R%d*(I%d*(R%d.transpose()*w%d)));'
+                % (j, j, j, j, j, j, j, j, j, j))
+    e.line()
+    e.line('// Backward pass: force and moment (about the joint origin) exerted')
+    e.line('// on each link by its parent')
+    e.line('Eigen::Vector3d f = F%d;' % (n-1))
+    e.line('Eigen::Vector3d n = N%d + r%d.cross(F%d);' % (n-1, n-1, n-1))
+    e.line('tau[%d] = z%d.dot(n);' % (n-1, n-1))
+    for j in reversed(range(n-1)):
+        e.line('n = N%d + r%d.cross(F%d) + n + (p%d - p%d).cross(f);' % (j, j, j, j+1, j))
+        e.line('f = F%d + f;' % j)
+        e.line('tau[%d] = z%d.dot(n);' % (j, j))
+    w('    /** \\brief Joint torques which produce the given joint accelerations')
+    w('     *')
+    w('     * This is the recursive Newton-Euler algorithm, like')
+    w('     * \\c KDL::ChainIdSolver_RNE with no external forces.')
+    w('     */')
+    w('    template <class Vector, class TorqueVector>')
+    w('    static void inverse_dynamics(')
+    w('        const Vector &q,')
+    w('        const Vector &qd,')
+    w('        const Vector &qdd,')
+    w('        const Eigen::Vector3d &gravity,')
+    w('        TorqueVector &tau)')
+    w('    {')
+    out.extend(e.lines)
+    w('    }')
+    w('  };')
+    w('')
+    w('}')
+    w('')
+    w('#endif // ifndef %s' % guard)
+
+    return '\n'.join(out) + '\n'
+
+def main():
+    if len(sys.argv) != 6:
+        print(__doc__.strip().split('\n')[-1], file=sys.stderr)
+        return 1
+
+    urdf_file, root_link, tip_link, class_name, output = sys.argv[1:]
+
+    chain = Chain(urdf_file, root_link, tip_link)
+    code = generate(chain, class_name, {'urdf': urdf_file, 'output': output})
+
+    # Only touch the header if it changed, to avoid needless rebuilds
+    if os.path.exists(output):
+        with open(output) as f:
+            if f.read() == code:
+                return 0
+    directory = os.path.dirname(output)
+    if directory and not os.path.exists(directory):
+        os.makedirs(directory)
+    with open(output, 'w') as f:
+        f.write(code)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
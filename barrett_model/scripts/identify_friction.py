@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+"""
+Identifies friction lookup tables for the joints of an arm from logged joint
+states.
+
+The joint states (sensor_msgs/JointState, with the applied efforts) are read
+from a bag recorded while each joint moves back and forth over the same range
+of positions at a variety of roughly constant velocities, e.g. with the joint
+trajectory controller and gravity compensation running. The efforts are
+averaged in bins on a uniform velocity grid, and the friction torque at each
+velocity is taken to be the odd part of the average:
+
+  f(v) = (tau(v) - tau(-v)) / 2
+
+Torques which only depend on the position (e.g. uncompensated gravity) are
+the same in both directions, so they cancel, and the inertial torques average
+out at constant velocities. Bins without enough samples are interpolated from
+their neighbours.
+
+The tables are written in the format read by barrett_model::load_friction_tables.
+
+Usage: identify_friction.py [options] BAG OUTPUT
+"""
+
+from __future__ import print_function
+
+import sys
+import os
+import optparse
+
+def read_joint_states(bag_file, topic, joint_names):
+    """Collect the (velocity, effort) samples of each joint in a bag"""
+    import rosbag
+
+    samples = {}
+    with rosbag.Bag(bag_file) as bag:
+        for _, msg, _ in bag.read_messages(topics=[topic]):
+            if len(msg.velocity) != len(msg.name) or len(msg.effort) != len(msg.name):
+                continue
+            for name, velocity, effort in zip(msg.name, msg.velocity, msg.effort):
+                if joint_names and name not in joint_names:
+                    continue
+                samples.setdefault(name, []).append((velocity, effort))
+    return samples
+
+def fill_gaps(values):
+    """Linearly interpolate the missing (None) values of a list"""
+    known = [i for i, v in enumerate(values) if v is not None]
+    if not known:
+        return None
+    filled = list(values)
+    for i in range(len(values)):
+        if filled[i] is not None:
+            continue
+        below = [k for k in known if k < i]
+        above = [k for k in known if k > i]
+        if below and above:
+            a, b = below[-1], above[0]
+            filled[i] = values[a] + (values[b] - values[a]) * (i - a) / float(b - a)
+        else:
+            filled[i] = values[below[-1] if below else above[0]]
+    return filled
+
+def identify(samples, max_velocity, n_samples, min_count):
+    """Compute the friction table of one joint from its samples"""
+    step = 2.0 * max_velocity / (n_samples - 1)
+
+    # Average the efforts around each grid velocity
+    sums = [0.0] * n_samples
+    counts = [0] * n_samples
+    for velocity, effort in samples:
+        i = int(round((velocity + max_velocity) / step))
+        if 0 <= i < n_samples:
+            sums[i] += effort
+            counts[i] += 1
+
+    means = [s / c if c >= min_count else None for s, c in zip(sums, counts)]
+    means = fill_gaps(means)
+    if means is None:
+        return None
+
+    # Keep the part which changes sign with the velocity
+    return [0.5 * (means[i] - means[n_samples - 1 - i]) for i in range(n_samples)]
+
+def main():
+    parser = optparse.OptionParser(usage=__doc__.strip().split('\n')[-1])
+    parser.add_option('--topic', default='joint_states',
+            help='The sensor_msgs/JointState topic [default: %default]')
+    parser.add_option('--joints', default='',
+            help='Comma-separated names of the joints to identify [default: all]')
+    parser.add_option('--max-velocity', type='float', default=1.0,
+            help='The largest velocity [rad/s] in the tables [default: %default]')
+    parser.add_option('--samples', type='int', default=41,
+            help='The number of samples in each table [default: %default]')
+    parser.add_option('--min-count', type='int', default=20,
+            help='The number of measurements a bin needs to be used [default: %default]')
+    options, args = parser.parse_args()
+
+    if len(args) != 2:
+        parser.print_usage(sys.stderr)
+        return 1
+    bag_file, output = args
+
+    # An odd number of samples puts one at zero velocity
+    if options.samples < 3 or options.samples % 2 == 0:
+        print('The number of samples must be odd and at least 3.', file=sys.stderr)
+        return 1
+    if options.max_velocity <= 0.0:
+        print('The maximum velocity must be positive.', file=sys.stderr)
+        return 1
+
+    joint_names = [j for j in options.joints.split(',') if j]
+    samples = read_joint_states(bag_file, options.topic, joint_names)
+
+    lines = ['# Friction lookup tables identified from %s' % os.path.basename(bag_file),
+             '# JOINT_NAME MIN_VELOCITY MAX_VELOCITY TORQUE...']
+    for name in (joint_names or sorted(samples.keys())):
+        table = identify(samples.get(name, []), options.max_velocity, options.samples, options.min_count)
+        if table is None:
+            print('Not enough samples of joint %s, it was skipped.' % name, file=sys.stderr)
+            continue
+        lines.append(' '.join(
+            [name, repr(-options.max_velocity), repr(options.max_velocity)] +
+            ['%.6g' % t for t in table]))
+        print('%s: %.3f Nm at %.3f rad/s' % (name, table[-1], options.max_velocity))
+
+    with open(output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
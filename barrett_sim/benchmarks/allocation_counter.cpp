@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <malloc.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+#include "allocation_counter.h"
+
+extern "C" {
+  void* __libc_malloc( size_t size );
+  void* __libc_calloc( size_t n, size_t size );
+  void* __libc_realloc( void* ptr, size_t size );
+  void* __libc_memalign( size_t alignment, size_t size );
+}
+
+namespace barrett_sim {
+
+  // Threads other than the benchmark's (e.g. the bus's) allocate too, so
+  // the count is updated atomically
+  static volatile bool counting = false;
+  static unsigned long count = 0;
+
+  static inline void count_allocation()
+  { if( counting ){ __sync_fetch_and_add( &count, 1UL ); } }
+
+  void start_counting_allocations() { counting = true; __sync_synchronize(); }
+  void stop_counting_allocations() { __sync_synchronize(); counting = false; }
+  unsigned long allocations() { return __sync_fetch_and_add( &count, 0UL ); }
+
+}
+
+extern "C" {
+
+  void* malloc( size_t size ){
+    barrett_sim::count_allocation();
+    return __libc_malloc( size );
+  }
+
+  void* calloc( size_t n, size_t size ){
+    barrett_sim::count_allocation();
+    return __libc_calloc( n, size );
+  }
+
+  void* realloc( void* ptr, size_t size ){
+    barrett_sim::count_allocation();
+    return __libc_realloc( ptr, size );
+  }
+
+  void* memalign( size_t alignment, size_t size ){
+    barrett_sim::count_allocation();
+    return __libc_memalign( alignment, size );
+  }
+
+  int posix_memalign( void** ptr, size_t alignment, size_t size ){
+    barrett_sim::count_allocation();
+    *ptr = __libc_memalign( alignment, size );
+    return ( *ptr == NULL ) ? ENOMEM : 0;
+  }
+
+}
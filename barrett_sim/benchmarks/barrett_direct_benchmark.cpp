@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Times the small per-cycle operations of the barrett_direct driver on
+ * synthetic frames: setting and getting a property of a puck, unpacking
+ * position and property replies, and the torque and position calls of the
+ * WAM, which pack the currents of its groups, decode the replies of their
+ * position queries and convert between motor and joint space.
+ *
+ * The WAM is first initialized on an emulated bus, so the pucks, groups
+ * and transmission matrices are set up like on a real arm. The bus is then
+ * switched to replay a fixed set of replies, without the emulator, and to
+ * discard what is sent. Everything is timed through the public API of the
+ * driver, so the packing and the conversions are timed in the calls which
+ * use them. Each operation is reported in nanoseconds and in allocations
+ * per call.
+ *
+ * Usage: barrett_direct_benchmark [n_calls]
+ */
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <leo_can/CANBus.h>
+
+#include <barrett_direct/WAM.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <barrett_sim/emulated_wam_bus.h>
+
+#include "allocation_counter.h"
+
+using namespace barrett_direct;
+
+static double wall_time(){
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + 1E-9*ts.tv_nsec;
+}
+
+/** \brief A bus which passes the frames to another one, until it is told to
+ * replay a set of received frames
+ *
+ * When replaying, what is sent is discarded, and the same received frames
+ * are returned over and over.
+ */
+class ReplayBus : public leo_can::CANBus
+{
+public:
+  ReplayBus( leo_can::CANBus* backend ) :
+    leo_can::CANBus( leo_can::CANBus::RATE_1000 ),
+    backend( backend ),
+    next( 0 )
+  { }
+
+  //! Replay these frames from now on
+  void Replay( const std::vector<leo_can::CANBusFrame>& frames ){
+    this->frames = frames;
+    next = 0;
+  }
+
+  virtual leo_can::CANBus::Errno Open() { return backend->Open(); }
+  virtual leo_can::CANBus::Errno Close() { return backend->Close(); }
+
+  virtual leo_can::CANBus::Errno Send( const leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT ){
+    if( frames.empty() )
+    { return backend->Send( frame, flags ); }
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  virtual leo_can::CANBus::Errno Recv( leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT ){
+    if( frames.empty() )
+    { return backend->Recv( frame, flags ); }
+    // The replies only arrive after a query
+    if( flags & leo_can::CANBus::MSG_NOBLOCK )
+    { return leo_can::CANBus::EFAILURE; }
+    frame = frames[ next ];
+    next = ( next + 1 ) % frames.size();
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  virtual leo_can::CANBus::Errno AddFilter( const leo_can::CANBus::Filter& filter )
+  { return backend->AddFilter( filter ); }
+
+private:
+  leo_can::CANBus* backend;
+  std::vector<leo_can::CANBusFrame> frames;
+  size_t next;
+};
+
+//! Time and allocations of a run of calls
+class Measurement
+{
+public:
+  Measurement( const char* name, int n_calls ) :
+    name( name ),
+    n_calls( n_calls ),
+    start_allocations( barrett_sim::allocations() ),
+    start( wall_time() )
+  { barrett_sim::start_counting_allocations(); }
+
+  ~Measurement(){
+    const double elapsed = wall_time() - start;
+    barrett_sim::stop_counting_allocations();
+    const unsigned long n_allocations = barrett_sim::allocations() - start_allocations;
+    printf( "  %-34s %9.1f ns/call  %6.2f allocations/call\n",
+        name, 1E9*elapsed/n_calls, (double)n_allocations/n_calls );
+  }
+
+private:
+  const char* name;
+  int n_calls;
+  unsigned long start_allocations;
+  double start;
+};
+
+//! The reply of a puck to a position query
+static leo_can::CANBusFrame position_reply( Puck::ID id, Barrett::Value count ){
+  leo_can::CANBusFrame::data_field_t data = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+  data[0] = (leo_can::CANBusFrame::data_t)( Barrett::SET_CODE | ( ( count >> 16 ) & 0x3F ) );
+  data[1] = (leo_can::CANBusFrame::data_t)( ( count >> 8 ) & 0xFF );
+  data[2] = (leo_can::CANBusFrame::data_t)( count & 0xFF );
+  return leo_can::CANBusFrame( Group::CANID( Group::POSITION ) | ( ( id & 0x1F ) << 5 ), data, 3 );
+}
+
+//! The reply of a puck to a property query
+static leo_can::CANBusFrame property_reply( Puck::ID id, Barrett::ID propid, Barrett::Value value ){
+  leo_can::CANBusFrame::data_field_t data = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+  data[0] = propid | Barrett::SET_CODE;
+  for( size_t i=2; i<6; i++ ){
+    data[i] = (leo_can::CANBusFrame::data_t)( value & 0xFF );
+    value >>= 8;
+  }
+  return leo_can::CANBusFrame( Group::CANID( Group::PROPERTY ) | ( ( id & 0x1F ) << 5 ), data, 6 );
+}
+
+int main( int argc, char** argv ){
+
+  const int n_calls = ( 1 < argc ) ? atoi( argv[1] ) : 1000000;
+  if( n_calls < 1 ){
+    fprintf( stderr, "Usage: %s [n_calls]\n", argv[0] );
+    return -1;
+  }
+
+  // Set up the pucks, groups and transmissions like on a real arm
+  barrett_sim::EmulatedWAM<barrett_model::Wam7DofModel> can( false );
+  ReplayBus bus( &can );
+  if( bus.Open() != leo_can::CANBus::ESUCCESS ){
+    fprintf( stderr, "Failed to open the emulated bus\n" );
+    return -1;
+  }
+  WAM wam_robot( &bus );
+  if( wam_robot.Initialize() != WAM::ESUCCESS ){
+    fprintf( stderr, "Failed to initialize the WAM\n" );
+    return -1;
+  }
+
+  printf( "calls: %d\n", n_calls );
+
+  double checksum = 0.0;
+  Puck puck( Puck::PUCK_ID1, &bus, false );
+
+  // Replies from the first puck
+  const leo_can::CANBusFrame position_frame = position_reply( puck.GetID(), -123456 );
+  const leo_can::CANBusFrame property_frame = property_reply( puck.GetID(), Barrett::MODE, Puck::MODE_TORQUE );
+  Barrett::ID propid;
+  Barrett::Value value;
+
+  bus.Replay( std::vector<leo_can::CANBusFrame>( 1, property_frame ) );
+
+  {
+    Measurement m( "Puck::SetProperty (discarded)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      checksum += puck.SetProperty( Barrett::MODE, c & 0xFF, false );
+    }
+  }
+
+  {
+    Measurement m( "Puck::GetProperty (replayed)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      puck.GetProperty( Barrett::MODE, value );
+      checksum += value;
+    }
+  }
+
+  {
+    Measurement m( "Puck::UnpackCANFrame (position)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      puck.UnpackCANFrame( position_frame, propid, value );
+      checksum += value;
+    }
+  }
+
+  {
+    Measurement m( "Puck::UnpackCANFrame (property)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      puck.UnpackCANFrame( property_frame, propid, value );
+      checksum += value;
+    }
+  }
+
+  {
+    Eigen::VectorXd jt = Eigen::VectorXd::LinSpaced( 7, -5.0, 5.0 );
+    Measurement m( "WAM::SetTorques (discarded)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      jt[0] = 1E-3*( c & 0x0FFF );
+      checksum += wam_robot.SetTorques( jt );
+    }
+  }
+
+  {
+    // The replies of the upper arm and then of the forearm pucks to their
+    // position queries
+    std::vector<leo_can::CANBusFrame> replies;
+    for( int id=Puck::PUCK_ID1; id<=Puck::PUCK_ID7; id++ ){
+      replies.push_back( position_reply( (Puck::ID)id, 1000*(Barrett::Value)id - 1500 ) );
+    }
+    bus.Replay( replies );
+
+    Eigen::VectorXd q( 7 );
+    Measurement m( "WAM::GetPositions (replayed)", n_calls );
+    for( int c=0; c<n_calls; c++ ){
+      wam_robot.GetPositions( q );
+      checksum += q[c % 7];
+    }
+  }
+
+  printf( "checksum: %g\n", checksum );
+
+  return 0;
+}
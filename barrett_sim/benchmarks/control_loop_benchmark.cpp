@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Times the whole control loop of the barrett_direct WAM driver: reading
+ * the joint positions, computing the torques and writing them, against an
+ * emulated CAN bus whose pucks reply after a configurable latency.
+ *
+ * The controller is gravity compensation with a PD hold of the parked
+ * position. Each cycle is split into its read, update and write, and the
+ * time spent in the emulated bus is taken out of the read and write, so
+ * they measure the driver alone. The period is measured on the bus clock,
+ * which is the wall clock in real-time mode. Memory allocations are counted
+ * separately for the loop and for the emulated bus.
+ *
+ * Faults can be injected into the traffic once the WAM is initialized, as
+ * a comma-separated list of key=value pairs, e.g. delay=300,spike_rate=0.01
+ * or drop=0.001,puck=3. The keys are delay, jitter and spike [us],
+ * spike_rate, drop, duplicate, reorder and bit_error, which are the
+ * fields of FaultInjectingCANBus::Faults, and puck and seed. Without puck,
+ * every puck has the faults. With skip_stale=1, the driver's groups skip
+ * the replies left from earlier queries, see Group::SkipStaleReplies.
+ * Failed reads and writes are then counted instead of stopping the loop,
+ * and the positions read are compared to the simulated arm to see whether
+ * the driver recovers.
+ *
+ * The results are printed as one JSON object, with times in microseconds.
+ *
+ * Usage: control_loop_benchmark [realtime|virtual] [duration] [latency_us] [faults]
+ */
+
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+#include <barrett_direct/WAM.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <barrett_sim/emulated_wam_bus.h>
+#include <barrett_sim/fault_injecting_can_bus.h>
+#include <barrett_sim/parked_hold.h>
+
+#include "allocation_counter.h"
+
+using namespace barrett_direct;
+
+typedef barrett_model::Wam7DofModel Model;
+typedef Model::JointVector JointVector;
+
+static const int WARMUP_CYCLES = 100;
+static const size_t MAX_SAMPLES = 1<<20;
+
+static double wall_time(){
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + 1E-9*ts.tv_nsec;
+}
+
+//! A bus which measures the time spent and the allocations made in another
+class TimedCANBus : public leo_can::CANBus
+{
+public:
+  TimedCANBus( leo_can::CANBus* backend ) :
+    leo_can::CANBus( leo_can::CANBus::RATE_1000 ),
+    bus_time( 0.0 ),
+    bus_allocations( 0 ),
+    backend( backend ),
+    enter_allocations( 0 )
+  { }
+
+  virtual leo_can::CANBus::Errno Open() { return backend->Open(); }
+  virtual leo_can::CANBus::Errno Close() { return backend->Close(); }
+  virtual leo_can::CANBus::Errno AddFilter( const leo_can::CANBus::Filter& filter )
+  { return backend->AddFilter( filter ); }
+
+  virtual leo_can::CANBus::Errno Send( const leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT ){
+    const double start = Enter();
+    const leo_can::CANBus::Errno result = backend->Send( frame, flags );
+    Leave( start );
+    return result;
+  }
+
+  virtual leo_can::CANBus::Errno Recv( leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT ){
+    const double start = Enter();
+    const leo_can::CANBus::Errno result = backend->Recv( frame, flags );
+    Leave( start );
+    return result;
+  }
+
+  //! The wall time [s] spent in the bus so far
+  double bus_time;
+  //! The allocations made in the bus so far
+  unsigned long bus_allocations;
+
+private:
+  leo_can::CANBus* backend;
+  unsigned long enter_allocations;
+
+  double Enter(){
+    enter_allocations = barrett_sim::allocations();
+    return wall_time();
+  }
+  void Leave( double start ){
+    bus_time += wall_time() - start;
+    bus_allocations += barrett_sim::allocations() - enter_allocations;
+  }
+};
+
+//! Faults injected into the emulated bus, whose delays follow its clock
+class EmulatedFaults : public barrett_sim::FaultInjectingCANBus
+{
+public:
+  EmulatedFaults( barrett_sim::EmulatedWAMBus& can ) :
+    barrett_sim::FaultInjectingCANBus( &can ),
+    can( can )
+  { }
+
+protected:
+  virtual double Now() { return can.GetTime(); }
+  virtual void Delay( double seconds ) { can.Sleep( seconds ); }
+
+private:
+  barrett_sim::EmulatedWAMBus& can;
+};
+
+//! Parse the faults, e.g. delay=300,drop=0.001,puck=3
+static bool parse_faults( const std::string& spec,
+    barrett_sim::FaultInjectingCANBus::Faults& faults, int& puck, unsigned long& seed,
+    bool& skip_stale )
+{
+  size_t begin = 0;
+  while( begin < spec.size() ){
+    size_t end = spec.find( ',', begin );
+    if( end == std::string::npos )
+    { end = spec.size(); }
+    const std::string pair = spec.substr( begin, end-begin );
+    begin = end+1;
+
+    const size_t equal = pair.find( '=' );
+    if( equal == std::string::npos )
+    { return false; }
+    const std::string key = pair.substr( 0, equal );
+    const double value = atof( pair.substr( equal+1 ).c_str() );
+
+    if( key == "delay" ) { faults.latency = 1E-6*value; }
+    else if( key == "jitter" ) { faults.jitter = 1E-6*value; }
+    else if( key == "spike" ) { faults.spike_latency = 1E-6*value; }
+    else if( key == "spike_rate" ) { faults.spike_rate = value; }
+    else if( key == "drop" ) { faults.drop_rate = value; }
+    else if( key == "duplicate" ) { faults.duplicate_rate = value; }
+    else if( key == "reorder" ) { faults.reorder_rate = value; }
+    else if( key == "bit_error" ) { faults.bit_error_rate = value; }
+    else if( key == "puck" ) { puck = (int)value; }
+    else if( key == "seed" ) { seed = (unsigned long)value; }
+    else if( key == "skip_stale" ) { skip_stale = ( value != 0.0 ); }
+    else { return false; }
+  }
+  return true;
+}
+
+//! Distribution of a per-cycle time
+struct Samples
+{
+  std::vector<double> values;
+
+  void reserve( size_t n ) { values.reserve( n ); }
+  void record( double seconds ) { values.push_back( 1E6*seconds ); }
+
+  void print( const char* name, bool last ){
+    std::vector<double> sorted( values );
+    std::sort( sorted.begin(), sorted.end() );
+    const size_t n = sorted.size();
+    double sum = 0.0;
+    for( size_t i=0; i<n; i++ )
+    { sum += sorted[i]; }
+    printf( "    \"%s\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}%s\n",
+        name, ( 0 < n ) ? sum/n : 0.0,
+        percentile( sorted, 0.5 ), percentile( sorted, 0.9 ),
+        percentile( sorted, 0.99 ), percentile( sorted, 0.999 ),
+        ( 0 < n ) ? sorted[n-1] : 0.0,
+        last ? "" : "," );
+  }
+
+  static double percentile( const std::vector<double>& sorted, double p ){
+    if( sorted.empty() )
+    { return 0.0; }
+    return sorted[ std::min( sorted.size()-1, (size_t)( p*sorted.size() ) ) ];
+  }
+};
+
+int main( int argc, char** argv ){
+
+  bool realtime = false;
+  if( 1 < argc ){
+    if( strcmp( argv[1], "realtime" ) == 0 )
+    { realtime = true; }
+    else if( strcmp( argv[1], "virtual" ) != 0 ){
+      fprintf( stderr, "Usage: %s [realtime|virtual] [duration] [latency_us] [faults]\n", argv[0] );
+      return -1;
+    }
+  }
+  const double duration = ( 2 < argc ) ? atof( argv[2] ) : 10.0;
+  const double latency = ( 3 < argc ) ? 1E-6*atof( argv[3] ) : 50E-6;
+  const std::string fault_spec = ( 4 < argc ) ? argv[4] : "";
+
+  barrett_sim::FaultInjectingCANBus::Faults faults;
+  int fault_puck = -1;
+  unsigned long seed = 0;
+  bool skip_stale = false;
+  if( !parse_faults( fault_spec, faults, fault_puck, seed, skip_stale ) ){
+    fprintf( stderr, "Could not parse the faults: %s\n", fault_spec.c_str() );
+    return -1;
+  }
+
+  // The same controller as wam_direct_sim
+  barrett_sim::ParkedHold hold;
+
+  barrett_sim::EmulatedWAM<Model> can( realtime );
+  can.SetReplyLatency( latency );
+  hold.Park( can );
+  if( can.Open() != leo_can::CANBus::ESUCCESS ){
+    fprintf( stderr, "Failed to open the emulated bus\n" );
+    return -1;
+  }
+
+  // The driver talks to the emulated pucks through the faults
+  EmulatedFaults faulty( can );
+  faulty.SetSeed( seed );
+  TimedCANBus timed( &faulty );
+
+  WAM wam_robot( &timed );
+  Eigen::VectorXd q_init( hold.GetParkedPositions() );
+  if( wam_robot.Initialize() != WAM::ESUCCESS ||
+      wam_robot.SetPositions( q_init ) != WAM::ESUCCESS ||
+      wam_robot.SetMode( Puck::MODE_TORQUE ) != WAM::ESUCCESS ){
+    fprintf( stderr, "Failed to initialize the WAM\n" );
+    return -1;
+  }
+  hold.Activate( can );
+
+  // The emulated bus returns at once when receiving with MSG_NOBLOCK
+  wam_robot.SkipStaleReplies( skip_stale );
+
+  if( 0 <= fault_puck )
+  { faulty.SetFaults( fault_puck, faults ); }
+  else
+  { faulty.SetFaults( faults ); }
+
+  Eigen::VectorXd q( 7 ), q_prev( q_init ), tau( 7 );
+
+  Samples period, read, update, write;
+  period.reserve( MAX_SAMPLES );
+  read.reserve( MAX_SAMPLES );
+  update.reserve( MAX_SAMPLES );
+  write.reserve( MAX_SAMPLES );
+
+  unsigned long cycles = 0, sent_start = 0, received_start = 0;
+  unsigned long allocations_start = 0, bus_allocations_start = 0;
+  unsigned long failed_reads = 0, failed_writes = 0, failed_streak = 0, max_failed_streak = 0;
+  double max_error = 0.0;
+  double start = 0.0, busy_start = 0.0;
+  double t_prev = can.GetTime();
+
+  for( int c=0; ; c++ ){
+
+    // Start measuring after the warm-up
+    if( c == WARMUP_CYCLES ){
+      start = can.GetTime();
+      sent_start = can.GetSentFrames();
+      received_start = can.GetReceivedFrames();
+      busy_start = can.GetBusyTime();
+      bus_allocations_start = timed.bus_allocations;
+      allocations_start = barrett_sim::allocations();
+      barrett_sim::start_counting_allocations();
+    }
+    const bool measured = ( WARMUP_CYCLES <= c );
+    if( measured && ( duration <= can.GetTime() - start || MAX_SAMPLES <= period.values.size() ) )
+    { break; }
+
+    const double t = can.GetTime();
+    const double dt = t - t_prev;
+    t_prev = t;
+
+    // Read
+    double bus_start = timed.bus_time;
+    const double read_start = wall_time();
+    const bool read_ok = ( wam_robot.GetPositions( q ) == WAM::ESUCCESS );
+    const double read_time = wall_time() - read_start - ( timed.bus_time - bus_start );
+
+    // Keep going with the last positions, and see if the next reads are
+    // right again
+    if( !read_ok ){
+      q = q_prev;
+      if( measured )
+      { failed_reads++; }
+    }
+    else if( measured )
+    { max_error = std::max( max_error, ( JointVector( q ) - can.GetSim().getPositions() ).cwiseAbs().maxCoeff() ); }
+
+    // Update
+    const double update_start = wall_time();
+    q_prev = q;
+    hold.Update( q, dt, tau );
+    const double update_time = wall_time() - update_start;
+
+    // Write
+    bus_start = timed.bus_time;
+    const double write_start = wall_time();
+    const bool write_ok = ( wam_robot.SetTorques( tau ) == WAM::ESUCCESS );
+    const double write_time = wall_time() - write_start - ( timed.bus_time - bus_start );
+
+    if( measured ){
+      // The samples have been reserved, so recording doesn't allocate
+      if( WARMUP_CYCLES < c )
+      { period.record( dt ); }
+      read.record( read_time );
+      update.record( update_time );
+      write.record( write_time );
+      cycles++;
+
+      if( !write_ok )
+      { failed_writes++; }
+      failed_streak = ( read_ok && write_ok ) ? 0 : failed_streak+1;
+      max_failed_streak = std::max( max_failed_streak, failed_streak );
+    }
+  }
+  barrett_sim::stop_counting_allocations();
+  const unsigned long bus_allocations = timed.bus_allocations - bus_allocations_start;
+  const unsigned long loop_allocations = barrett_sim::allocations() - allocations_start - bus_allocations;
+
+  if( cycles == 0 ){
+    fprintf( stderr, "No cycles were measured\n" );
+    return -1;
+  }
+
+  const double elapsed = can.GetTime() - start;
+  printf( "{\n" );
+  printf( "  \"benchmark\": \"control_loop\",\n" );
+  printf( "  \"mode\": \"%s\",\n", realtime ? "realtime" : "virtual" );
+  printf( "  \"latency_us\": %.3f,\n", 1E6*latency );
+  printf( "  \"faults\": \"%s\",\n", fault_spec.c_str() );
+  printf( "  \"duration\": %.6f,\n", elapsed );
+  printf( "  \"cycles\": %lu,\n", cycles );
+  printf( "  \"cycle_us\": {\n" );
+  period.print( "period", false );
+  read.print( "read", false );
+  update.print( "update", false );
+  write.print( "write", true );
+  printf( "  },\n" );
+  printf( "  \"allocations_per_cycle\": {\"loop\": %.3f, \"bus\": %.3f},\n",
+      (double)loop_allocations/cycles, (double)bus_allocations/cycles );
+  printf( "  \"frames_per_cycle\": {\"sent\": %.3f, \"received\": %.3f},\n",
+      (double)( can.GetSentFrames() - sent_start )/cycles,
+      (double)( can.GetReceivedFrames() - received_start )/cycles );
+  printf( "  \"bus_load\": %.4f,\n", ( can.GetBusyTime() - busy_start )/elapsed );
+  printf( "  \"injected_frames\": {\"delayed\": %lu, \"dropped\": %lu, \"duplicated\": %lu, \"reordered\": %lu, \"corrupted\": %lu},\n",
+      faulty.GetDelayedFrames(), faulty.GetDroppedFrames(), faulty.GetDuplicatedFrames(),
+      faulty.GetReorderedFrames(), faulty.GetCorruptedFrames() );
+  printf( "  \"failures\": {\"reads\": %lu, \"writes\": %lu, \"max_consecutive\": %lu},\n",
+      failed_reads, failed_writes, max_failed_streak );
+  printf( "  \"max_position_error_rad\": %g\n", max_error );
+  printf( "}\n" );
+
+  return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_EMULATED_WAM_BUS_H
+#define __BARRETT_SIM_EMULATED_WAM_BUS_H
+
+#include <deque>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <leo_can/CANBus.h>
+
+#include <barrett_direct/Barrett.h>
+#include <barrett_direct/Puck.h>
+
+#include <barrett_sim/sim_wam.h>
+
+namespace barrett_sim {
+
+  /** \brief A CAN bus with the pucks and the safety module of a WAM on it
+   *
+   * This answers the frames sent by \c barrett_direct like the pucks of a
+   * real WAM would, so the driver's property codec, group queries and
+   * transmission math run unchanged against a simulated arm:
+   *
+   *  - Property queries and writes to a puck or to the safety module are
+   *    answered from a table of properties, with replies addressed to the
+   *    property feedback group.
+   *  - Position queries to the upper arm and forearm position groups are
+   *    answered by each puck of the group with its 22-bit encoder count.
+   *    Setting \c POS offsets the count like on the real pucks.
+   *  - Current frames to the upper arm and forearm torque groups set the
+   *    currents of the pucks which are in torque mode, which are converted
+   *    to motor torques with each puck's \c IPNM and to joint torques
+   *    through the cable transmissions.
+   *
+   * The frames take as long as they would on the bus: each one occupies it
+   * for the time its bits take at the bit rate, and the pucks start their
+   * replies a fixed latency after they receive a query. In real-time mode
+   * \ref Recv waits until a reply would have arrived, and the dynamics
+   * follow the wall clock. Otherwise the time only advances with the
+   * traffic on the bus, and the emulation runs as fast as it can. With \c
+   * MSG_NOBLOCK, \ref Recv only returns the replies which have already
+   * arrived.
+   *
+   * The dynamics are integrated by a subclass, e.g. \ref EmulatedWAM.
+   */
+  class EmulatedWAMBus : public leo_can::CANBus
+  {
+  public:
+
+    //! Create the pucks of a 4-DOF or 7-DOF WAM
+    EmulatedWAMBus( size_t n_joints, bool realtime );
+    virtual ~EmulatedWAMBus();
+
+    virtual leo_can::CANBus::Errno Open();
+    virtual leo_can::CANBus::Errno Close();
+    virtual leo_can::CANBus::Errno Send( const leo_can::CANBusFrame& frame,
+        leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT );
+    virtual leo_can::CANBus::Errno Recv( leo_can::CANBusFrame& frame,
+        leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT );
+    virtual leo_can::CANBus::Errno AddFilter( const leo_can::CANBus::Filter& filter );
+
+    //! Set the bit rate [bit/s] of the bus
+    void SetBitRate( double bitrate );
+    //! Set the time [s] a puck takes to start replying to a query
+    void SetReplyLatency( double latency );
+    //! Set the longest time step [s] of the dynamics
+    void SetMaxStep( double step );
+    //! Set the current per Nm of motor torque of the puck of a joint
+    void SetIpNm( size_t joint, barrett_direct::Barrett::Value ipnm );
+    //! Set the magnetic encoder count of the motor of a joint at its zero
+    void SetMechanicalPhase( size_t joint, barrett_direct::Barrett::Value phase );
+
+    //! The emulated time [s] since the bus was opened
+    double GetTime() const;
+    //! Let time pass [s] without any traffic on the bus
+    void Sleep( double seconds );
+    //! The time [s] the bus has been busy since it was opened
+    double GetBusyTime() const { return busytime; }
+    //! The number of frames sent by the host
+    unsigned long GetSentFrames() const { return sentframes; }
+    //! The number of frames received by the host
+    unsigned long GetReceivedFrames() const { return receivedframes; }
+
+    size_t GetNumJoints() const { return njoints; }
+
+    //! The motor positions [rad] for joint positions [rad]
+    Eigen::VectorXd JointsPos2MotorsPos( const Eigen::VectorXd& jq ) const
+    { return jpos2mpos*jq; }
+    //! The joint torques [Nm] for motor torques [Nm]
+    Eigen::VectorXd MotorsTrq2JointsTrq( const Eigen::VectorXd& mt ) const
+    { return jpos2mpos.transpose()*mt; }
+
+  protected:
+
+    //! Apply joint torques [Nm] for a duration [s]
+    virtual void StepDynamics( const Eigen::VectorXd& jt, double duration ) = 0;
+    //! The joint positions [rad] of the arm
+    virtual void GetJointPositions( Eigen::VectorXd& jq ) const = 0;
+
+  private:
+
+    struct EmulatedPuck {
+      barrett_direct::Puck::ID id;
+      std::vector<barrett_direct::Barrett::Value> properties;
+      // Encoder count at the zero motor position
+      double countoffset;
+      // Latest current commanded by the host
+      barrett_direct::Barrett::Value current;
+    };
+
+    struct PendingFrame {
+      leo_can::CANBusFrame frame;
+      // When the last bit of the frame is on the bus
+      double arrival;
+    };
+
+    size_t njoints;
+    bool realtime;
+    bool opened;
+
+    std::vector<EmulatedPuck> pucks;
+    EmulatedPuck safetymodule;
+
+    // Motor positions are jpos2mpos times joint positions
+    Eigen::MatrixXd jpos2mpos;
+
+    // Bus timing
+    double bitrate;
+    double latency;
+    double maxstep;
+    double virtualtime;
+    double bustime;
+    double busytime;
+    double dynamicstime;
+    double openwalltime;
+
+    std::deque<PendingFrame> pending;
+    std::vector<leo_can::CANBus::Filter> filters;
+
+    unsigned long sentframes;
+    unsigned long receivedframes;
+
+    // Workspace
+    Eigen::VectorXd jq, mq, mt, jt;
+    std::vector<EmulatedPuck*> members;
+
+    static double WallTime();
+    void Advance( double time );
+    double Transmit( double start, const leo_can::CANBusFrame& frame );
+    bool PassesFilters( const leo_can::CANBusFrame& frame ) const;
+
+    EmulatedPuck* FindPuck( barrett_direct::Puck::ID id );
+    void HandleGroupFrame( double received, const leo_can::CANBusFrame& frame );
+    void HandlePuckFrame( double received, EmulatedPuck& puck, const leo_can::CANBusFrame& frame );
+    void ReplyProperty( double received, const EmulatedPuck& puck, barrett_direct::Barrett::ID propid );
+    void ReplyPosition( double received, const EmulatedPuck& puck );
+    void SetPosition( EmulatedPuck& puck, barrett_direct::Barrett::Value count );
+  };
+
+  /** \brief An emulated WAM bus whose arm is simulated with a \ref SimWam
+   *
+   * \c Model is the generated model of the arm, with 4 or 7 joints.
+   */
+  template <class Model>
+  class EmulatedWAM : public EmulatedWAMBus
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef typename Model::JointVector JointVector;
+
+    EmulatedWAM( bool realtime ) :
+      EmulatedWAMBus( Model::N_DOF, realtime )
+    { }
+
+    //! The simulated arm, e.g. to set its initial state and joint stops
+    SimWam<Model>& GetSim() { return sim; }
+
+  protected:
+
+    virtual void StepDynamics( const Eigen::VectorXd& jt, double duration ) {
+      efforts = jt;
+      sim.step( efforts, duration );
+    }
+
+    virtual void GetJointPositions( Eigen::VectorXd& jq ) const {
+      jq = sim.getPositions();
+    }
+
+  private:
+    SimWam<Model> sim;
+    JointVector efforts;
+  };
+
+}
+
+#endif // ifndef __BARRETT_SIM_EMULATED_WAM_BUS_H
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_FAULT_INJECTING_CAN_BUS_H
+#define __BARRETT_SIM_FAULT_INJECTING_CAN_BUS_H
+
+#include <vector>
+
+#include <leo_can/CANBus.h>
+
+namespace barrett_sim {
+
+  /** \brief A CAN bus which injects faults into the traffic of another bus
+   *
+   * This wraps any leo_can::CANBus, real or emulated, and forwards the
+   * frames through it. The frames coming from the pucks can be delayed,
+   * dropped, duplicated, reordered or corrupted. Frames sent to a puck can
+   * be dropped, so that the puck never sees them. The faults of each puck
+   * are set with \ref SetFaults, by the 5-bit puck ID in the frame IDs, and
+   * are drawn from a seeded generator so a run can be repeated.
+   *
+   * Each frame from a puck is delivered once its delay has passed since it
+   * arrived from the backend. While a frame is waited for, the frames which
+   * arrive in the meantime are taken from the backend with \c MSG_NOBLOCK,
+   * so the delays of the replies to one query overlap like they would on
+   * the bus, instead of adding up. The time is read with \ref Now and waited
+   * for with \ref Delay, which use the wall clock. A bus with its own clock,
+   * like an EmulatedWAMBus in virtual mode, can be kept in step by
+   * overriding both.
+   *
+   * A frame is reordered by holding it back until the next frame has
+   * arrived from the backend, for at most about the time a frame takes on a
+   * 1 Mbit/s bus. The last reply to a query has no next frame, so it's
+   * delivered late instead.
+   */
+  class FaultInjectingCANBus : public leo_can::CANBus
+  {
+  public:
+
+    //! The faults injected into the frames of a puck
+    struct Faults {
+      Faults();
+
+      //! Delay [s] of every frame from the puck
+      double latency;
+      //! Largest additional delay [s], drawn uniformly for each frame
+      double jitter;
+      //! Probability that a frame is delayed by a spike
+      double spike_rate;
+      //! Additional delay [s] of a spike
+      double spike_latency;
+
+      //! Probability that a frame is lost, in either direction
+      double drop_rate;
+      //! Probability that a frame from the puck is received twice
+      double duplicate_rate;
+      //! Probability that a frame from the puck is received after the next
+      double reorder_rate;
+      //! Probability that one bit of a frame from the puck is flipped
+      double bit_error_rate;
+    };
+
+    //! Largest puck ID, the IDs have 5 bits
+    static const size_t MAX_PUCK_ID = 31;
+
+    FaultInjectingCANBus( leo_can::CANBus* backend,
+        leo_can::CANBus::Rate rate = leo_can::CANBus::RATE_1000 );
+    virtual ~FaultInjectingCANBus();
+
+    virtual leo_can::CANBus::Errno Open();
+    virtual leo_can::CANBus::Errno Close();
+    virtual leo_can::CANBus::Errno Send( const leo_can::CANBusFrame& frame,
+        leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT );
+    virtual leo_can::CANBus::Errno Recv( leo_can::CANBusFrame& frame,
+        leo_can::CANBus::Flags flags = leo_can::CANBus::MSG_DEFAULT );
+    virtual leo_can::CANBus::Errno AddFilter( const leo_can::CANBus::Filter& filter );
+
+    //! Set the faults of every puck
+    void SetFaults( const Faults& faults );
+    //! Set the faults of one puck
+    void SetFaults( size_t puckid, const Faults& faults );
+    //! Restart the generator of the faults
+    void SetSeed( unsigned long seed );
+
+    //! Forget the frames which haven't been delivered yet
+    void Flush();
+
+    unsigned long GetDelayedFrames() const { return delayed; }
+    unsigned long GetDroppedFrames() const { return dropped; }
+    unsigned long GetDuplicatedFrames() const { return duplicated; }
+    unsigned long GetReorderedFrames() const { return reordered; }
+    unsigned long GetCorruptedFrames() const { return corrupted; }
+    //! The total delay [s] added to the frames
+    double GetTotalDelay() const { return totaldelay; }
+
+  protected:
+
+    //! The time [s], which the delays of the frames are counted in
+    virtual double Now();
+    //! Let time pass [s] while a frame is delayed
+    virtual void Delay( double seconds );
+
+  private:
+
+    struct HeldFrame {
+      leo_can::CANBusFrame frame;
+      // When it's delivered, its arrival from the backend plus its delay
+      double deadline;
+      // Whether it's delivered after the next frame
+      bool reorder;
+    };
+
+    leo_can::CANBus* backend;
+    std::vector<Faults> faults;
+
+    // Frames received from the backend which haven't been delivered yet, in
+    // the order they arrived, from held[next]. It's emptied once they have
+    // all been delivered, so it doesn't allocate once it's big enough.
+    std::vector<HeldFrame> held;
+    size_t next;
+
+    unsigned long long state;
+
+    unsigned long delayed;
+    unsigned long dropped;
+    unsigned long duplicated;
+    unsigned long reordered;
+    unsigned long corrupted;
+    double totaldelay;
+
+    //! A uniform random number in [0, 1)
+    double Uniform();
+    bool Happens( double rate );
+    leo_can::CANBusFrame FlipBit( const leo_can::CANBusFrame& frame );
+
+    //! Receive a frame from the backend, without the frames lost on the way
+    leo_can::CANBus::Errno Receive( leo_can::CANBusFrame& frame, leo_can::CANBus::Flags flags );
+    //! Hold a frame which has just arrived, with its delay and faults
+    void Hold( const leo_can::CANBusFrame& frame );
+    //! Hold the frames which have already arrived at the backend
+    void Poll();
+    //! Wait until a time [s], or until there are \c n frames held
+    void Wait( double time, size_t n );
+  };
+
+}
+
+#endif // ifndef __BARRETT_SIM_FAULT_INJECTING_CAN_BUS_H
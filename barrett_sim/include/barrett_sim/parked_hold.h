@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_PARKED_HOLD_H
+#define __BARRETT_SIM_PARKED_HOLD_H
+
+#include <cmath>
+
+#include <Eigen/Dense>
+
+#include <barrett_model/wam_7dof_model.h>
+
+#include <barrett_sim/emulated_wam_bus.h>
+
+namespace barrett_sim {
+
+  /** \brief The controller which holds an emulated 7-DOF WAM parked
+   *
+   * This is the loop \c wam_direct_sim and \c control_loop_benchmark run on
+   * the \c barrett_direct driver: gravity compensation and a PD hold of the
+   * parked position, with the velocity differentiated from the positions
+   * read on each cycle.
+   *
+   * The real parked arm rests on its stops until the pucks are activated.
+   * The simulated one has no stops there, so \ref Park turns gravity off,
+   * to keep it from falling while the driver initializes, and \ref Activate
+   * turns it back on once the pucks are in torque mode.
+   */
+  class ParkedHold
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef barrett_model::Wam7DofModel Model;
+    typedef Model::JointVector JointVector;
+
+    ParkedHold() :
+      gravity_vector( 0.0, 0.0, -9.81 )
+    {
+      q_park << 0.0, -M_PI_2, 0.0, M_PI, 0.0, 0.0, 0.0;
+      kp << 100.0, 100.0, 50.0, 50.0, 10.0, 10.0, 2.0;
+      kd << 10.0, 10.0, 2.0, 2.0, 0.2, 0.2, 0.05;
+      q_prev = q_park;
+    }
+
+    //! The parked position, where the encoders are zeroed
+    const JointVector& GetParkedPositions() const { return q_park; }
+
+    //! Put the emulated arm at rest in the parked position, without gravity
+    void Park( EmulatedWAM<Model>& can ) const {
+      can.GetSim().setGravityVector( Eigen::Vector3d::Zero() );
+      can.GetSim().setDamping( JointVector::Constant( 0.1 ) );
+      can.GetSim().setState( q_park, JointVector::Zero() );
+    }
+
+    //! Turn gravity on, once the pucks hold the arm
+    void Activate( EmulatedWAM<Model>& can ) const
+    { can.GetSim().setGravityVector( gravity_vector ); }
+
+    //! The torques for the positions read after \c dt [s]
+    void Update( const Eigen::VectorXd& q, double dt, Eigen::VectorXd& tau ){
+      q_fixed = q;
+      qd = ( 0.0 < dt ) ? JointVector( ( q_fixed - q_prev )/dt ) : JointVector::Zero();
+      q_prev = q_fixed;
+
+      Model::gravity_torques( q_fixed, gravity_vector, gravity );
+      tau = gravity + kp.cwiseProduct( q_park - q_fixed ) - kd.cwiseProduct( qd );
+    }
+
+  private:
+    const Eigen::Vector3d gravity_vector;
+    JointVector q_park, kp, kd;
+
+    // Scratch, so an update doesn't allocate
+    JointVector q_fixed, q_prev, qd, gravity;
+  };
+
+}
+
+#endif // ifndef __BARRETT_SIM_PARKED_HOLD_H
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_SIM_HW_H
+#define __BARRETT_SIM_SIM_HW_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <Eigen/Dense>
+
+#include <ros/ros.h>
+#include <urdf/model.h>
+
+#include <hardware_interface/robot_hw.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/joint_command_interface.h>
+
+#include <barrett_model/semi_absolute_joint_interface.h>
+#include <barrett_model/effort_feedforward_interface.h>
+#include <barrett_model/arm_kinematics_interface.h>
+#include <barrett_model/wam_4dof_model.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <barrett_sim/sim_wam.h>
+
+namespace barrett_sim
+{
+  // The generated model of each type of WAM
+  template<size_t DOF> struct WamModel { };
+  template<> struct WamModel<4> { typedef barrett_model::Wam4DofModel Type; };
+  template<> struct WamModel<7> { typedef barrett_model::Wam7DofModel Type; };
+
+  /** \brief A simulated Barrett system, with the same ros-controls
+   * interfaces as \c BarrettHW
+   *
+   * Each WAM listed in \c product_names is configured from \c
+   * products/<name>, like on the real system: its joints are the revolute
+   * joints from \c tip_joint to the root of the URDF, and there have to be 4
+   * or 7 of them. Its dynamics come from the generated model with the same
+   * number of joints, and its joint stops from the URDF's joint limits.
+   *
+   * The joint states, effort commands, semi-absolute joint handles,
+   * feedforward efforts and arm kinematics are exposed through the same
+   * interfaces as \c BarrettHW. The encoders are offset from the true joint
+   * positions by \c encoder_errors, so the joints start uncalibrated, and
+   * the resolver angle of each joint is its true position plus \c
+   * resolver_phases, wrapped to \c resolver_ranges. These can be used to
+   * exercise a \c CalibrationController. Once all of a WAM's joints are
+   * calibrated, its offsets are burned into the encoders like \c BarrettHW
+   * does, and they stay zero until the hardware is started again.
+   *
+   * The simulation is driven by the caller: \ref write applies the efforts
+   * and integrates the dynamics over the period, and \ref read samples the
+   * result, so it runs in lockstep with the controllers and as fast as they
+   * do.
+   */
+  class SimHW : public hardware_interface::RobotHW
+  {
+  public:
+    SimHW(ros::NodeHandle nh);
+    bool configure();
+    bool start();
+    bool read(const ros::Time time, const ros::Duration period);
+    void write(const ros::Time time, const ros::Duration period);
+    void stop() { }
+    void cleanup() { }
+
+    // State structure for a simulated Wam
+    template<size_t DOF>
+      struct WamDevice
+      {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        typedef typename WamModel<DOF>::Type Model;
+
+        // Dynamics
+        SimWam<Model> sim;
+
+        // Configuration
+        std::vector<std::string> joint_names;
+        Eigen::Matrix<double,DOF,1>
+          resolver_ranges,
+          resolver_phases,
+          encoder_errors,
+          effort_limits,
+          initial_positions;
+
+        // State
+        Eigen::Matrix<double,DOF,1>
+          joint_encoder_errors,
+          joint_positions,
+          joint_calibrated_positions,
+          joint_velocities,
+          joint_effort_cmds,
+          joint_feedforward_efforts,
+          joint_total_efforts,
+          joint_offsets,
+          resolver_angles;
+
+        // Efforts applied by the environment, which bypass the effort limits
+        Eigen::Matrix<double,DOF,1> joint_external_efforts;
+
+        Eigen::Matrix<int,DOF,1> calibrated_joints;
+
+        // Kinematics, computed at most once per cycle
+        boost::shared_ptr<barrett_model::ArmKinematics> kinematics;
+
+        void set_zero() {
+          sim.setState(initial_positions, Eigen::Matrix<double,DOF,1>::Zero());
+          joint_encoder_errors = encoder_errors;
+          joint_positions.setZero();
+          joint_calibrated_positions.setZero();
+          joint_velocities.setZero();
+          joint_effort_cmds.setZero();
+          joint_feedforward_efforts.setZero();
+          joint_total_efforts.setZero();
+          joint_offsets.setZero();
+          resolver_angles.setZero();
+          joint_external_efforts.setZero();
+          calibrated_joints.setZero();
+        }
+      };
+
+    typedef WamDevice<4> WamDevice4;
+    typedef WamDevice<7> WamDevice7;
+    typedef std::map<std::string, boost::shared_ptr<WamDevice4> > Wam4Map;
+    typedef std::map<std::string, boost::shared_ptr<WamDevice7> > Wam7Map;
+
+    const Wam4Map& wam4s() const { return wam4s_; }
+    const Wam7Map& wam7s() const { return wam7s_; }
+
+  private:
+
+    // State
+    ros::NodeHandle nh_;
+    bool configured_;
+
+    // Configuration
+    urdf::Model urdf_model_;
+    Eigen::Vector3d gravity_;
+    int substeps_;
+
+    // ros-controls interface
+    hardware_interface::JointStateInterface state_interface_;
+    hardware_interface::EffortJointInterface effort_interface_;
+    barrett_model::SemiAbsoluteJointInterface semi_absolute_interface_;
+    barrett_model::EffortFeedforwardInterface feedforward_interface_;
+    barrett_model::ArmKinematicsInterface kinematics_interface_;
+
+    Wam4Map wam4s_;
+    Wam7Map wam7s_;
+
+  protected:
+
+    // The revolute joints from a tip joint to the root of the URDF, from
+    // root to tip
+    bool arm_joints(
+        const std::string &tip_joint_name,
+        std::vector<boost::shared_ptr<const urdf::Joint> > &joints);
+
+    template <size_t DOF>
+      boost::shared_ptr<SimHW::WamDevice<DOF> >
+      configure_wam(
+          const std::string &product_name,
+          const std::vector<boost::shared_ptr<const urdf::Joint> > &joints);
+
+    // Express the gravity vector in the frame of a link
+    bool link_gravity(
+        const std::string &link_name,
+        Eigen::Vector3d &gravity);
+
+    template <size_t DOF>
+      void
+      read_wam(
+          const ros::Time time,
+          const ros::Duration period,
+          boost::shared_ptr<SimHW::WamDevice<DOF> > device);
+
+    template <size_t DOF>
+      void
+      write_wam(
+          const ros::Time time,
+          const ros::Duration period,
+          boost::shared_ptr<SimHW::WamDevice<DOF> > device);
+  };
+}
+
+#endif // ifndef __BARRETT_SIM_SIM_HW_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_SIM_WAM_H
+#define __BARRETT_SIM_SIM_WAM_H
+
+#include <algorithm>
+#include <limits>
+
+#include <Eigen/Dense>
+
+namespace barrett_sim {
+
+  /** \brief Integrates the rigid-body dynamics of an arm
+   *
+   * The joint accelerations are M(q)^-1 (tau - C(q,qd) qd - g(q) - D qd +
+   * tau_stops), with the mass matrix and the Coriolis, centrifugal and
+   * gravity torques from one of the generated arm models (e.g. \c
+   * barrett_model::Wam7DofModel), and D the viscous damping of the joints.
+   *
+   * The joint stops are stiff springs and dampers which push a joint back
+   * once it has passed one of its limits, so the arm can be driven into them
+   * like the real one (e.g. to search for the limits during calibration).
+   *
+   * Each \ref step holds the torques constant and integrates with a fixed
+   * number of semi-implicit Euler substeps. It only works on fixed-size
+   * matrices, so it never allocates.
+   */
+  template <class Model>
+  class SimWam
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef typename Model::JointVector JointVector;
+    typedef typename Model::MassMatrix MassMatrix;
+
+    SimWam() :
+      gravity_(0.0, 0.0, -9.81),
+      substeps_(10)
+    {
+      lower_limits_.setConstant(-std::numeric_limits<double>::infinity());
+      upper_limits_.setConstant(std::numeric_limits<double>::infinity());
+      stop_stiffness_.setConstant(1000.0);
+      stop_damping_.setConstant(10.0);
+      damping_.setZero();
+      zero_.setZero();
+      positions_.setZero();
+      velocities_.setZero();
+      accelerations_.setZero();
+      stop_efforts_.setZero();
+    }
+
+    //! Set the gravity vector in the frame of the root link
+    void setGravityVector(const Eigen::Vector3d &gravity) { gravity_ = gravity; }
+
+    //! Set the positions [rad] of the joint stops
+    void setLimits(const JointVector &lower, const JointVector &upper) {
+      lower_limits_ = lower;
+      upper_limits_ = upper;
+    }
+
+    //! Set the stiffness [Nm/rad] and damping [Nm/(rad/s)] of the joint stops
+    void setStops(const JointVector &stiffness, const JointVector &damping) {
+      stop_stiffness_ = stiffness;
+      stop_damping_ = damping;
+    }
+
+    //! Set the viscous damping [Nm/(rad/s)] of the joints
+    void setDamping(const JointVector &damping) { damping_ = damping; }
+
+    //! Set the number of integration substeps of each step
+    void setSubsteps(const int substeps) { substeps_ = substeps > 0 ? substeps : 1; }
+
+    //! Set the joint positions [rad] and velocities [rad/s]
+    void setState(const JointVector &positions, const JointVector &velocities) {
+      positions_ = positions;
+      velocities_ = velocities;
+      accelerations_.setZero();
+      stop_efforts_.setZero();
+    }
+
+    /** \brief Apply joint torques for a duration
+     *
+     * \param efforts The joint torques [Nm]
+     * \param duration The time [s] to integrate over
+     */
+    void step(const JointVector &efforts, const double duration) {
+      const double dt = duration/substeps_;
+      for(int s=0; s<substeps_; s++) {
+        Model::mass_matrix(positions_, mass_);
+        Model::inverse_dynamics(positions_, velocities_, zero_, gravity_, bias_);
+
+        // The stops only push back, and only damp motion into them
+        for(int j=0; j<Model::N_DOF; j++) {
+          if(positions_[j] > upper_limits_[j]) {
+            stop_efforts_[j] = -stop_stiffness_[j]*(positions_[j] - upper_limits_[j])
+              - stop_damping_[j]*std::max(velocities_[j], 0.0);
+          } else if(positions_[j] < lower_limits_[j]) {
+            stop_efforts_[j] = -stop_stiffness_[j]*(positions_[j] - lower_limits_[j])
+              - stop_damping_[j]*std::min(velocities_[j], 0.0);
+          } else {
+            stop_efforts_[j] = 0.0;
+          }
+        }
+
+        torques_ = efforts - bias_ - damping_.cwiseProduct(velocities_) + stop_efforts_;
+        accelerations_ = mass_.ldlt().solve(torques_);
+
+        velocities_ += dt*accelerations_;
+        positions_ += dt*velocities_;
+      }
+    }
+
+    const JointVector& getPositions() const { return positions_; }
+    const JointVector& getVelocities() const { return velocities_; }
+    //! The accelerations [rad/s^2] of the last substep
+    const JointVector& getAccelerations() const { return accelerations_; }
+    //! The torques [Nm] applied by the joint stops in the last substep
+    const JointVector& getStopEfforts() const { return stop_efforts_; }
+
+  private:
+    Eigen::Vector3d gravity_;
+    JointVector lower_limits_, upper_limits_;
+    JointVector stop_stiffness_, stop_damping_;
+    JointVector damping_;
+    int substeps_;
+
+    // State
+    JointVector positions_, velocities_, accelerations_, stop_efforts_;
+
+    // Workspace
+    JointVector zero_, bias_, torques_;
+    MassMatrix mass_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_SIM_SIM_WAM_H
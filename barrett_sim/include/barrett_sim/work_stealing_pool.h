@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BARRETT_SIM_WORK_STEALING_POOL_H
+#define __BARRETT_SIM_WORK_STEALING_POOL_H
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace barrett_sim {
+
+  /** \brief Runs a batch of independent tasks on a fixed number of threads
+   *
+   * Each worker has its own queue, and the tasks are dealt out to them in
+   * turn before the pool is run. A worker takes tasks from the back of its
+   * own queue, and once that is empty it steals from the front of the
+   * others', so workers which get short tasks take over the remaining work
+   * of those which got long ones.
+   *
+   * Tasks can't add more tasks: \ref run returns once every queue is empty
+   * and every task has finished.
+   */
+  class WorkStealingPool
+  {
+  public:
+    //! A task, which is passed the index of the worker running it
+    typedef boost::function<void (size_t)> Task;
+
+    explicit WorkStealingPool(const size_t n_workers);
+
+    //! Queue a task for the next run
+    void push(const Task &task);
+
+    //! Run all the queued tasks, and wait for them to finish
+    void run();
+
+    size_t size() const { return queues_.size(); }
+    //! The number of tasks which were stolen during the last run
+    unsigned long steals() const { return steals_; }
+
+  private:
+    struct Queue {
+      boost::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    void work(const size_t worker);
+    bool pop(const size_t worker, Task &task);
+    bool steal(const size_t thief, Task &task);
+
+    std::vector<boost::shared_ptr<Queue> > queues_;
+    size_t next_queue_;
+    unsigned long steals_;
+  };
+
+}
+
+#endif // ifndef __BARRETT_SIM_WORK_STEALING_POOL_H
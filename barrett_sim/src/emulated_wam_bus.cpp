@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <time.h>
+
+#include <cmath>
+#include <iostream>
+
+#include <barrett_direct/Group.h>
+
+#include <barrett_sim/emulated_wam_bus.h>
+
+using namespace barrett_direct;
+
+namespace barrett_sim
+{
+  // Motor revolutions per joint revolution of the cable transmissions of a
+  // 7-DOF WAM. A 4-DOF WAM has the same first four joints.
+  static const double JPOS2MPOS[7][7] = {
+    { -42.0,    0.0,      0.0,     0.0,    0.0,   0.0,   0.0  },
+    {   0.0,   28.25,   -16.8155,  0.0,    0.0,   0.0,   0.0  },
+    {   0.0,  -28.25,   -16.8155,  0.0,    0.0,   0.0,   0.0  },
+    {   0.0,    0.0,      0.0,   -18.0,    0.0,   0.0,   0.0  },
+    {   0.0,    0.0,      0.0,     0.0,    9.48, -9.48,  0.0  },
+    {   0.0,    0.0,      0.0,     0.0,    9.48,  9.48,  0.0  },
+    {   0.0,    0.0,      0.0,     0.0,    0.0,   0.0, -14.93 }};
+
+  static const Barrett::Value COUNTS_PER_REV = 4096;
+  static const Barrett::Value DEFAULT_IPNM = 2755;
+
+  // Largest encoder count which fits in a position reply
+  static const Barrett::Value POSITION_RANGE = 0x00200000;
+
+  // Bits in a standard CAN frame, with the worst-case bit stuffing
+  static double FrameBits( leo_can::CANBusFrame::data_len_t length )
+  { return 47 + 8*length + (34 + 8*length - 1)/4; }
+
+  EmulatedWAMBus::EmulatedWAMBus( size_t n_joints, bool realtime ) :
+    leo_can::CANBus( leo_can::CANBus::RATE_1000 ),
+    njoints( n_joints ),
+    realtime( realtime ),
+    opened( false ),
+    bitrate( 1E6 ),
+    latency( 50E-6 ),
+    maxstep( 1E-3 ),
+    virtualtime( 0.0 ),
+    bustime( 0.0 ),
+    busytime( 0.0 ),
+    dynamicstime( 0.0 ),
+    openwalltime( 0.0 ),
+    sentframes( 0 ),
+    receivedframes( 0 ),
+    jq( Eigen::VectorXd::Zero( n_joints ) ),
+    mq( Eigen::VectorXd::Zero( n_joints ) ),
+    mt( Eigen::VectorXd::Zero( n_joints ) ),
+    jt( Eigen::VectorXd::Zero( n_joints ) )
+  {
+    if( njoints != 4 && njoints != 7 ){
+      std::cerr << "Only 4-DOF and 7-DOF WAMs can be emulated." << std::endl;
+      njoints = 7;
+    }
+
+    jpos2mpos.setZero( njoints, njoints );
+    for( size_t i=0; i<njoints; i++ ){
+      for( size_t j=0; j<njoints; j++ )
+      { jpos2mpos(i,j) = JPOS2MPOS[i][j]; }
+    }
+
+    // The pucks of the upper arm are in the upper arm groups, and those of
+    // the wrist in the forearm groups
+    for( size_t i=0; i<njoints; i++ ){
+      EmulatedPuck puck;
+      puck.id = (Puck::ID)( Puck::PUCK_ID1 + i );
+      puck.properties.assign( Barrett::NUM_PROPERTIES, 0 );
+      puck.properties[ Barrett::STATUS ] = Puck::STATUS_READY;
+      puck.properties[ Barrett::MODE ] = Puck::MODE_IDLE;
+      puck.properties[ Barrett::COUNTSPERREV ] = COUNTS_PER_REV;
+      puck.properties[ Barrett::IPNM ] = DEFAULT_IPNM;
+      puck.properties[ Barrett::PUCKINDEX ] = ( i < 4 ) ? i+1 : i-3;
+      puck.properties[ Barrett::GROUPA ] = ( i < 4 ) ? Group::UPPERARM : Group::FOREARM;
+      puck.properties[ Barrett::GROUPB ] = Group::POSITION;
+      puck.properties[ Barrett::GROUPC ] = ( i < 4 ) ? Group::UPPERARM_POSITION : Group::FOREARM_POSITION;
+      puck.countoffset = 0.0;
+      puck.current = 0;
+      pucks.push_back( puck );
+    }
+
+    members.reserve( pucks.size() );
+
+    safetymodule.id = Puck::SAFETY_MODULE_ID;
+    safetymodule.properties.assign( Barrett::NUM_PROPERTIES, 0 );
+    safetymodule.properties[ Barrett::STATUS ] = Puck::STATUS_READY;
+    safetymodule.countoffset = 0.0;
+    safetymodule.current = 0;
+  }
+
+  EmulatedWAMBus::~EmulatedWAMBus(){}
+
+  double EmulatedWAMBus::WallTime(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + 1E-9*ts.tv_nsec;
+  }
+
+  double EmulatedWAMBus::GetTime() const {
+    if( realtime && opened )
+    { return WallTime() - openwalltime; }
+    return virtualtime;
+  }
+
+  void EmulatedWAMBus::Sleep( double seconds ){
+    if( seconds <= 0.0 )
+    { return; }
+    if( realtime ){
+      struct timespec ts;
+      ts.tv_sec = (time_t)seconds;
+      ts.tv_nsec = (long)( 1E9*( seconds - ts.tv_sec ) );
+      nanosleep( &ts, NULL );
+    }
+    else
+    { virtualtime += seconds; }
+  }
+
+  void EmulatedWAMBus::SetBitRate( double rate ){ bitrate = rate; }
+  void EmulatedWAMBus::SetReplyLatency( double seconds ){ latency = seconds; }
+  void EmulatedWAMBus::SetMaxStep( double step ){ maxstep = step; }
+
+  void EmulatedWAMBus::SetIpNm( size_t joint, Barrett::Value ipnm ){
+    if( joint < pucks.size() )
+    { pucks[joint].properties[ Barrett::IPNM ] = ipnm; }
+  }
+
+  void EmulatedWAMBus::SetMechanicalPhase( size_t joint, Barrett::Value phase ){
+    if( joint < pucks.size() )
+    { pucks[joint].properties[ Barrett::MECHOFFSET ] = phase; }
+  }
+
+  leo_can::CANBus::Errno EmulatedWAMBus::Open(){
+    openwalltime = WallTime();
+    virtualtime = 0.0;
+    bustime = 0.0;
+    busytime = 0.0;
+    dynamicstime = 0.0;
+    sentframes = 0;
+    receivedframes = 0;
+    pending.clear();
+    opened = true;
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  leo_can::CANBus::Errno EmulatedWAMBus::Close(){
+    opened = false;
+    pending.clear();
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  leo_can::CANBus::Errno EmulatedWAMBus::AddFilter( const leo_can::CANBus::Filter& filter ){
+    filters.push_back( filter );
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  bool EmulatedWAMBus::PassesFilters( const leo_can::CANBusFrame& frame ) const {
+    if( filters.empty() )
+    { return true; }
+    for( size_t i=0; i<filters.size(); i++ ){
+      if( ( frame.GetID() & filters[i].mask ) == ( filters[i].id & filters[i].mask ) )
+      { return true; }
+    }
+    return false;
+  }
+
+  // Put a frame on the bus as soon as it is free, and return when its last
+  // bit has been sent
+  double EmulatedWAMBus::Transmit( double start, const leo_can::CANBusFrame& frame ){
+    const double duration = FrameBits( frame.GetLength() ) / bitrate;
+    bustime = std::max( start, bustime ) + duration;
+    busytime += duration;
+    return bustime;
+  }
+
+  // Integrate the dynamics up to a time, with the currents commanded so far
+  void EmulatedWAMBus::Advance( double time ){
+    double duration = time - dynamicstime;
+    if( duration <= 0.0 )
+    { return; }
+    dynamicstime = time;
+
+    for( size_t i=0; i<pucks.size(); i++ ){
+      const Barrett::Value ipnm = pucks[i].properties[ Barrett::IPNM ];
+      if( pucks[i].properties[ Barrett::MODE ] == Puck::MODE_TORQUE && ipnm != 0 )
+      { mt[i] = (double)pucks[i].current / (double)ipnm; }
+      else
+      { mt[i] = 0.0; }
+    }
+    jt.noalias() = jpos2mpos.transpose()*mt;
+
+    while( 0.0 < duration ){
+      const double step = std::min( duration, maxstep );
+      StepDynamics( jt, step );
+      duration -= step;
+    }
+  }
+
+  leo_can::CANBus::Errno EmulatedWAMBus::Send( const leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags ){
+
+    if( !opened ){
+      std::cerr << "The emulated WAM bus is not open." << std::endl;
+      return leo_can::CANBus::EFAILURE;
+    }
+
+    // The pucks act on the frame once it has been received entirely
+    const double received = Transmit( GetTime(), frame );
+    if( !realtime )
+    { virtualtime = received; }
+    sentframes++;
+
+    Advance( received );
+
+    // Frames from the host to a group or to a puck
+    if( Group::IsDestinationAGroup( frame ) )
+    { HandleGroupFrame( received, frame ); }
+    else{
+      EmulatedPuck* puck = FindPuck( Puck::DestinationID( frame ) );
+      if( puck != NULL )
+      { HandlePuckFrame( received, *puck, frame ); }
+    }
+
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+  leo_can::CANBus::Errno EmulatedWAMBus::Recv( leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags ){
+
+    while( !pending.empty() ){
+      // Without blocking, only the frames which have already arrived
+      if( ( flags & leo_can::CANBus::MSG_NOBLOCK ) && GetTime() < pending.front().arrival )
+      { return leo_can::CANBus::EFAILURE; }
+
+      const PendingFrame next = pending.front();
+      pending.pop_front();
+
+      // Wait for the frame to arrive
+      if( realtime )
+      { Sleep( next.arrival - GetTime() ); }
+      else
+      { virtualtime = std::max( virtualtime, next.arrival ); }
+
+      // Frames which don't pass the filters are still on the bus, but the
+      // host never sees them
+      if( PassesFilters( next.frame ) ){
+        frame = next.frame;
+        receivedframes++;
+        return leo_can::CANBus::ESUCCESS;
+      }
+    }
+
+    // A real bus would block until the read timed out
+    if( !( flags & leo_can::CANBus::MSG_NOBLOCK ) )
+    { std::cerr << "No reply from the emulated pucks." << std::endl; }
+    return leo_can::CANBus::EFAILURE;
+  }
+
+  EmulatedWAMBus::EmulatedPuck* EmulatedWAMBus::FindPuck( Puck::ID id ){
+    if( id == Puck::SAFETY_MODULE_ID )
+    { return &safetymodule; }
+    for( size_t i=0; i<pucks.size(); i++ ){
+      if( pucks[i].id == id )
+      { return &pucks[i]; }
+    }
+    return NULL;
+  }
+
+  void EmulatedWAMBus::HandleGroupFrame( double received, const leo_can::CANBusFrame& frame ){
+
+    const Group::ID groupid = Group::DestinationID( frame );
+    const leo_can::CANBusFrame::data_t* data = frame.GetData();
+
+    // Members of the group, in the order in which they win the arbitration
+    members.clear();
+    for( size_t i=0; i<pucks.size(); i++ ){
+      const bool upper = ( i < 4 );
+      if( groupid == Group::BROADCAST ||
+          ( upper && ( groupid == Group::UPPERARM || groupid == Group::UPPERARM_POSITION ) ) ||
+          ( !upper && ( groupid == Group::FOREARM || groupid == Group::FOREARM_POSITION ) ) )
+      { members.push_back( &pucks[i] ); }
+    }
+
+    // Packed currents, 14 bits for each puck index
+    if( ( groupid == Group::UPPERARM || groupid == Group::FOREARM ) &&
+        frame.GetLength() == 8 && data[0] == ( Barrett::TRQ | Barrett::SET_CODE ) ){
+
+      Barrett::Value values[4];
+      values[0] = ( (Barrett::Value)data[1] << 6 ) | ( data[2] >> 2 );
+      values[1] = ( (Barrett::Value)( data[2] & 0x03 ) << 12 ) | ( (Barrett::Value)data[3] << 4 ) | ( data[4] >> 4 );
+      values[2] = ( (Barrett::Value)( data[4] & 0x0F ) << 10 ) | ( (Barrett::Value)data[5] << 2 ) | ( data[6] >> 6 );
+      values[3] = ( (Barrett::Value)( data[6] & 0x3F ) << 8 ) | data[7];
+
+      for( size_t i=0; i<members.size(); i++ ){
+        const Barrett::Value index = members[i]->properties[ Barrett::PUCKINDEX ];
+        if( 1 <= index && index <= 4 ){
+          Barrett::Value current = values[ index-1 ];
+          if( current & 0x2000 )
+          { current |= ~(Barrett::Value)0x3FFF; }
+          members[i]->current = current;
+        }
+      }
+      return;
+    }
+
+    for( size_t i=0; i<members.size(); i++ )
+    { HandlePuckFrame( received, *members[i], frame ); }
+  }
+
+  void EmulatedWAMBus::HandlePuckFrame( double received, EmulatedPuck& puck, const leo_can::CANBusFrame& frame ){
+
+    const leo_can::CANBusFrame::data_t* data = frame.GetData();
+    const leo_can::CANBusFrame::data_len_t length = frame.GetLength();
+    if( length < 1 )
+    { return; }
+
+    const Barrett::ID propid = (Barrett::ID)( data[0] & 0x7F );
+    if( (size_t)propid >= puck.properties.size() )
+    { return; }
+
+    // Queries are answered after the puck's latency
+    if( !( data[0] & Barrett::SET_CODE ) ){
+      if( propid == Barrett::POS && &puck != &safetymodule )
+      { ReplyPosition( received + latency, puck ); }
+      else
+      { ReplyProperty( received + latency, puck, propid ); }
+      return;
+    }
+
+    // Writes carry a little-endian value after the property ID
+    Barrett::Value value = 0;
+    leo_can::CANBusFrame::data_len_t i;
+    for( i=0; i+2<length; i++ )
+    { value |= (Barrett::Value)data[i+2] << (i*8); }
+    // Sign-extend, shifting an unsigned mask since shifting a negative
+    // value is undefined
+    if( 0 < i && ( value & ( (Barrett::Value)1 << (i*8 - 1) ) ) )
+    { value |= (Barrett::Value)( ~(uint64_t)0 << (i*8) ); }
+
+    if( propid == Barrett::POS && &puck != &safetymodule )
+    { SetPosition( puck, value ); }
+    else
+    { puck.properties[ propid ] = value; }
+  }
+
+  void EmulatedWAMBus::ReplyProperty( double ready, const EmulatedPuck& puck, Barrett::ID propid ){
+
+    Barrett::Value value = puck.properties[ propid ];
+
+    // The magnetic encoders measure the motor angle within a revolution
+    if( propid == Barrett::MECHANGLE && &puck != &safetymodule ){
+      GetJointPositions( jq );
+      mq.noalias() = jpos2mpos*jq;
+      const size_t i = &puck - &pucks[0];
+      const double counts = COUNTS_PER_REV*mq[i]/(2.0*M_PI) + puck.properties[ Barrett::MECHOFFSET ];
+      value = (Barrett::Value)( counts - COUNTS_PER_REV*std::floor( counts/COUNTS_PER_REV ) );
+    }
+
+    // Property replies are addressed to the property feedback group
+    leo_can::CANBusFrame::data_field_t data = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+    data[0] = propid | Barrett::SET_CODE;
+    for( size_t i=2; i<6; i++ ){
+      data[i] = (leo_can::CANBusFrame::data_t)( value & 0xFF );
+      value >>= 8;
+    }
+    const leo_can::CANBusFrame::id_t id =
+      Group::CANID( Group::PROPERTY ) | ( ( puck.id & 0x1F ) << 5 );
+
+    PendingFrame reply;
+    reply.frame = leo_can::CANBusFrame( id, data, 6 );
+    reply.arrival = Transmit( ready, reply.frame );
+    pending.push_back( reply );
+  }
+
+  void EmulatedWAMBus::ReplyPosition( double ready, const EmulatedPuck& puck ){
+
+    // Sample the encoder when the query has been received
+    Advance( ready );
+    GetJointPositions( jq );
+    mq.noalias() = jpos2mpos*jq;
+    const size_t i = &puck - &pucks[0];
+    const double counts = puck.properties[ Barrett::COUNTSPERREV ]*mq[i]/(2.0*M_PI) + puck.countoffset;
+
+    // Wrap to the 22 bits of the reply
+    Barrett::Value value = (Barrett::Value)std::floor( counts );
+    value = ( ( value + POSITION_RANGE ) & ( 2*POSITION_RANGE - 1 ) ) - POSITION_RANGE;
+
+    // Position replies are addressed to the position group
+    leo_can::CANBusFrame::data_field_t data = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+    data[0] = (leo_can::CANBusFrame::data_t)( Barrett::SET_CODE | ( ( value >> 16 ) & 0x3F ) );
+    data[1] = (leo_can::CANBusFrame::data_t)( ( value >> 8 ) & 0xFF );
+    data[2] = (leo_can::CANBusFrame::data_t)( value & 0xFF );
+    const leo_can::CANBusFrame::id_t id =
+      Group::CANID( Group::POSITION ) | ( ( puck.id & 0x1F ) << 5 );
+
+    PendingFrame reply;
+    reply.frame = leo_can::CANBusFrame( id, data, 3 );
+    reply.arrival = Transmit( ready, reply.frame );
+    pending.push_back( reply );
+  }
+
+  void EmulatedWAMBus::SetPosition( EmulatedPuck& puck, Barrett::Value count ){
+    GetJointPositions( jq );
+    mq.noalias() = jpos2mpos*jq;
+    const size_t i = &puck - &pucks[0];
+    puck.countoffset = count - puck.properties[ Barrett::COUNTSPERREV ]*mq[i]/(2.0*M_PI);
+  }
+
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <barrett_sim/fault_injecting_can_bus.h>
+
+namespace barrett_sim
+{
+  // Frames sent to a group have this bit set in their ID
+  static const leo_can::CANBusFrame::id_t GROUP_CODE = 0x0400;
+  static const size_t ID_BITS = 11;
+
+  // How long [s] a reordered frame waits for the next one, about the time a
+  // frame with 8 bytes of data takes at 1 Mbit/s
+  static const double REORDER_WINDOW = 150E-6;
+  // How often [s] the backend is polled while a frame is delayed
+  static const double POLL_PERIOD = 10E-6;
+
+  // The puck which sent a frame, in the bits 5 to 9 of its ID
+  static size_t OriginID( const leo_can::CANBusFrame& frame )
+  { return ( frame.GetID() >> 5 ) & 0x1F; }
+
+  FaultInjectingCANBus::Faults::Faults() :
+    latency( 0.0 ),
+    jitter( 0.0 ),
+    spike_rate( 0.0 ),
+    spike_latency( 0.0 ),
+    drop_rate( 0.0 ),
+    duplicate_rate( 0.0 ),
+    reorder_rate( 0.0 ),
+    bit_error_rate( 0.0 )
+  { }
+
+  FaultInjectingCANBus::FaultInjectingCANBus( leo_can::CANBus* backend,
+      leo_can::CANBus::Rate rate ) :
+    leo_can::CANBus( rate ),
+    backend( backend ),
+    faults( MAX_PUCK_ID+1 ),
+    next( 0 ),
+    delayed( 0 ),
+    dropped( 0 ),
+    duplicated( 0 ),
+    reordered( 0 ),
+    corrupted( 0 ),
+    totaldelay( 0.0 )
+  {
+    SetSeed( 0 );
+    if( backend == NULL )
+    { std::cerr << "CAN device missing" << std::endl; }
+  }
+
+  FaultInjectingCANBus::~FaultInjectingCANBus(){}
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::Open(){
+    Flush();
+    return backend->Open();
+  }
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::Close(){
+    Flush();
+    return backend->Close();
+  }
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::AddFilter( const leo_can::CANBus::Filter& filter )
+  { return backend->AddFilter( filter ); }
+
+  void FaultInjectingCANBus::SetFaults( const Faults& faults ){
+    for( size_t i=0; i<this->faults.size(); i++ )
+    { this->faults[i] = faults; }
+  }
+
+  void FaultInjectingCANBus::SetFaults( size_t puckid, const Faults& faults ){
+    if( puckid < this->faults.size() )
+    { this->faults[ puckid ] = faults; }
+  }
+
+  void FaultInjectingCANBus::SetSeed( unsigned long seed ){
+    // xorshift can't start from 0
+    state = 0x9E3779B97F4A7C15ULL*( (unsigned long long)seed + 1 );
+  }
+
+  void FaultInjectingCANBus::Flush(){
+    held.clear();
+    next = 0;
+  }
+
+  double FaultInjectingCANBus::Uniform(){
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ( ( state*0x2545F4914F6CDD1DULL ) >> 11 ) * ( 1.0/9007199254740992.0 );
+  }
+
+  bool FaultInjectingCANBus::Happens( double rate )
+  { return 0.0 < rate && Uniform() < rate; }
+
+  leo_can::CANBusFrame FaultInjectingCANBus::FlipBit( const leo_can::CANBusFrame& frame ){
+
+    leo_can::CANBusFrame::data_field_t data = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+    const leo_can::CANBusFrame::data_len_t length = frame.GetLength();
+    for( leo_can::CANBusFrame::data_len_t i=0; i<length; i++ )
+    { data[i] = frame.GetData()[i]; }
+    leo_can::CANBusFrame::id_t id = frame.GetID();
+
+    // Any bit of the ID or of the data
+    const size_t bit = std::min( (size_t)( Uniform()*( ID_BITS + 8*length ) ), ID_BITS + 8*length - 1 );
+    if( bit < ID_BITS )
+    { id ^= (leo_can::CANBusFrame::id_t)( 1 << bit ); }
+    else
+    { data[ (bit-ID_BITS)/8 ] ^= (leo_can::CANBusFrame::data_t)( 1 << ( (bit-ID_BITS)%8 ) ); }
+
+    return leo_can::CANBusFrame( id, data, length );
+  }
+
+  double FaultInjectingCANBus::Now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + 1E-9*ts.tv_nsec;
+  }
+
+  void FaultInjectingCANBus::Delay( double seconds ){
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)( 1E9*( seconds - ts.tv_sec ) );
+    nanosleep( &ts, NULL );
+  }
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::Send( const leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags ){
+
+    // Frames to a puck can be lost before it sees them, the host doesn't
+    // know they were
+    if( !( frame.GetID() & GROUP_CODE ) && Happens( faults[ frame.GetID() & 0x1F ].drop_rate ) ){
+      dropped++;
+      return leo_can::CANBus::ESUCCESS;
+    }
+
+    return backend->Send( frame, flags );
+  }
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::Receive( leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags ){
+
+    while( true ){
+      const leo_can::CANBus::Errno result = backend->Recv( frame, flags );
+      if( result != leo_can::CANBus::ESUCCESS )
+      { return result; }
+
+      const Faults& f = faults[ OriginID( frame ) ];
+      if( Happens( f.drop_rate ) ){
+        dropped++;
+        continue;
+      }
+      if( Happens( f.bit_error_rate ) ){
+        frame = FlipBit( frame );
+        corrupted++;
+      }
+      return leo_can::CANBus::ESUCCESS;
+    }
+  }
+
+  void FaultInjectingCANBus::Hold( const leo_can::CANBusFrame& frame ){
+
+    const Faults& f = faults[ OriginID( frame ) ];
+
+    double delay = f.latency;
+    if( 0.0 < f.jitter )
+    { delay += f.jitter*Uniform(); }
+    if( Happens( f.spike_rate ) )
+    { delay += f.spike_latency; }
+    if( 0.0 < delay ){
+      delayed++;
+      totaldelay += delay;
+    }
+
+    HeldFrame held_frame;
+    held_frame.frame = frame;
+    held_frame.deadline = Now() + delay;
+    held_frame.reorder = Happens( f.reorder_rate );
+    held.push_back( held_frame );
+
+    // The copy arrives right after the frame
+    if( Happens( f.duplicate_rate ) ){
+      held_frame.reorder = false;
+      held.push_back( held_frame );
+      duplicated++;
+    }
+  }
+
+  void FaultInjectingCANBus::Poll(){
+    leo_can::CANBusFrame frame;
+    while( Receive( frame, leo_can::CANBus::MSG_NOBLOCK ) == leo_can::CANBus::ESUCCESS )
+    { Hold( frame ); }
+  }
+
+  void FaultInjectingCANBus::Wait( double time, size_t n ){
+    // Keep taking the frames which arrive in the meantime, so their delays
+    // run at the same time
+    for( double now = Now(); now < time && held.size() - next < n; now = Now() ){
+      Delay( std::min( POLL_PERIOD, time - now ) );
+      Poll();
+    }
+  }
+
+  leo_can::CANBus::Errno FaultInjectingCANBus::Recv( leo_can::CANBusFrame& frame,
+      leo_can::CANBus::Flags flags ){
+
+    const bool block = !( flags & leo_can::CANBus::MSG_NOBLOCK );
+
+    Poll();
+    if( held.size() == next ){
+      if( !block )
+      { return leo_can::CANBus::EFAILURE; }
+
+      leo_can::CANBusFrame received;
+      const leo_can::CANBus::Errno result = Receive( received, flags );
+      if( result != leo_can::CANBus::ESUCCESS )
+      { return result; }
+      Hold( received );
+    }
+
+    // Deliver the next frame first, if it arrives soon enough
+    if( held[next].reorder ){
+      if( block )
+      { Wait( held[next].deadline + REORDER_WINDOW, 2 ); }
+      held[next].reorder = false;
+      if( next+1 < held.size() ){
+        std::swap( held[next], held[next+1] );
+        reordered++;
+      }
+    }
+
+    if( block )
+    { Wait( held[next].deadline, std::numeric_limits<size_t>::max() ); }
+    else if( Now() < held[next].deadline )
+    { return leo_can::CANBus::EFAILURE; }
+
+    frame = held[next].frame;
+    if( ++next == held.size() )
+    { Flush(); }
+    return leo_can::CANBus::ESUCCESS;
+  }
+
+}
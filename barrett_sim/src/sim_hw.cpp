@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <barrett_sim/sim_hw.h>
+
+#include <terse_roscpp/param.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace barrett_sim
+{
+  // Joint displacement per motor revolution [rad] of a 7-DOF WAM, from its
+  // transmission ratios. A 4-DOF WAM has the same first four joints.
+  static const double WAM_RESOLVER_RANGES[7] = {
+    2.0*M_PI/42.0,
+    2.0*M_PI/28.25,
+    2.0*M_PI/28.25,
+    2.0*M_PI/18.0,
+    2.0*M_PI/9.48,
+    2.0*M_PI/9.48,
+    2.0*M_PI/14.93};
+
+  // Read a per-joint parameter, or keep its default if it isn't set
+  template <size_t DOF>
+    static bool get_joint_param(
+        ros::NodeHandle &nh,
+        const std::string &name,
+        Eigen::Matrix<double,DOF,1> &values,
+        const std::string &description)
+    {
+      using namespace terse_roscpp;
+
+      std::vector<double> values_param;
+      if(!param::get(nh, name, values_param, description)) {
+        return true;
+      }
+      if(values_param.size() != DOF) {
+        ROS_ERROR_STREAM("Parameter "<<nh.getNamespace()<<"/"<<name<<" must have "<<DOF<<" elements.");
+        return false;
+      }
+      for(size_t i=0; i<DOF; i++) {
+        values(i) = values_param[i];
+      }
+      return true;
+    }
+
+  SimHW::SimHW(ros::NodeHandle nh) :
+    nh_(nh),
+    configured_(false),
+    gravity_(0.0, 0.0, -9.81),
+    substeps_(10)
+  {
+  }
+
+  bool SimHW::configure()
+  {
+    using namespace terse_roscpp;
+    std::vector<std::string> product_names;
+
+    // Get URDF
+    std::string urdf_str;
+    param::require(nh_, "robot_description", urdf_str, "The URDF for this barrett system.");
+    if(!urdf_model_.initString(urdf_str)) {
+      ROS_ERROR("Could not parse the URDF.");
+      return false;
+    }
+
+    // Load parameters
+    param::require(nh_,"product_names",product_names, "The unique barrett product names.");
+    std::vector<double> gravity;
+    if(param::get(nh_,"gravity",gravity, "The gravity vector [m/s^2] in the frame of the URDF root link.")) {
+      if(gravity.size() != 3) {
+        ROS_ERROR("The gravity vector must have three elements.");
+        return false;
+      }
+      gravity_ = Eigen::Vector3d(gravity[0], gravity[1], gravity[2]);
+    }
+    param::get(nh_,"substeps",substeps_, "The number of integration steps in each period.");
+
+    for(std::vector<std::string>::const_iterator it = product_names.begin();
+        it != product_names.end();
+        ++it)
+    {
+      const std::string &product_name = *it;
+      ros::NodeHandle product_nh(nh_,"products/"+product_name);
+
+      std::string product_type;
+      param::require(product_nh,"type",product_type, "Barrett product type [wam,bhand].");
+      if(product_type != "wam") {
+        ROS_ERROR_STREAM("Barrett product type "<<product_type<<" can't be simulated.");
+        continue;
+      }
+
+      std::string tip_joint_name;
+      param::require(product_nh,"tip_joint",tip_joint_name, "WAM tip joint name in URDF.");
+      std::vector<boost::shared_ptr<const urdf::Joint> > joints;
+      if(!this->arm_joints(tip_joint_name, joints)) {
+        return false;
+      }
+
+      // The number of joints selects the type of arm
+      if(joints.size() == 4) {
+        wam4s_[product_name] = this->configure_wam<4>(product_name, joints);
+        if(!wam4s_[product_name]) {
+          return false;
+        }
+      } else if(joints.size() == 7) {
+        wam7s_[product_name] = this->configure_wam<7>(product_name, joints);
+        if(!wam7s_[product_name]) {
+          return false;
+        }
+      } else {
+        ROS_ERROR_STREAM("WAM "<<product_name<<" has "<<joints.size()<<" joints, only 4-DOF and 7-DOF WAMs can be simulated.");
+        return false;
+      }
+    }
+
+    // Register ros-controls interfaces
+    this->registerInterface(&state_interface_);
+    this->registerInterface(&effort_interface_);
+    this->registerInterface(&semi_absolute_interface_);
+    this->registerInterface(&feedforward_interface_);
+    this->registerInterface(&kinematics_interface_);
+
+    configured_ = true;
+
+    return true;
+  }
+
+  bool SimHW::arm_joints(
+      const std::string &tip_joint_name,
+      std::vector<boost::shared_ptr<const urdf::Joint> > &joints)
+  {
+    boost::shared_ptr<const urdf::Joint> joint = urdf_model_.getJoint(tip_joint_name);
+    if(!joint) {
+      ROS_ERROR_STREAM("Could not find joint "<<tip_joint_name<<" in the URDF.");
+      return false;
+    }
+
+    joints.clear();
+    while(joint) {
+      if(joint->type == urdf::Joint::REVOLUTE) {
+        joints.push_back(joint);
+      }
+      joint = urdf_model_.getLink(joint->parent_link_name)->parent_joint;
+    }
+    std::reverse(joints.begin(), joints.end());
+
+    return true;
+  }
+
+  template<size_t DOF>
+    boost::shared_ptr<SimHW::WamDevice<DOF> >
+    SimHW::configure_wam(
+        const std::string &product_name,
+        const std::vector<boost::shared_ptr<const urdf::Joint> > &joints)
+    {
+      using namespace terse_roscpp;
+      typedef typename WamModel<DOF>::Type Model;
+      typedef Eigen::Matrix<double,DOF,1> Vector;
+
+      ros::NodeHandle product_nh(nh_,"products/"+product_name);
+
+      boost::shared_ptr<SimHW::WamDevice<DOF> > wam_device(new SimHW::WamDevice<DOF>());
+
+      // The generated model has to describe the same joints, regardless of
+      // their prefix
+      for(size_t i=0; i<DOF; i++) {
+        const std::string &joint_name = joints[i]->name;
+        const std::string model_joint_name = Model::joint_name(i);
+        const std::string suffix = model_joint_name.substr(model_joint_name.rfind('/') + 1);
+        if(joint_name.size() < suffix.size()
+            || joint_name.compare(joint_name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        {
+          ROS_ERROR_STREAM("Joint \""<<joint_name<<"\" of "<<product_name<<" does not match joint \""
+              <<model_joint_name<<"\" of the "<<DOF<<"-DOF WAM model, it can't be simulated.");
+          return boost::shared_ptr<SimHW::WamDevice<DOF> >();
+        }
+      }
+
+      // Joint stops and limits from the URDF
+      Vector lower_limits, upper_limits;
+      wam_device->joint_names.resize(DOF);
+      for(size_t i=0; i<DOF; i++) {
+        wam_device->joint_names[i] = joints[i]->name;
+        lower_limits(i) = joints[i]->limits->lower;
+        upper_limits(i) = joints[i]->limits->upper;
+        wam_device->effort_limits(i) = joints[i]->limits->effort;
+        wam_device->resolver_ranges(i) = WAM_RESOLVER_RANGES[i];
+      }
+
+      // Simulation parameters
+      Vector damping = Vector::Constant(0.1);
+      Vector stop_stiffness = Vector::Constant(1000.0);
+      Vector stop_damping = Vector::Constant(10.0);
+      wam_device->initial_positions.setZero();
+      wam_device->encoder_errors.setZero();
+      wam_device->resolver_phases.setZero();
+      if(!get_joint_param<DOF>(product_nh, "initial_positions", wam_device->initial_positions,
+            "The true joint positions [rad] when the simulation starts.")
+          || !get_joint_param<DOF>(product_nh, "encoder_errors", wam_device->encoder_errors,
+            "The encoder positions minus the true joint positions [rad].")
+          || !get_joint_param<DOF>(product_nh, "resolver_ranges", wam_device->resolver_ranges,
+            "The joint displacement [rad] over which each resolver angle wraps around.")
+          || !get_joint_param<DOF>(product_nh, "resolver_phases", wam_device->resolver_phases,
+            "The resolver angle [rad] of each joint at its zero position.")
+          || !get_joint_param<DOF>(product_nh, "damping", damping,
+            "The viscous damping [Nm/(rad/s)] of each joint.")
+          || !get_joint_param<DOF>(product_nh, "stop_stiffness", stop_stiffness,
+            "The stiffness [Nm/rad] of each joint's stops.")
+          || !get_joint_param<DOF>(product_nh, "stop_damping", stop_damping,
+            "The damping [Nm/(rad/s)] of each joint's stops."))
+      {
+        return boost::shared_ptr<SimHW::WamDevice<DOF> >();
+      }
+
+      // The model is expressed in the frame of the parent of the first joint
+      Eigen::Vector3d gravity;
+      if(!this->link_gravity(joints[0]->parent_link_name, gravity)) {
+        ROS_ERROR_STREAM("Could not find the gravity vector for "<<product_name<<".");
+        return boost::shared_ptr<SimHW::WamDevice<DOF> >();
+      }
+
+      wam_device->sim.setGravityVector(gravity);
+      wam_device->sim.setLimits(lower_limits, upper_limits);
+      wam_device->sim.setStops(stop_stiffness, stop_damping);
+      wam_device->sim.setDamping(damping);
+      wam_device->sim.setSubsteps(substeps_);
+      wam_device->set_zero();
+
+      for(size_t i=0; i<DOF; i++) {
+        const std::string &joint_name = wam_device->joint_names[i];
+
+        // Joint State Handle
+        hardware_interface::JointStateHandle state_handle(joint_name,
+            &wam_device->joint_positions(i),
+            &wam_device->joint_velocities(i),
+            &wam_device->joint_total_efforts(i));
+        state_interface_.registerHandle(state_handle);
+
+        // Effort Command Handle
+        effort_interface_.registerHandle(
+            hardware_interface::JointHandle(
+              state_interface_.getHandle(joint_name),
+              &wam_device->joint_effort_cmds(i)));
+
+        // Transmission / Calibration handle
+        semi_absolute_interface_.registerJoint(
+            effort_interface_.getHandle(joint_name),
+            wam_device->resolver_ranges(i),
+            &wam_device->resolver_angles(i),
+            &wam_device->joint_offsets(i),
+            &wam_device->calibrated_joints(i));
+
+        // Feedforward effort handle, in calibrated coordinates
+        feedforward_interface_.registerJoint(
+            hardware_interface::JointStateHandle(joint_name,
+              &wam_device->joint_calibrated_positions(i),
+              &wam_device->joint_velocities(i),
+              &wam_device->joint_total_efforts(i)),
+            &wam_device->joint_feedforward_efforts(i),
+            &wam_device->calibrated_joints(i));
+      }
+
+      // Kinematics
+      wam_device->kinematics.reset(
+          new barrett_model::ModelArmKinematics<Model>(wam_device->joint_calibrated_positions.data()));
+      wam_device->kinematics->setGravityVector(gravity);
+
+      kinematics_interface_.registerArm(
+          barrett_model::ArmKinematicsHandle(
+            product_name,
+            wam_device->joint_names,
+            wam_device->kinematics.get(),
+            wam_device->calibrated_joints.data()));
+
+      return wam_device;
+    }
+
+  bool SimHW::link_gravity(
+      const std::string &link_name,
+      Eigen::Vector3d &gravity)
+  {
+    boost::shared_ptr<const urdf::Link> link = urdf_model_.getLink(link_name);
+    if(!link) {
+      return false;
+    }
+
+    // Rotation of the link in the frame of the URDF root, which has to be
+    // fixed
+    urdf::Rotation rotation;
+    while(link->parent_joint) {
+      if(link->parent_joint->type != urdf::Joint::FIXED) {
+        ROS_ERROR_STREAM("Link \""<<link_name<<"\" is not fixed to the URDF root.");
+        return false;
+      }
+      rotation = link->parent_joint->parent_to_joint_origin_transform.rotation * rotation;
+      link = urdf_model_.getLink(link->parent_joint->parent_link_name);
+    }
+
+    const urdf::Vector3 link_gravity = rotation.GetInverse() * urdf::Vector3(gravity_[0], gravity_[1], gravity_[2]);
+    gravity = Eigen::Vector3d(link_gravity.x, link_gravity.y, link_gravity.z);
+
+    return true;
+  }
+
+  bool SimHW::start()
+  {
+    // Guard on configured
+    if(!configured_) {
+      ROS_ERROR("Simulated barrett hardware must be configured before it can be started.");
+      return false;
+    }
+
+    // Put the arms back in their initial state
+    for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+      it->second->set_zero();
+    }
+    for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+      it->second->set_zero();
+    }
+
+    return true;
+  }
+
+  bool SimHW::read(const ros::Time time, const ros::Duration period)
+  {
+    for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+      this->read_wam(time, period, it->second);
+    }
+    for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+      this->read_wam(time, period, it->second);
+    }
+
+    return true;
+  }
+
+  void SimHW::write(const ros::Time time, const ros::Duration period)
+  {
+    for(Wam4Map::iterator it = wam4s_.begin(); it != wam4s_.end(); ++it) {
+      this->write_wam(time, period, it->second);
+    }
+    for(Wam7Map::iterator it = wam7s_.begin(); it != wam7s_.end(); ++it) {
+      this->write_wam(time, period, it->second);
+    }
+  }
+
+  template <size_t DOF>
+    void SimHW::read_wam(
+        const ros::Time /* time */,
+        const ros::Duration /* period */,
+        boost::shared_ptr<SimHW::WamDevice<DOF> > device)
+    {
+      const Eigen::Matrix<double,DOF,1> &positions = device->sim.getPositions();
+
+      // The encoders measure the joints with an unknown offset
+      device->joint_positions = positions + device->joint_encoder_errors;
+      device->joint_velocities = device->sim.getVelocities();
+      device->joint_calibrated_positions = device->joint_positions + device->joint_offsets;
+      device->kinematics->invalidate();
+
+      // The resolvers measure the joints modulo a motor revolution
+      for(size_t i=0; i<DOF; i++) {
+        const double range = device->resolver_ranges(i);
+        const double angle = positions(i) + device->resolver_phases(i);
+        device->resolver_angles(i) = angle - range*std::floor(angle/range + 0.5);
+      }
+    }
+
+  template <size_t DOF>
+    void SimHW::write_wam(
+        const ros::Time /* time */,
+        const ros::Duration period,
+        boost::shared_ptr<SimHW::WamDevice<DOF> > device)
+    {
+      // Add the feedforward efforts to the commands, and clear them for the
+      // next cycle
+      device->joint_total_efforts = device->joint_effort_cmds + device->joint_feedforward_efforts;
+      device->joint_feedforward_efforts.setZero();
+
+      // Truncate the torques to the safety limits
+      device->joint_total_efforts = device->joint_total_efforts
+        .cwiseMax(-device->effort_limits)
+        .cwiseMin(device->effort_limits);
+
+      // Apply them, and any disturbances, until the next write
+      device->sim.step(device->joint_total_efforts + device->joint_external_efforts, period.toSec());
+
+      // Burn the offsets into the encoders once all joints are calibrated,
+      // so the raw positions become the calibrated positions
+      if((device->calibrated_joints.array() == 1).all() && !device->joint_offsets.isZero(0.0)) {
+        device->joint_encoder_errors += device->joint_offsets;
+        device->joint_offsets.setZero();
+      }
+    }
+
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Runs the barrett_direct WAM driver against an emulated CAN bus with a
+ * simulated 7-DOF WAM on it. The driver initializes the safety module and
+ * the pucks, zeroes the encoders at the parked position, and then holds the
+ * arm there with gravity compensation and a PD loop, exactly like it would
+ * with the real pucks.
+ *
+ * In real-time mode the frames take as long as they would at 1 Mbit/s and
+ * the arm moves with the wall clock. In virtual mode the time only advances
+ * with the traffic on the bus.
+ *
+ * Usage: wam_direct_sim [realtime|virtual] [duration]
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <Eigen/Dense>
+
+#include <barrett_direct/WAM.h>
+#include <barrett_model/wam_7dof_model.h>
+
+#include <barrett_sim/emulated_wam_bus.h>
+#include <barrett_sim/parked_hold.h>
+
+using namespace barrett_direct;
+
+typedef barrett_model::Wam7DofModel Model;
+
+int main( int argc, char** argv ){
+
+  bool realtime = true;
+  double duration = 10.0;
+  if( 1 < argc ){
+    if( strcmp( argv[1], "virtual" ) == 0 )
+    { realtime = false; }
+    else if( strcmp( argv[1], "realtime" ) != 0 ){
+      std::cout << "Usage: " << argv[0] << " [realtime|virtual] [duration]" << std::endl;
+      return -1;
+    }
+  }
+  if( 2 < argc )
+  { duration = atof( argv[2] ); }
+
+  // The arm starts parked, like on the real WAM before its encoders are
+  // zeroed
+  barrett_sim::ParkedHold hold;
+  const Model::JointVector& q_park = hold.GetParkedPositions();
+
+  barrett_sim::EmulatedWAM<Model> can( realtime );
+  hold.Park( can );
+  if( can.Open() != leo_can::CANBus::ESUCCESS ){
+    std::cerr << "Failed to open the emulated bus" << std::endl;
+    return -1;
+  }
+
+  // Construct the wam structure
+  WAM wam_robot( &can );
+  if( wam_robot.Initialize() != WAM::ESUCCESS ){
+    std::cerr << "Failed to initialize WAM" << std::endl;
+    return -1;
+  }
+
+  Eigen::VectorXd q_init( q_park );
+  if( wam_robot.SetPositions( q_init ) != WAM::ESUCCESS ){
+    std::cerr << "Failed to set position: " << q_init << std::endl;
+    return -1;
+  }
+
+  if( wam_robot.SetMode( Puck::MODE_TORQUE ) != WAM::ESUCCESS ){
+    std::cerr << "Failed to activate the pucks" << std::endl;
+    return -1;
+  }
+  hold.Activate( can );
+
+  // Hold the parked position
+  Eigen::VectorXd q( 7 ), tau( 7 );
+
+  const unsigned long sent_start = can.GetSentFrames();
+  const unsigned long received_start = can.GetReceivedFrames();
+  const double busy_start = can.GetBusyTime();
+  const double start = can.GetTime();
+  double t_prev = start, max_cycle = 0.0, max_error = 0.0, max_drift = 0.0;
+  unsigned long cycles = 0;
+
+  while( can.GetTime() - start < duration ){
+
+    if( wam_robot.GetPositions( q ) != WAM::ESUCCESS ){
+      std::cerr << "Failed to get positions" << std::endl;
+      return -1;
+    }
+
+    const double t = can.GetTime();
+    const double dt = t - t_prev;
+    t_prev = t;
+    if( 0 < cycles )
+    { max_cycle = std::max( max_cycle, dt ); }
+
+    // The driver's reading against the simulated arm
+    max_error = std::max( max_error, ( Model::JointVector( q ) - can.GetSim().getPositions() ).cwiseAbs().maxCoeff() );
+    max_drift = std::max( max_drift, ( Model::JointVector( q ) - q_park ).cwiseAbs().maxCoeff() );
+
+    hold.Update( q, dt, tau );
+
+    if( wam_robot.SetTorques( tau ) != WAM::ESUCCESS ){
+      std::cerr << "Failed to set torques" << std::endl;
+      return -1;
+    }
+
+    cycles++;
+  }
+
+  const double elapsed = can.GetTime() - start;
+  printf( "cycles:                %lu\n", cycles );
+  printf( "mean cycle [us]:       %.1f\n", 1E6*elapsed/cycles );
+  printf( "max cycle [us]:        %.1f\n", 1E6*max_cycle );
+  printf( "frames sent/cycle:     %.2f\n", (double)( can.GetSentFrames() - sent_start )/cycles );
+  printf( "frames received/cycle: %.2f\n", (double)( can.GetReceivedFrames() - received_start )/cycles );
+  printf( "bus load:              %.1f%%\n", 100.0*( can.GetBusyTime() - busy_start )/elapsed );
+  printf( "max reading error:     %g rad\n", max_error );
+  printf( "max drift from park:   %g rad\n", max_drift );
+
+  return 0;
+}
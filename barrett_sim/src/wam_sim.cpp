@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ros/ros.h>
+#include <controller_manager/controller_manager.h>
+#include <rosgraph_msgs/Clock.h>
+#include <signal.h>
+
+#include <terse_roscpp/param.h>
+
+#include <barrett_sim/sim_hw.h>
+
+bool g_quit = false;
+
+void quitRequested(int /* sig */) {
+  g_quit = true;
+}
+
+int main( int argc, char** argv ){
+
+  // Initialize ROS
+  ros::init(argc, argv, "wam_sim", ros::init_options::NoSigintHandler);
+
+  // Add custom signal handlers
+  signal(SIGTERM, quitRequested);
+  signal(SIGINT, quitRequested);
+  signal(SIGHUP, quitRequested);
+
+  using namespace terse_roscpp;
+
+  // The simulation runs on its own clock, with a fixed period
+  ros::NodeHandle private_nh("~");
+  double step = 0.002, real_time_factor = 1.0, duration = 0.0;
+  param::get(private_nh,"step",step, "The period [s] of the simulated control loop.");
+  param::get(private_nh,"real_time_factor",real_time_factor, "How much faster than real time the simulation runs, or 0 to run as fast as possible.");
+  param::get(private_nh,"duration",duration, "The simulated time [s] after which the simulation stops, or 0 to never stop.");
+  if(step <= 0.0) {
+    ROS_FATAL("The simulation step must be positive.");
+    return -1;
+  }
+
+  ros::NodeHandle nh;
+  bool use_sim_time = false;
+  nh.getParam("/use_sim_time", use_sim_time);
+  if(!use_sim_time) {
+    ROS_WARN("/use_sim_time is not set, ROS time won't follow the simulated time.");
+  }
+  ros::Publisher clock_pub = nh.advertise<rosgraph_msgs::Clock>("/clock", 1);
+
+  // Construct the simulated system
+  ros::NodeHandle barrett_nh("barrett");
+
+  barrett_sim::SimHW barrett_robot(barrett_nh);
+  if(!barrett_robot.configure()) {
+    ROS_FATAL("Could not configure the simulated WAM!");
+    return -1;
+  }
+  barrett_robot.start();
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  // Construct the controller manager
+  controller_manager::ControllerManager manager(&barrett_robot, nh);
+
+  const ros::Duration period(step);
+  const ros::WallTime wall_start_time = ros::WallTime::now();
+  rosgraph_msgs::Clock clock;
+  ros::Time now;
+  unsigned long count = 0;
+
+  ROS_INFO("Simulating with a period of %g s at %g times real time.", step, real_time_factor);
+
+  while( !g_quit && ros::ok() ) {
+    // Simulated time starts one period after zero, since a zero time means
+    // that the clock hasn't been received
+    now += period;
+    if(duration > 0.0 && now.toSec() > duration) {
+      break;
+    }
+
+    // Advance the ROS clock before the controllers run, so anything they
+    // schedule is relative to this cycle
+    clock.clock = now;
+    clock_pub.publish(clock);
+
+    // Read the simulated state, update the controllers, and integrate the
+    // commanded efforts over the period
+    barrett_robot.read(now, period);
+    manager.update(now, period);
+    barrett_robot.write(now, period);
+
+    count++;
+
+    // Keep pace with the wall clock, unless running as fast as possible
+    if(real_time_factor > 0.0) {
+      const ros::WallTime wakeup = wall_start_time + ros::WallDuration(count*step/real_time_factor);
+      const ros::WallDuration remaining = wakeup - ros::WallTime::now();
+      if(remaining > ros::WallDuration(0.0)) {
+        remaining.sleep();
+      }
+    }
+  }
+
+  const double wall_duration = (ros::WallTime::now() - wall_start_time).toSec();
+  ROS_INFO("Simulated %g s in %g s (%g times real time).",
+      count*step, wall_duration, wall_duration > 0.0 ? count*step/wall_duration : 0.0);
+
+  spinner.stop();
+  barrett_robot.stop();
+  barrett_robot.cleanup();
+
+  return 0;
+}
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Runs a controller against many simulated WAMs in parallel, and writes
+ * summary metrics of each run to one results file.
+ *
+ * Each run pairs one controller configuration with one scenario. Every
+ * controller in ~controller_names is run in every scenario in
+ * ~scenario_names, each run with its own controller instance and its own
+ * simulated arm. The runs are spread over ~threads workers, each with its
+ * own SimHW configured from the barrett namespace like wam_sim's, so the
+ * simulation steps as fast as the controllers allow.
+ *
+ * ~controllers/<name> holds the type and the parameters of each
+ * controller, like a controller manager's namespace does. A gain sweep is a
+ * list of such namespaces, e.g. generated by a script. Runs of the same
+ * controller happen at once, so each run gets a copy of these parameters
+ * in ~runs/<controller>/<scenario>, where its topics are advertised too.
+ *
+ * ~scenarios/<name> describes how each run starts and what it measures:
+ *   duration              The simulated time [s] of the run
+ *   initial_positions     The true joint positions [rad] at the start
+ *   initial_velocities    The joint velocities [rad/s] at the start
+ *   calibrated            Whether the joints start calibrated (true)
+ *   goal_positions        The positions [rad] the errors are measured from,
+ *                         which default to the initial positions
+ *   settle_tolerance      The error [rad] within which the arm is settled
+ *   disturbance_efforts   Joint torques [Nm] applied by the environment
+ *   disturbance_start     When [s] the disturbance starts
+ *   disturbance_duration  How long [s] the disturbance lasts
+ *
+ * The results file has one tab-separated row per run, in the order above,
+ * under a header naming the columns.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <ros/ros.h>
+#include <controller_interface/controller_base.h>
+#include <pluginlib/class_loader.h>
+
+#include <terse_roscpp/param.h>
+
+#include <barrett_sim/sim_hw.h>
+#include <barrett_sim/work_stealing_pool.h>
+
+// Joint positions [rad] beyond which the simulation has diverged
+static const double MAX_POSITION = 1E3;
+
+typedef pluginlib::ClassLoader<controller_interface::ControllerBase> ControllerLoader;
+
+struct Scenario
+{
+  std::string name;
+  double duration;
+  std::vector<double>
+    initial_positions,
+    initial_velocities,
+    goal_positions,
+    disturbance_efforts;
+  bool calibrated;
+  double settle_tolerance;
+  double disturbance_start;
+  double disturbance_duration;
+};
+
+struct RunResult
+{
+  std::string controller;
+  std::string scenario;
+  std::string status;
+  size_t worker;
+  unsigned long cycles;
+  double wall_time;
+  double final_error;
+  double max_error;
+  double rms_error;
+  double settle_time;
+  double max_effort;
+  double rms_effort;
+  double saturation;
+  double max_stop_effort;
+};
+
+// Everything the workers share
+struct Batch
+{
+  ros::NodeHandle barrett_nh;
+  ros::NodeHandle controllers_nh;
+  ros::NodeHandle runs_nh;
+  std::string product_name;
+  double step;
+
+  std::vector<std::string> controller_names;
+  std::vector<std::string> controller_types;
+  std::vector<Scenario> scenarios;
+  std::vector<RunResult> results;
+
+  // Each worker simulates its runs on its own hardware
+  std::vector<boost::shared_ptr<barrett_sim::SimHW> > sims;
+
+  // Loading and unloading plugins is serialized
+  boost::mutex loader_mutex;
+  boost::shared_ptr<ControllerLoader> loader;
+};
+
+bool load_scenario(ros::NodeHandle &nh, Scenario &scenario)
+{
+  using namespace terse_roscpp;
+
+  scenario.calibrated = true;
+  scenario.settle_tolerance = 0.01;
+  scenario.disturbance_start = 0.0;
+  scenario.disturbance_duration = 0.0;
+
+  param::require(nh,"duration",scenario.duration, "The simulated time [s] of each run.");
+  param::get(nh,"initial_positions",scenario.initial_positions, "The true joint positions [rad] at the start of each run.");
+  param::get(nh,"initial_velocities",scenario.initial_velocities, "The joint velocities [rad/s] at the start of each run.");
+  param::get(nh,"calibrated",scenario.calibrated, "Whether the joints start calibrated.");
+  param::get(nh,"goal_positions",scenario.goal_positions, "The joint positions [rad] the errors are measured from.");
+  param::get(nh,"settle_tolerance",scenario.settle_tolerance, "The largest joint error [rad] at which the arm is settled.");
+  param::get(nh,"disturbance_efforts",scenario.disturbance_efforts, "The joint torques [Nm] applied by the environment.");
+  param::get(nh,"disturbance_start",scenario.disturbance_start, "The time [s] at which the disturbance starts.");
+  param::get(nh,"disturbance_duration",scenario.disturbance_duration, "The duration [s] of the disturbance.");
+
+  if(scenario.duration <= 0.0) {
+    ROS_ERROR_STREAM("The duration of scenario "<<scenario.name<<" must be positive.");
+    return false;
+  }
+
+  return true;
+}
+
+// Copy an optional per-joint parameter over a default
+template <size_t DOF>
+bool joint_vector(
+    const std::vector<double> &values,
+    Eigen::Matrix<double,DOF,1> &vector)
+{
+  if(values.empty()) {
+    return true;
+  }
+  if(values.size() != DOF) {
+    return false;
+  }
+  for(size_t i=0; i<DOF; i++) {
+    vector(i) = values[i];
+  }
+  return true;
+}
+
+// Whether the positions are still plausible, which NaNs aren't
+template <size_t DOF>
+bool finite_positions(const Eigen::Matrix<double,DOF,1> &positions)
+{
+  for(size_t i=0; i<DOF; i++) {
+    if(!(std::abs(positions(i)) < MAX_POSITION)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <size_t DOF>
+void run_wam(
+    Batch &batch,
+    barrett_sim::SimHW &sim,
+    barrett_sim::SimHW::WamDevice<DOF> &device,
+    controller_interface::ControllerBase &controller,
+    const Scenario &scenario,
+    RunResult &result)
+{
+  typedef Eigen::Matrix<double,DOF,1> Vector;
+
+  // Start from the configured state, changed by the scenario
+  Vector initial_positions = device.initial_positions;
+  Vector initial_velocities = Vector::Zero();
+  Vector disturbance_efforts = Vector::Zero();
+  if(!joint_vector<DOF>(scenario.initial_positions, initial_positions)
+      || !joint_vector<DOF>(scenario.initial_velocities, initial_velocities)
+      || !joint_vector<DOF>(scenario.disturbance_efforts, disturbance_efforts))
+  {
+    result.status = "bad_scenario";
+    return;
+  }
+  Vector goal_positions = initial_positions;
+  if(!joint_vector<DOF>(scenario.goal_positions, goal_positions)) {
+    result.status = "bad_scenario";
+    return;
+  }
+
+  sim.start();
+  device.sim.setState(initial_positions, initial_velocities);
+
+  // A calibrated arm has had its offsets burned into the encoders, so they
+  // measure the true positions before the controller starts
+  if(scenario.calibrated) {
+    device.joint_encoder_errors.setZero();
+    device.joint_offsets.setZero();
+    device.calibrated_joints.setOnes();
+  }
+
+  const ros::Duration period(batch.step);
+  const double disturbance_end = scenario.disturbance_start + scenario.disturbance_duration;
+  ros::Time now = ros::Time(0) + period;
+
+  double sum_squared_error = 0.0, sum_squared_effort = 0.0;
+  unsigned long saturated_cycles = 0;
+  double error = 0.0;
+
+  sim.read(now, period);
+  controller.startRequest(now);
+
+  result.status = "ok";
+  result.settle_time = 0.0;
+  for(result.cycles = 0; (now.toSec() - period.toSec()) < scenario.duration; result.cycles++) {
+    const double t = now.toSec() - period.toSec();
+
+    controller.updateRequest(now, period);
+
+    if(t >= scenario.disturbance_start && t < disturbance_end) {
+      device.joint_external_efforts = disturbance_efforts;
+    } else {
+      device.joint_external_efforts.setZero();
+    }
+    sim.write(now, period);
+
+    now += period;
+    sim.read(now, period);
+
+    // An unstable controller can make the simulation blow up
+    const Vector &positions = device.sim.getPositions();
+    if(!finite_positions<DOF>(positions)) {
+      result.status = "diverged";
+      break;
+    }
+
+    // Errors of the true joint positions
+    error = (positions - goal_positions).cwiseAbs().maxCoeff();
+    sum_squared_error += (positions - goal_positions).squaredNorm();
+    result.max_error = std::max(result.max_error, error);
+    if(error > scenario.settle_tolerance) {
+      result.settle_time = t + period.toSec();
+    }
+
+    // Efforts applied by the motors
+    sum_squared_effort += device.joint_total_efforts.squaredNorm();
+    result.max_effort = std::max(result.max_effort, device.joint_total_efforts.cwiseAbs().maxCoeff());
+    if(((device.effort_limits - device.joint_total_efforts.cwiseAbs()).array() <= 1E-9).any()) {
+      saturated_cycles++;
+    }
+    result.max_stop_effort = std::max(result.max_stop_effort, device.sim.getStopEfforts().cwiseAbs().maxCoeff());
+  }
+
+  controller.stopRequest(now);
+
+  if(result.cycles > 0) {
+    result.final_error = error;
+    result.rms_error = std::sqrt(sum_squared_error/(result.cycles*DOF));
+    result.rms_effort = std::sqrt(sum_squared_effort/(result.cycles*DOF));
+    result.saturation = static_cast<double>(saturated_cycles)/result.cycles;
+  }
+  // The arm never settled if it's still outside the tolerance
+  if(result.status != "ok" || error > scenario.settle_tolerance) {
+    result.settle_time = -1.0;
+  }
+}
+
+void run(Batch &batch, const size_t controller_index, const size_t scenario_index, RunResult &result, const size_t worker)
+{
+  const std::string &controller_name = batch.controller_names[controller_index];
+  const Scenario &scenario = batch.scenarios[scenario_index];
+
+  result.worker = worker;
+  const ros::WallTime wall_start_time = ros::WallTime::now();
+
+  // Configure this worker's hardware on its first run
+  boost::shared_ptr<barrett_sim::SimHW> &sim = batch.sims[worker];
+  if(!sim) {
+    sim.reset(new barrett_sim::SimHW(batch.barrett_nh));
+    if(!sim->configure()) {
+      ROS_ERROR("Could not configure the simulated WAM!");
+      sim.reset();
+      result.status = "sim_failed";
+      return;
+    }
+  }
+
+  // Each run gets its own instance of the controller
+  boost::shared_ptr<controller_interface::ControllerBase> controller;
+  try {
+    boost::mutex::scoped_lock lock(batch.loader_mutex);
+    controller = batch.loader->createInstance(batch.controller_types[controller_index]);
+  } catch(pluginlib::PluginlibException &ex) {
+    ROS_ERROR_STREAM("Could not load controller "<<controller_name<<": "<<ex.what());
+    result.status = "load_failed";
+    return;
+  }
+
+  ros::NodeHandle root_nh;
+  ros::NodeHandle controller_nh(batch.runs_nh, controller_name+"/"+scenario.name);
+  std::set<std::string> claimed_resources;
+  if(!controller->initRequest(sim.get(), root_nh, controller_nh, claimed_resources)) {
+    ROS_ERROR_STREAM("Could not initialize controller "<<controller_name<<".");
+    result.status = "init_failed";
+  } else if(sim->wam7s().count(batch.product_name)) {
+    run_wam<7>(batch, *sim, *sim->wam7s().find(batch.product_name)->second, *controller, scenario, result);
+  } else if(sim->wam4s().count(batch.product_name)) {
+    run_wam<4>(batch, *sim, *sim->wam4s().find(batch.product_name)->second, *controller, scenario, result);
+  } else {
+    ROS_ERROR_STREAM("There is no simulated WAM named "<<batch.product_name<<".");
+    result.status = "sim_failed";
+  }
+
+  {
+    boost::mutex::scoped_lock lock(batch.loader_mutex);
+    controller.reset();
+  }
+
+  result.wall_time = (ros::WallTime::now() - wall_start_time).toSec();
+}
+
+bool write_results(const std::string &filename, const std::vector<RunResult> &results)
+{
+  FILE *file = fopen(filename.c_str(), "w");
+  if(!file) {
+    return false;
+  }
+
+  fprintf(file, "controller\tscenario\tstatus\tworker\tcycles\twall_time"
+      "\tfinal_error\tmax_error\trms_error\tsettle_time"
+      "\tmax_effort\trms_effort\tsaturation\tmax_stop_effort\n");
+  for(size_t i=0; i<results.size(); i++) {
+    const RunResult &r = results[i];
+    fprintf(file, "%s\t%s\t%s\t%lu\t%lu\t%.6f\t%.9g\t%.9g\t%.9g\t%.6f\t%.9g\t%.9g\t%.6f\t%.9g\n",
+        r.controller.c_str(), r.scenario.c_str(), r.status.c_str(),
+        static_cast<unsigned long>(r.worker), r.cycles, r.wall_time,
+        r.final_error, r.max_error, r.rms_error, r.settle_time,
+        r.max_effort, r.rms_effort, r.saturation, r.max_stop_effort);
+  }
+
+  return fclose(file) == 0;
+}
+
+int main( int argc, char** argv ){
+
+  // Initialize ROS
+  ros::init(argc, argv, "wam_sim_batch");
+
+  using namespace terse_roscpp;
+
+  ros::NodeHandle private_nh("~");
+  Batch batch;
+  batch.barrett_nh = ros::NodeHandle("barrett");
+  batch.controllers_nh = ros::NodeHandle(private_nh, "controllers");
+  batch.runs_nh = ros::NodeHandle(private_nh, "runs");
+  batch.step = 0.002;
+
+  int n_threads = 0;
+  std::string results_filename;
+  std::vector<std::string> scenario_names;
+  param::require(private_nh,"results_file",results_filename, "The file the metrics of each run are written to.");
+  param::require(private_nh,"product",batch.product_name, "The name of the simulated WAM which is controlled.");
+  param::require(private_nh,"controller_names",batch.controller_names, "The names of the controllers to run.");
+  param::require(private_nh,"scenario_names",scenario_names, "The names of the scenarios to run each controller in.");
+  param::get(private_nh,"step",batch.step, "The period [s] of the simulated control loop.");
+  param::get(private_nh,"threads",n_threads, "The number of runs simulated at once, or 0 for one per core.");
+  if(batch.step <= 0.0) {
+    ROS_FATAL("The simulation step must be positive.");
+    return -1;
+  }
+  if(n_threads <= 0) {
+    n_threads = std::max(1U, boost::thread::hardware_concurrency());
+  }
+
+  for(size_t i=0; i<batch.controller_names.size(); i++) {
+    ros::NodeHandle controller_nh(batch.controllers_nh, batch.controller_names[i]);
+    std::string type;
+    param::require(controller_nh,"type",type, "The type of the controller.");
+    batch.controller_types.push_back(type);
+  }
+
+  batch.scenarios.resize(scenario_names.size());
+  for(size_t i=0; i<scenario_names.size(); i++) {
+    ros::NodeHandle scenario_nh(private_nh, "scenarios/"+scenario_names[i]);
+    batch.scenarios[i].name = scenario_names[i];
+    if(!load_scenario(scenario_nh, batch.scenarios[i])) {
+      return -1;
+    }
+  }
+
+  // Copy each controller's parameters to the namespace of each of its runs
+  for(size_t c=0; c<batch.controller_names.size(); c++) {
+    XmlRpc::XmlRpcValue params;
+    batch.controllers_nh.getParam(batch.controller_names[c], params);
+    for(size_t s=0; s<batch.scenarios.size(); s++) {
+      batch.runs_nh.setParam(batch.controller_names[c]+"/"+batch.scenarios[s].name, params);
+    }
+  }
+
+  batch.loader.reset(new ControllerLoader("controller_interface", "controller_interface::ControllerBase"));
+  batch.sims.resize(n_threads);
+
+  // Queue every controller in every scenario
+  barrett_sim::WorkStealingPool pool(n_threads);
+  batch.results.resize(batch.controller_names.size()*batch.scenarios.size());
+  for(size_t c=0, r=0; c<batch.controller_names.size(); c++) {
+    for(size_t s=0; s<batch.scenarios.size(); s++, r++) {
+      RunResult &result = batch.results[r];
+      result = RunResult();
+      result.controller = batch.controller_names[c];
+      result.scenario = batch.scenarios[s].name;
+      result.status = "not_run";
+      result.settle_time = -1.0;
+      pool.push(boost::bind(&run, boost::ref(batch), c, s, boost::ref(result), _1));
+    }
+  }
+
+  // Controllers may subscribe to topics, and their publishers need to run
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  ROS_INFO("Simulating %lu runs on %d threads.",
+      static_cast<unsigned long>(batch.results.size()), n_threads);
+
+  const ros::WallTime wall_start_time = ros::WallTime::now();
+  pool.run();
+  const double wall_duration = (ros::WallTime::now() - wall_start_time).toSec();
+
+  spinner.stop();
+
+  unsigned long failed = 0;
+  double simulated_time = 0.0;
+  for(size_t i=0; i<batch.results.size(); i++) {
+    simulated_time += batch.results[i].cycles*batch.step;
+    if(batch.results[i].status != "ok") {
+      failed++;
+    }
+  }
+  ROS_INFO("Simulated %g s in %g s (%g times real time), %lu runs failed, %lu runs were stolen.",
+      simulated_time, wall_duration, wall_duration > 0.0 ? simulated_time/wall_duration : 0.0,
+      failed, pool.steals());
+
+  if(!write_results(results_filename, batch.results)) {
+    ROS_FATAL_STREAM("Could not write the results to "<<results_filename<<".");
+    return -1;
+  }
+
+  return failed == 0 ? 0 : 1;
+}
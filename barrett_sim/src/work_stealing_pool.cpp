@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012, The Johns Hopkins University
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of The Johns Hopkins University. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <barrett_sim/work_stealing_pool.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace barrett_sim
+{
+  WorkStealingPool::WorkStealingPool(const size_t n_workers) :
+    queues_(n_workers > 0 ? n_workers : 1),
+    next_queue_(0),
+    steals_(0)
+  {
+    for(size_t i=0; i<queues_.size(); i++) {
+      queues_[i].reset(new Queue());
+    }
+  }
+
+  void WorkStealingPool::push(const Task &task)
+  {
+    Queue &queue = *queues_[next_queue_];
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+
+    boost::mutex::scoped_lock lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+
+  void WorkStealingPool::run()
+  {
+    steals_ = 0;
+
+    // The calling thread is the first worker
+    boost::thread_group threads;
+    for(size_t i=1; i<queues_.size(); i++) {
+      threads.create_thread(boost::bind(&WorkStealingPool::work, this, i));
+    }
+    this->work(0);
+    threads.join_all();
+  }
+
+  void WorkStealingPool::work(const size_t worker)
+  {
+    Task task;
+    while(this->pop(worker, task) || this->steal(worker, task)) {
+      task(worker);
+    }
+  }
+
+  bool WorkStealingPool::pop(const size_t worker, Task &task)
+  {
+    Queue &queue = *queues_[worker];
+    boost::mutex::scoped_lock lock(queue.mutex);
+    if(queue.tasks.empty()) {
+      return false;
+    }
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+  }
+
+  bool WorkStealingPool::steal(const size_t thief, Task &task)
+  {
+    // Start with the next worker, so thieves spread over the victims
+    for(size_t i=1; i<queues_.size(); i++) {
+      Queue &queue = *queues_[(thief + i) % queues_.size()];
+      boost::mutex::scoped_lock lock(queue.mutex);
+      if(!queue.tasks.empty()) {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        __sync_fetch_and_add(&steals_, 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+}